@@ -0,0 +1,74 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdint.h>
+#include <limits.h>
+
+#include "chip8.h"
+
+/* Bumped whenever Aot_Module, Aot_t or the code chip8-aot writes change, libraries built for another version are refused */
+#define AOT_ABI_VERSION 2
+
+/* The one symbol a translated library exports */
+#define AOT_SYMBOL "chip8_aot_module"
+
+/* need of an address without a valid block, no budget is ever that large */
+#define AOT_NEVER INT_MAX
+
+typedef struct Aot Aot_t;
+
+/* A translated block runs with left instructions of budget and returns what is left of it, pc is stored on the way out */
+typedef int (*Aot_Fn)(Chip8_t *system, Aot_t *aot, int left);
+
+/* The bytes start to end - 1 were translated into fn, count instructions long on every path through it */
+typedef struct {
+    uint16_t start;
+    uint16_t end;
+    uint16_t count;
+    Aot_Fn fn;
+} Aot_Block;
+
+/*
+What chip8-aot writes into the library
+    - rom is the image the blocks were translated from, it is loaded at PROGRAM_START
+    - state_size is sizeof(Chip8_t) when the library was compiled, the blocks access it directly
+*/
+typedef struct {
+    uint32_t abi;
+    uint32_t state_size;
+    uint64_t rom_hash;
+    uint32_t rom_size;
+    const uint8_t *rom;
+    uint32_t block_count;
+    const Aot_Block *blocks;
+} Aot_Module;
+
+/*
+A loaded library
+    - A block is only entered while memory still holds the bytes it was translated from, need[start] is its length then and AOT_NEVER otherwise
+    - code_map marks the bytes of the valid blocks, a write to one of them checks every block again
+    - step runs one instruction on the interpreter for a block, nonzero when the block can not go on after it
+*/
+struct Aot {
+    void *handle;
+    const Aot_Module *module;
+    int (*step)(Aot_t *aot, Chip8_t *system, uint16_t next);
+    Aot_Fn fns[MEMORY_SIZE];
+    int need[MEMORY_SIZE];
+    uint8_t code_map[MEMORY_SIZE];
+};
+
+/* Continue at pc with the block there if it is valid and fits the budget, otherwise hand back to aot_run() */
+static inline int aot_dispatch(Chip8_t *system, Aot_t *aot, int left) {
+    if (system->pc < MEMORY_SIZE && left >= aot->need[system->pc]) {
+        return aot->fns[system->pc](system, aot, left);
+    }
+    return left;
+}
+
+int aot_load(Aot_t *aot, const char *path);
+void aot_reset(Aot_t *aot, const Chip8_t *system);
+int aot_run(Aot_t *aot, Chip8_t *system, int budget);
+void aot_cleanup(Aot_t *aot);
+
+#endif // AOT_H
\ No newline at end of file
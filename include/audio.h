@@ -0,0 +1,42 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+
+#define AUDIO_RATE 48000
+#define AUDIO_DEFAULT_SAMPLES 512
+#define AUDIO_MAX_SAMPLES 8192
+#define AUDIO_DEFAULT_TONE 440
+#define AUDIO_VOLUME 3000
+
+/*
+The buzzer of the system
+    - The emulation thread opens gate while sound_timer is above 0, the device reads it from its own thread, so it is atomic
+    - Without a device (the null sink) only the counters are kept, headless runs use it to report how long the buzzer sounded
+    - phase and step belong to the callback, they make a square wave of tone Hz in 32 bit fixed point
+*/
+typedef struct {
+    atomic_int gate;
+    uint64_t frames;
+    uint64_t tone_frames;
+
+    uint32_t device;
+    int samples;
+    int tone;
+    uint32_t phase;
+    uint32_t step;
+} Audio_t;
+
+void audio_null_init(Audio_t *audio);
+void audio_gate(Audio_t *audio, int on);
+void audio_update(Audio_t *audio, const Chip8_t *system);
+
+#if !defined(NO_SDL)
+int audio_sdl_init(Audio_t *audio, int samples, int tone);
+void audio_sdl_cleanup(Audio_t *audio);
+#endif
+
+#endif // AUDIO_H
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <config.h>
+
+#define CATALOG_INDEX_PATH "chip8-emu.catalog"
+#define CATALOG_PROFILES_PATH "chip8-emu.roms"
+#define CATALOG_MAGIC "# chip8-emu catalog"
+#define CATALOG_VERSION 1
+
+/* Hash as 16 hex digits and the terminator, it names the section of the ROM in the profiles */
+#define CATALOG_SECTION_BUF 17
+
+/* Directories below the scanned one that are still searched */
+#define CATALOG_MAX_DEPTH 8
+
+/*
+Where the ROMs on disk are and what their content hashes to
+    - One line per file: hash, size, modification time and path, so a scan only reads the files that changed
+    - Settings are kept apart in CATALOG_PROFILES_PATH, one section per hash, a profile follows the ROM when it is renamed or moved
+*/
+typedef struct {
+    uint64_t hash;
+    uint64_t size;
+    int64_t mtime;
+    char *path;
+    int seen;
+} Catalog_Entry;
+
+typedef struct {
+    Catalog_Entry *entries;
+    size_t count;
+    size_t capacity;
+} Catalog_t;
+
+/* What a scan did to the catalog */
+typedef struct {
+    uint64_t roms;
+    uint64_t added;
+    uint64_t changed;
+    uint64_t unchanged;
+    uint64_t removed;
+    uint64_t skipped;
+} Catalog_Scan;
+
+/* Settings a ROM's section in the profiles may override, -1 and has_ 0 for the ones it leaves alone */
+typedef struct {
+    int ips;
+    int core;
+    int idle_skip;
+    int clip;
+    int has_background;
+    int has_pixel;
+    RGBA_t background;
+    RGBA_t pixel;
+} Catalog_Profile;
+
+uint64_t catalog_hash(const uint8_t *data, size_t len);
+void catalog_section(uint64_t hash, char *buf);
+void catalog_init(Catalog_t *cat);
+int catalog_load(Catalog_t *cat, const char *path);
+int catalog_save(const Catalog_t *cat, const char *path);
+int catalog_scan(Catalog_t *cat, const char *dir, Catalog_Scan *report);
+int catalog_profile(ConfigTable *profiles, uint64_t hash, Catalog_Profile *profile);
+void catalog_print_scan(const Catalog_Scan *report, FILE *fp);
+void catalog_free(Catalog_t *cat);
+
+#endif // CATALOG_H
\ No newline at end of file
@@ -9,8 +9,48 @@
 #define NUM_KEYS 16
 #define DISPLAY_WIDTH 64
 #define DISPLAY_HEIGHT 32
+#define DISPLAY_HIRES_WIDTH 128
+#define DISPLAY_HIRES_HEIGHT 64
+#define DISPLAY_MAX_WORDS (DISPLAY_HIRES_WIDTH / 64 * DISPLAY_HIRES_HEIGHT)
+#define DISPLAY_ALL_ROWS (~(uint64_t)0)
 #define PROGRAM_START 0x200
 
+/* SUPER-CHIP 8 x 10 digits for FX30, stored after the small font. */
+#define FONT_BIG_START 0x50
+#define FONT_BIG_SIZE 10
+
+/* SUPER-CHIP has 8 HP48 RPL user flags that FX75 and FX85 save registers to. */
+#define RPL_COUNT 8
+
+/* Timers tick and frames are produced at 60 Hz. */
+#define CLOCK_FREQUENCY 60
+
+/* Used until chip8_seed() is called, xorshift can not start from 0. */
+#define DEFAULT_SEED 0x2545F491
+
+#define DEFAULT_IPS 540
+
+/* Memory is tracked for chip8_restore() in 64 pages, one bit of dirty_pages each. */
+#define MEMORY_PAGE_SIZE (MEMORY_SIZE / 64)
+
+/* Longest busy wait chip8_run_idle() looks for, in instructions. */
+#define IDLE_MAX_LOOP 64
+
+/* Execution backends that can be selected at runtime. */
+typedef enum {
+    CORE_INTERPRETER,
+    CORE_JIT,
+    CORE_THREADED,
+    CORE_AOT
+} Chip8_Core;
+
+/* Memory an instruction reads or writes besides its own fetch, see chip8_access(). */
+typedef enum {
+    CHIP8_ACCESS_NONE,
+    CHIP8_ACCESS_READ,
+    CHIP8_ACCESS_WRITE
+} Chip8_Access;
+
 /* We will use this in the VF register. */
 #define CARRY_FLAG          (0x01) // 0b00000001
 #define NOBORROW_FLAG       (0x01) // 0b00000001
@@ -18,10 +58,26 @@
 
 /* Systems memory map
 0x000-0x1FF - Chip 8 interpreter (contains font set in emu)
-0x050-0x0A0 - Used for the built in 4x5 pixel font set (0-F)
+0x000-0x04F - Used for the built in 4x5 pixel font set (0-F)
+0x050-0x0EF - Used for the SUPER-CHIP 8x10 pixel font set (0-F)
 0x200-0xFFF - Program ROM and work RAM */
 
-typedef struct {
+typedef struct Chip8 Chip8_t;
+typedef struct Chip8_Instr Chip8_Instr;
+typedef void (*Chip8_Handler)(Chip8_t *system, const Chip8_Instr *instr);
+
+/* An opcode decoded ahead of time, the operands are extracted once so executing it is a single indirect call. */
+struct Chip8_Instr {
+    Chip8_Handler handler;
+    uint16_t opcode;
+    uint16_t nnn;
+    uint8_t n;
+    uint8_t nn;
+    uint8_t x;
+    uint8_t y;
+};
+
+struct Chip8 {
 /* CHIP-8 has 35 opcodes (2 bytes long). */
     uint16_t opcode;
 
@@ -39,8 +95,16 @@ typedef struct {
 /* CHIP-8 has 16 8-bit data registers named V0 to VF. VF is used as a flag in some instructions. */
     uint8_t V[REGISTER_COUNT];
 
-/* Graphics are black and white with 2048 pixels (64 x 32). */
-    uint8_t gfx[DISPLAY_WIDTH * DISPLAY_HEIGHT];
+/* Graphics are black and white with 2048 pixels (64 x 32), or 8192 (128 x 64) in SUPER-CHIP high resolution. Every row is packed into width / 64 words, the most significant bit of the first word is the leftmost pixel. */
+    uint16_t width;
+    uint16_t height;
+    uint64_t gfx[DISPLAY_MAX_WORDS];
+
+/* Rows written since the screen was last shown, bit y is row y. Only the renderer clears it. */
+    uint64_t dirty;
+
+/* Pages of memory and their decoded instructions written since the last chip8_restore(), bit p is the page at p * MEMORY_PAGE_SIZE. */
+    uint64_t dirty_pages;
 
 /* The interpreter will need a stack to because CHIP-8 has opcodes that will allow the program to jump to an address or call a subroutine. We need a stack to remember the location before performing a jump. The system has 16 levels of stack and to remember which level we will create a seperate pointer. */
     uint16_t stack[STACK_SIZE];
@@ -48,6 +112,15 @@ typedef struct {
 
 /* CHIP-8 has a HEX based keypad (0x0-0xF). */
     uint8_t key[NUM_KEYS];
+
+/* State of the random number generator used by CXNN, kept per system so runs can be reproduced. */
+    uint32_t rng;
+
+/* SUPER-CHIP RPL user flags. */
+    uint8_t rpl[RPL_COUNT];
+
+/* Hash of the ROM as load_rom() read it, it finds the settings of the ROM in the catalog. */
+    uint64_t rom_hash;
     
 /* This bitfield will be used for flags that are specific to the emulator implementation. */
     struct {
@@ -55,15 +128,51 @@ typedef struct {
         unsigned int pause          : 1;
         unsigned int restart        : 1;
         unsigned int exit           : 1;
+        unsigned int rewind         : 1;
+        unsigned int save_state     : 1;
+        unsigned int load_state     : 1;
+        unsigned int debug          : 1;
     } EMU_flags;
-} Chip8_t;
+
+/* Behaviour that differs between interpreters, set after chip8_initialize(). */
+    struct {
+        unsigned int clip : 1;
+    } quirks;
+
+/* Every address of memory decoded as if an instruction started there. Entries are rebuilt whenever the program writes to memory. */
+    Chip8_Instr decoded[MEMORY_SIZE];
+};
 
 /* Each number or character is 4 pixels wide and 5 pixels high. */
 extern const uint8_t chip8_fontset[];
 
+/* Each number or character is 8 pixels wide and 10 pixels high. */
+extern const uint8_t chip8_fontset_big[];
+
+/* Words every row of the screen is packed into in the current resolution. */
+static inline int chip8_row_words(const Chip8_t *system) {
+    return system->width / 64;
+}
+
+/* State of the pixel at (x, y). */
+static inline int chip8_pixel(const Chip8_t *system, int x, int y) {
+    return (system->gfx[y * chip8_row_words(system) + x / 64] >> (63 - x % 64)) & 1;
+}
+
 void chip8_initialize(Chip8_t *system);
+void chip8_predecode(Chip8_t *system);
+void chip8_write(Chip8_t *system, uint16_t addr, const uint8_t *data, uint16_t len);
+void chip8_restore(Chip8_t *system, const Chip8_t *snapshot);
+void chip8_seed(Chip8_t *system, uint32_t seed);
+uint64_t chip8_hash(const Chip8_t *system);
 void chip8_update_timers(Chip8_t *system);
 void chip8_emulatecycle(Chip8_t *system);
+void chip8_execute(Chip8_t *system, const Chip8_Instr *instr);
+Chip8_Access chip8_access(const Chip8_t *system, const Chip8_Instr *instr, uint16_t *addr, uint16_t *len);
+int chip8_invalid(const Chip8_Instr *instr);
+int chip8_wrote_over(const Chip8_t *system, const uint8_t *map);
+int chip8_run_threaded(Chip8_t *system, int budget);
+int chip8_run_idle(Chip8_t *system, int budget, uint64_t *elided);
 void chip8_print(Chip8_t *system);
 
 #endif // CHIP8_H
\ No newline at end of file
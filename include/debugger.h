@@ -4,17 +4,76 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#include "graphics.h"
 #include "chip8.h"
 
 #define DEBUGGER_BUF 0x100
+#define DEBUGGER_MAX_CONDITIONS 8
 
+/* Register number of I in a condition, V0 to VF are 0x0 to 0xF. */
+#define DEBUGGER_REG_I 0x10
+
+/* What stops the instrumented core at an address, bits of points. */
+#define DEBUG_BREAK       (0x01) // 0b00000001
+#define DEBUG_WATCH_READ  (0x02) // 0b00000010
+#define DEBUG_WATCH_WRITE (0x04) // 0b00000100
+
+typedef enum {
+    DEBUG_EQUAL,
+    DEBUG_NOT_EQUAL,
+    DEBUG_LESS,
+    DEBUG_GREATER
+} Debug_Compare;
+
+/* Why the instrumented core stopped last. */
+typedef enum {
+    DEBUG_STOP_NONE,
+    DEBUG_STOP_STEP,
+    DEBUG_STOP_HALT,
+    DEBUG_STOP_BREAK,
+    DEBUG_STOP_INVALID,
+    DEBUG_STOP_OVERFLOW,
+    DEBUG_STOP_UNDERFLOW,
+    DEBUG_STOP_READ,
+    DEBUG_STOP_WRITE,
+    DEBUG_STOP_CONDITION
+} Debug_Stop;
+
+/* Break when a register compares true against value, only on the instruction that made it true. */
+typedef struct {
+    uint8_t reg;
+    uint8_t compare;
+    uint16_t value;
+    bool held;
+} Debug_Condition;
+
+/*
+The debugger and the instrumented core it runs
+    - While active every instruction goes through debugger_run() instead of the selected core, the other cores never check for it
+    - run is false while the command line has the system, exec_max counts the instructions until it gets it back, 0 runs until something breaks
+    - Breaking on the next instruction is skipped once when resuming, so the instruction that broke can run
+    - stop_addr is the watched address or the index of the condition behind stop, otherwise pc
+*/
 typedef struct {
+    bool active;
     bool run;
-    uint16_t executed;
-    uint16_t exec_max;
+    bool resume;
+    uint8_t stop;
+    uint16_t stop_addr;
+    uint64_t executed;
+    uint64_t exec_max;
+    uint8_t points[MEMORY_SIZE];
+    int watches;
+    Debug_Condition conditions[DEBUGGER_MAX_CONDITIONS];
+    int condition_count;
 } Debugger_t;
 
-void debugger_cli(Debugger_t *dbg, Chip8_t *system, Chip8_Graphics *gfx);
+void debugger_init(Debugger_t *dbg);
+void debugger_attach(Debugger_t *dbg);
+void debugger_halt(Debugger_t *dbg);
+void debugger_resume(Debugger_t *dbg, uint64_t count);
+void debugger_set_point(Debugger_t *dbg, uint16_t addr, uint8_t point, bool on);
+int debugger_add_condition(Debugger_t *dbg, const Chip8_t *system, const char *s);
+int debugger_run(Debugger_t *dbg, Chip8_t *system, int budget);
+void debugger_cli(Debugger_t *dbg, Chip8_t *system);
 
 #endif // DEBUGGER_H
\ No newline at end of file
@@ -7,16 +7,10 @@
 
 #include "chip8.h"
 
-#define CLOCK_FREQUENCY 60
 #define CLOCK_PERIOD (1000.0 / CLOCK_FREQUENCY)
 
 #define DEFAULT_SCALING 10
-#define DEFAULT_IPS 540
-
 #define MAX_SCALING 20
-#define MAX_IPS 1000
-
-extern SDL_Rect pos;
 
 typedef struct {
     SDL_Window *window;
@@ -24,11 +18,33 @@ typedef struct {
     SDL_Texture *texture;
     RGBA_t *background;
     RGBA_t *pixel;
-    uint32_t pixels[DISPLAY_WIDTH * DISPLAY_HEIGHT];
+    SDL_Rect pos;
+    uint32_t pixels[DISPLAY_HIRES_WIDTH * DISPLAY_HIRES_HEIGHT];
+
+/*
+One texture per resolution, the high resolution one is only created when a ROM switches to it
+    - texture is the one of the resolution on the screen, width and height are that resolution
+    - The window keeps its size, the logical size of the renderer follows the resolution
+*/
+    SDL_Texture *textures[2];
+    int width;
+    int height;
+
+/*
+What is on the screen, so frames that did not change are neither uploaded nor presented
+    - shown holds the rows of the last presented frame, valid is cleared until the first one
+    - frames_presented, frames_skipped and rows_uploaded count the work done since graphics_init()
+*/
+    uint64_t shown[DISPLAY_MAX_WORDS];
+    int valid;
+    uint64_t frames_presented;
+    uint64_t frames_skipped;
+    uint64_t rows_uploaded;
 } Chip8_Graphics;
 
 void graphics_delay(uint32_t ms);
 int graphics_init(Chip8_Graphics *gfx, int scaling, const char *rom);
+void graphics_present(Chip8_Graphics *gfx, const uint64_t *rows, int width, int height, uint64_t dirty);
 void graphics_update(Chip8_Graphics *gfx, Chip8_t *system);
 void graphics_cleanup(Chip8_Graphics *gfx);
 
@@ -0,0 +1,63 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdint.h>
+
+#include <config.h>
+
+#include "aot.h"
+#include "audio.h"
+#include "chip8.h"
+#include "input.h"
+#include "jit.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "trace.h"
+
+#define HEADLESS_MAX_DUMPS 64
+#define HEADLESS_PATH_BUF 0x200
+
+typedef enum {
+    DUMP_FORMAT_PGM,
+    DUMP_FORMAT_PPM
+} Dump_Format;
+
+/* Options for running a ROM without a window and without pacing. A budget of 0 means unlimited, jit is only used by CORE_JIT and aot by CORE_AOT, input, profile, trace and audio may be NULL, trace follows every core. */
+typedef struct {
+    uint64_t ips;
+    Chip8_Core core;
+    Jit_t *jit;
+    Aot_t *aot;
+    int idle_skip;
+    uint64_t max_frames;
+    uint64_t max_instructions;
+    Input_Script *input;
+    Profile_t *profile;
+    Trace_t *trace;
+    Audio_t *audio;
+
+    Dump_Format dump_format;
+    const char *dump_prefix;
+    uint64_t dump_frames[HEADLESS_MAX_DUMPS];
+    int dump_count;
+
+    RGBA_t *background;
+    RGBA_t *pixel;
+} Headless_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t instructions;
+    uint64_t sound_frames;
+    uint64_t elided;
+    double seconds;
+} Headless_Report;
+
+double headless_time(void);
+int headless_dump_frame(Chip8_t *system, const char *path, Dump_Format format, RGBA_t *background, RGBA_t *pixel);
+int headless_execute(Chip8_t *system, Chip8_Core core, Jit_t *jit, int budget);
+int headless_frame(Chip8_t *system, Chip8_Core core, Jit_t *jit, int budget);
+int headless_run(Chip8_t *system, const Headless_t *opts, Headless_Report *report);
+void headless_print_report(const Headless_Report *report);
+
+#endif // HEADLESS_H
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+#define INPUT_LINE_BUF 0x100
+
+typedef struct {
+    uint64_t frame;
+    uint8_t key;
+    uint8_t down;
+} Input_Event;
+
+/*
+Key presses and releases indexed by frame
+    - Text format, one event per line: <frame> <key 0-F> <1 = down, 0 = up>
+    - Lines starting with '#' are comments, frames may not decrease
+*/
+typedef struct {
+    Input_Event *events;
+    size_t count;
+    size_t cap;
+    size_t next;
+} Input_Script;
+
+int input_push(Input_Script *script, uint64_t frame, uint8_t key, uint8_t down);
+int input_load(Input_Script *script, const char *path);
+void input_apply(Input_Script *script, Chip8_t *system, uint64_t frame);
+void input_free(Input_Script *script);
+
+#endif // INPUT_H
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+#define JIT_CODE_SIZE 0x40000
+#define JIT_MAX_BLOCK 64
+#define JIT_MAX_BLOCK_CODE (JIT_MAX_BLOCK * 32 + 32)
+#define JIT_HOT_THRESHOLD 8
+
+typedef void (*Jit_Fn)(Chip8_t *system);
+
+typedef struct {
+    Jit_Fn fn;
+    uint16_t count;
+    uint16_t hits;
+    uint8_t failed;
+} Jit_Block;
+
+/*
+Translated basic blocks, indexed by the address they start at
+    - A block is straight line code ending at a jump, a skip, or the first instruction that is left to the interpreter
+    - code_map marks every byte of memory that some block was translated from
+*/
+typedef struct {
+    uint8_t *code;
+    size_t used;
+    Jit_Block blocks[MEMORY_SIZE];
+    uint8_t code_map[MEMORY_SIZE];
+} Jit_t;
+
+int jit_init(Jit_t *jit);
+void jit_reset(Jit_t *jit);
+int jit_run(Jit_t *jit, Chip8_t *system, int budget);
+void jit_cleanup(Jit_t *jit);
+
+#endif // JIT_H
\ No newline at end of file
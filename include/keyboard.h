@@ -5,8 +5,9 @@
 
 #include "graphics.h"
 #include "chip8.h"
+#include "sync.h"
 
-void await_keypress(SDL_Event *event, Chip8_t *system);
-void await_unpause(SDL_Event *event, Chip8_t *system);
+void await_keypress(SDL_Event *event, Event_Queue *queue);
+void keyboard_apply(Chip8_t *system, const Host_Event *ev);
 
 #endif // KEYBOARD_H
\ No newline at end of file
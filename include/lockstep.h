@@ -0,0 +1,52 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/* Lanes are padded to a whole number of 256-bit vectors of bytes. */
+#define LOCKSTEP_WIDTH 32
+
+/* Groups of lanes at different addresses that are tried per instruction before the rest runs scalar. */
+#define LOCKSTEP_MAX_GROUPS 8
+
+/*
+Many systems running the same ROM, one instruction at a time in every lane
+    - V, I, pc and the timers are stored as structure of arrays so one opcode can run across all lanes at once
+    - Everything else (memory, stack, screen, keys) stays in one Chip8_t per lane
+    - Lanes that are not at the same address as the group, or run an opcode without a vector version, fall back to chip8_emulatecycle()
+*/
+typedef struct {
+    int lanes;
+    int width;
+    int avx2;
+
+    uint8_t *V[REGISTER_COUNT];
+    uint16_t *I;
+    uint16_t *pc;
+    uint8_t *delay_timer;
+    uint8_t *sound_timer;
+
+    uint16_t *pending;
+    uint16_t *mask16;
+    uint8_t *mask8;
+
+    Chip8_t *systems;
+
+/* Addresses some lane has written to, the opcode there has to be compared per lane. */
+    uint8_t written[MEMORY_SIZE];
+
+    uint64_t vector_instructions;
+    uint64_t scalar_instructions;
+} Lockstep_t;
+
+int lockstep_init(Lockstep_t *ls, int lanes);
+int lockstep_load(Lockstep_t *ls, const char *rom);
+void lockstep_pack(Lockstep_t *ls);
+void lockstep_sync(Lockstep_t *ls);
+void lockstep_run(Lockstep_t *ls, int budget);
+void lockstep_update_timers(Lockstep_t *ls);
+void lockstep_cleanup(Lockstep_t *ls);
+
+#endif // LOCKSTEP_H
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "input.h"
+
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 3
+
+/* magic, version, flags, seed, instructions per second (per frame in version 1), frames, start and end hash */
+/* Version 3 is the first with the SUPER-CHIP font in memory, the start hash of older movies is taken without it */
+#define MOVIE_HEADER_SIZE (4 + 2 + 2 + 4 + 4 + 8 + 8 + 8)
+
+/*
+A recorded run
+    - The header holds everything besides the ROM that decides how the run goes: seed, instructions per second and quirks
+    - start_hash is chip8_hash() before the first frame, end_hash after the last one, so playback can check it is bit exact
+    - The body is one record per key change: the frames since the previous change as a LEB128 varint, then the key with down in bit 4
+*/
+typedef struct {
+    uint32_t seed;
+    uint32_t ips;
+    int clip;
+    int big_font;
+    uint64_t frames;
+    uint64_t start_hash;
+    uint64_t end_hash;
+    Input_Script script;
+} Movie_t;
+
+typedef struct {
+    FILE *fp;
+    Movie_t movie;
+    uint8_t keys[NUM_KEYS];
+    uint64_t last_frame;
+} Movie_Recorder;
+
+int movie_record_start(Movie_Recorder *rec, const char *path, const Chip8_t *system, uint32_t seed, uint32_t ips);
+int movie_record_frame(Movie_Recorder *rec, const Chip8_t *system, uint64_t frame);
+int movie_record_finish(Movie_Recorder *rec, const Chip8_t *system, uint64_t frames);
+int movie_load(Movie_t *movie, const char *path);
+void movie_free(Movie_t *movie);
+
+#endif // MOVIE_H
\ No newline at end of file
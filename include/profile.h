@@ -0,0 +1,51 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+#define PROFILE_DEFAULT_TOP 10
+#define PROFILE_MAX_DEPTH 64
+#define PROFILE_PATH_BUF 0x200
+
+/* One node of the call tree, the root is the code that runs outside any subroutine */
+typedef struct {
+    uint16_t addr;
+    int parent;
+    int child;
+    int sibling;
+    int depth;
+    uint64_t self;
+} Profile_Node;
+
+/*
+Counts gathered while the profiler executes the ROM
+    - pc holds executions per address and opcode the last opcode run there, classes counts per opcode family (the highest nibble)
+    - 2NNN enters a child of the current node, 00EE goes back to the parent, every instruction counts towards the current node
+    - A jump to an address at or before itself closes a loop, loop_target and loop_count are indexed by the address of the jump
+*/
+typedef struct {
+    uint64_t total;
+    uint64_t pc[MEMORY_SIZE];
+    uint16_t opcode[MEMORY_SIZE];
+    uint64_t classes[16];
+
+    Profile_Node *nodes;
+    int node_count;
+    int node_cap;
+    int current;
+
+    uint16_t loop_target[MEMORY_SIZE];
+    uint64_t loop_count[MEMORY_SIZE];
+} Profile_t;
+
+int profile_init(Profile_t *prof);
+int profile_run(Profile_t *prof, Chip8_t *system, int budget);
+int profile_write_folded(const Profile_t *prof, const char *path);
+void profile_write_report(const Profile_t *prof, FILE *fp, int top);
+void profile_cleanup(Profile_t *prof);
+
+#endif // PROFILE_H
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef REMOTE_H
+#define REMOTE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+#include "debugger.h"
+
+/* Longest request line, longer ones are answered with an error and dropped. */
+#define REMOTE_LINE_BUF 0x2100
+
+/* Replies waiting for the client, enough for a dump of all memory and the lines around it. */
+#define REMOTE_OUT_BUF 0x4000
+
+/* sun_path is 108 bytes on Linux and 104 on the BSDs. */
+#define REMOTE_PATH_BUF 104
+
+/*
+Debug server on a Unix domain socket
+    - One client at a time sends requests as lines of text and gets a line back for each, see README.md
+    - Nothing blocks, remote_poll() takes what arrived and sends what fits once a frame, the rest waits in out for the next frame
+    - running is whether the instrumented core ran after the last poll, stopped holds a stop the client was not told about yet
+*/
+typedef struct {
+    int listen_fd;
+    int client_fd;
+    char path[REMOTE_PATH_BUF];
+
+    char in[REMOTE_LINE_BUF];
+    size_t in_len;
+    bool overlong;
+
+    uint8_t out[REMOTE_OUT_BUF];
+    size_t out_len;
+
+    bool running;
+    bool stopped;
+} Remote_t;
+
+int remote_open(Remote_t *r, const char *path);
+int remote_poll(Remote_t *r, Debugger_t *dbg, Chip8_t *system);
+bool remote_connected(const Remote_t *r);
+void remote_close(Remote_t *r);
+
+#endif // REMOTE_H
\ No newline at end of file
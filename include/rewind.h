@@ -0,0 +1,60 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+#include "state.h"
+
+/* Bytes of compressed history, about 5 minutes for a typical ROM. */
+#define REWIND_POOL_SIZE (2 * 1024 * 1024)
+
+/* Frames that can be indexed, the pool usually runs out first. */
+#define REWIND_MAX_ENTRIES (CLOCK_FREQUENCY * 60 * 10)
+
+/* Every this many frames a full state is stored, the ones between are deltas against it. */
+#define REWIND_KEYFRAME_INTERVAL CLOCK_FREQUENCY
+
+/* Runs of zeros and literals never grow a body by more than one token header. */
+#define REWIND_ENCODED_MAX (STATE_BODY_SIZE + 8)
+
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+    uint8_t keyframe;
+} Rewind_Entry;
+
+/*
+Ring buffer of one snapshot per frame
+    - A keyframe is the state body, a delta is the body XORed with the last keyframe, both are run length encoded
+    - Entries live in one circular pool, the oldest ones are dropped when a new one does not fit
+    - The oldest entry is always a keyframe, so every entry can be restored
+*/
+typedef struct {
+    uint8_t *pool;
+    size_t head;
+    size_t used;
+
+    Rewind_Entry *entries;
+    size_t first;
+    size_t count;
+
+    uint64_t pushed;
+    uint64_t key_serial;
+    int key_valid;
+    int since_key;
+    uint8_t key[STATE_BODY_SIZE];
+
+    uint8_t body[STATE_BODY_SIZE];
+    uint8_t encoded[REWIND_ENCODED_MAX];
+} Rewind_t;
+
+int rewind_init(Rewind_t *rw);
+void rewind_clear(Rewind_t *rw);
+void rewind_push(Rewind_t *rw, const Chip8_t *system);
+int rewind_step(Rewind_t *rw, Chip8_t *system);
+size_t rewind_usage(const Rewind_t *rw);
+void rewind_cleanup(Rewind_t *rw);
+
+#endif // REWIND_H
\ No newline at end of file
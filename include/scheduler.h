@@ -0,0 +1,80 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+/* IPS value that runs as many instructions as fit in every frame */
+#define IPS_UNLIMITED 0
+
+/* Sleep until this long before a deadline, then spin, sleeping is not precise enough for the last stretch */
+#define SCHEDULER_SPIN_NS 2000000
+
+/* Instructions run between two looks at the clock when the IPS are unlimited */
+#define SCHEDULER_CHUNK 1024
+
+/* Frames the scheduler may fall behind before it gives up catching up and starts counting from now */
+#define SCHEDULER_MAX_LAG 4
+
+/*
+Instructions per frame in fixed point with CLOCK_FREQUENCY as the unit, acc holds the fraction of an instruction owed
+    - The fraction left over after every frame is carried to the next one, so 1000 IPS runs 16, 17, 17, ... and nothing is lost
+    - The budgets only depend on the IPS and the frame number, runs stay reproducible
+*/
+typedef struct {
+    uint64_t ips;
+    uint64_t acc;
+} Ipf_Counter;
+
+static inline void ipf_init(Ipf_Counter *c, uint64_t ips) {
+    c->ips = ips;
+    c->acc = 0;
+    return;
+}
+
+static inline int ipf_next(Ipf_Counter *c) {
+    int budget;
+
+    c->acc += c->ips;
+    budget = (int)(c->acc / CLOCK_FREQUENCY);
+    c->acc -= (uint64_t)budget * CLOCK_FREQUENCY;
+    return budget;
+}
+
+/*
+Paces frames to CLOCK_FREQUENCY against the monotonic clock
+    - Deadlines are computed from the first frame, not from the previous one, so rounding never adds up to drift
+    - Waiting sleeps until SCHEDULER_SPIN_NS before the deadline, then spins on the clock
+    - The time between two frames is kept to report the jitter
+*/
+typedef struct {
+    uint64_t ips;
+    Ipf_Counter ipf;
+
+    uint64_t origin;
+    uint64_t frame;
+    uint64_t last;
+
+    uint64_t intervals;
+    double mean;
+    double m2;
+    uint64_t min;
+    uint64_t max;
+    uint64_t late;
+    uint64_t resyncs;
+} Scheduler_t;
+
+uint64_t scheduler_now(void);
+void scheduler_init(Scheduler_t *s, uint64_t ips);
+void scheduler_resync(Scheduler_t *s);
+int scheduler_budget(Scheduler_t *s);
+int scheduler_due(const Scheduler_t *s);
+void scheduler_wait(Scheduler_t *s);
+void scheduler_sleep_until(uint64_t target);
+uint64_t scheduler_slot(const Scheduler_t *s, int done, int budget);
+int scheduler_index(const Scheduler_t *s, uint64_t t, int budget);
+void scheduler_report(const Scheduler_t *s, FILE *fp);
+
+#endif // SCHEDULER_H
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+#define STATE_MAGIC "C8ST"
+#define STATE_VERSION 2
+#define STATE_PATH_BUF 0x200
+
+/* magic, version and body size */
+#define STATE_HEADER_SIZE 8
+
+/* opcode, I, pc, timers, sp, V, key, memory, gfx, stack, rng, quirks, then the SUPER-CHIP resolution and RPL user flags, little endian */
+#define STATE_BODY_SIZE (2 + 2 + 2 + 1 + 1 + 2 + REGISTER_COUNT + NUM_KEYS + MEMORY_SIZE + DISPLAY_MAX_WORDS * 8 + STACK_SIZE * 2 + 4 + 1 + 1 + RPL_COUNT)
+#define STATE_SIZE (STATE_HEADER_SIZE + STATE_BODY_SIZE)
+
+/* Version 1 had a 64 x 32 screen and no SUPER-CHIP state */
+#define STATE_BODY_SIZE_V1 (2 + 2 + 2 + 1 + 1 + 2 + REGISTER_COUNT + NUM_KEYS + MEMORY_SIZE + DISPLAY_HEIGHT * 8 + STACK_SIZE * 2 + 4 + 1)
+
+/*
+Serialized Chip8_t
+    - Only what the program can observe is stored, decoded instructions are rebuilt on load and emulator flags are left alone
+    - The body has a fixed layout so two bodies can be XORed against each other
+*/
+void state_pack(const Chip8_t *system, uint8_t *body);
+void state_unpack(Chip8_t *system, const uint8_t *body);
+size_t state_serialize(const Chip8_t *system, uint8_t *buf);
+int state_deserialize(Chip8_t *system, const uint8_t *buf, size_t len);
+int state_save(const Chip8_t *system, const char *path);
+int state_load(Chip8_t *system, const char *path);
+
+#endif // STATE_H
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+
+#define CACHE_LINE 64
+#define EVENT_QUEUE_SIZE 256
+
+/* A finished frame as the emulation thread publishes it, inputs counts the key presses applied before it */
+typedef struct {
+    uint64_t gfx[DISPLAY_MAX_WORDS];
+    uint16_t width;
+    uint16_t height;
+    uint64_t dirty;
+    uint64_t seq;
+    uint64_t inputs;
+} Frame_t;
+
+/*
+Hands the newest frame from one writer to one reader without locks
+    - The writer owns one slot, the reader another and the third is shared, publishing swaps the writer's slot with the shared one
+    - The shared index carries TRIPLE_FRESH while the reader has not taken it, the reader swaps its slot in only then
+    - Neither side waits, a frame the reader was too slow for is simply replaced by the next one
+*/
+#define TRIPLE_FRESH 4
+
+typedef struct {
+    Frame_t slots[3];
+    _Alignas(CACHE_LINE) atomic_int shared;
+    _Alignas(CACHE_LINE) int back;
+    uint64_t seq;
+    _Alignas(CACHE_LINE) int front;
+} Triple_Buffer;
+
+typedef enum {
+    EVENT_KEY,
+    EVENT_PAUSE,
+    EVENT_RESTART,
+    EVENT_EXIT,
+    EVENT_REWIND,
+    EVENT_SAVE_STATE,
+    EVENT_LOAD_STATE,
+    EVENT_DEBUG
+} Event_Type;
+
+/* time is when the event arrived, in scheduler_now() nanoseconds */
+typedef struct {
+    uint64_t time;
+    uint8_t type;
+    uint8_t key;
+    uint8_t down;
+} Host_Event;
+
+/*
+Single producer, single consumer ring of input events
+    - Only the producer stores head and only the consumer stores tail, each on its own cache line
+    - Pushing to a full queue fails instead of waiting
+*/
+typedef struct {
+    Host_Event events[EVENT_QUEUE_SIZE];
+    _Alignas(CACHE_LINE) atomic_uint head;
+    _Alignas(CACHE_LINE) atomic_uint tail;
+} Event_Queue;
+
+void triple_init(Triple_Buffer *tb);
+Frame_t *triple_back(Triple_Buffer *tb);
+void triple_publish(Triple_Buffer *tb);
+const Frame_t *triple_acquire(Triple_Buffer *tb);
+
+void queue_init(Event_Queue *q);
+int queue_push(Event_Queue *q, const Host_Event *ev);
+int queue_pop(Event_Queue *q, Host_Event *ev);
+int queue_peek(Event_Queue *q, Host_Event *ev);
+
+#endif // SYNC_H
\ No newline at end of file
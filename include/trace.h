@@ -0,0 +1,110 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#include "chip8.h"
+#include "state.h"
+
+/* Instructions a trace reaches back at least, unless the state was replaced in between. */
+#define TRACE_SIZE 0x10000
+
+/* Keypad and timer changes a checkpoint holds, a new checkpoint is taken when they run out. */
+#define TRACE_EVENTS 0x4000
+
+#define TRACE_PATH_BUF 0x200
+
+#define TRACE_MAGIC "C8TRACE"
+#define TRACE_VERSION 2
+
+/* Written as the host stores it, a decoder that reads it swapped swaps every field. */
+#define TRACE_ORDER 0x0102
+
+/* Why the trace was written. */
+typedef enum {
+    TRACE_INVALID = 1,
+    TRACE_OVERFLOW,
+    TRACE_UNDERFLOW,
+    TRACE_SIGNAL
+} Trace_Reason;
+
+/* One executed instruction as the decoder rebuilds it, vx is the Vx of the opcode and vf is VF after it ran. */
+typedef struct {
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t I;
+    uint8_t vx;
+    uint8_t vf;
+} Trace_Entry;
+
+/* What the keypad, bit k is key k, and the timers were before the instruction at offset from the checkpoint ran. */
+typedef struct {
+    uint32_t offset;
+    uint16_t keys;
+    uint8_t delay;
+    uint8_t sound;
+} Trace_Event;
+
+/*
+Start of a dump
+    - Followed by epochs checkpoints, the oldest first, each a Trace_Epoch_Header, the state_pack() body and the events
+    - total is the instruction count when it was written, window the instructions of the run that was still going then
+*/
+typedef struct {
+    char magic[8];
+    uint16_t version;
+    uint16_t order;
+    uint8_t reason;
+    uint8_t signal;
+    uint16_t epochs;
+    uint32_t state_size;
+    uint32_t event_size;
+    uint64_t rom_hash;
+    uint64_t total;
+    uint64_t window;
+} Trace_Header;
+
+/* A checkpoint in a dump, at counts the instructions executed before it. */
+typedef struct {
+    uint64_t at;
+    uint32_t events;
+    uint32_t reserved;
+} Trace_Epoch_Header;
+
+/* The state at instruction at, then every change made to it from outside the ROM until the next checkpoint. */
+typedef struct {
+    uint8_t state[STATE_BODY_SIZE];
+    uint64_t at;
+    Trace_Event events[TRACE_EVENTS];
+    volatile uint32_t event_count;
+    volatile int valid;
+} Trace_Epoch;
+
+/*
+What is needed to replay the last TRACE_SIZE instructions of any core on the interpreter
+    - Nothing is recorded per instruction, the cores run as they do without a trace
+    - Around every run, trace_begin() notes keypad and timer changes and trace_end() counts what was executed
+    - Two checkpoints take turns, a new one is started once the newer one covers TRACE_SIZE instructions or the state is replaced
+    - Written to path on the first invalid opcode or stack overflow or underflow, and on every caught signal
+*/
+typedef struct {
+    Trace_Epoch epochs[2];
+    volatile int newest;
+    volatile uint64_t total;
+    volatile int window;
+    uint16_t keys;
+    uint8_t delay;
+    uint8_t sound;
+    uint64_t rom_hash;
+    int dumped;
+    char path[TRACE_PATH_BUF];
+} Trace_t;
+
+int trace_init(Trace_t *trace, const char *path, const Chip8_t *system);
+void trace_checkpoint(Trace_t *trace, const Chip8_t *system);
+void trace_begin(Trace_t *trace, const Chip8_t *system, int budget);
+void trace_end(Trace_t *trace, const Chip8_t *system, int executed);
+int trace_dump(const Trace_t *trace, int reason, int sig);
+void trace_catch_signals(Trace_t *trace);
+
+#endif // TRACE_H
\ No newline at end of file
@@ -8,5 +8,7 @@
 #define LOG_FLAGS (LOG_ALL)
 
 int load_rom(Chip8_t *system, const char *path);
+int parse_core(const char *name, Chip8_Core *core);
+int str_to_u64(const char *s, uint64_t *out);
 
 #endif // UTILS_H
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "aot.h"
+
+#if !defined(_WIN32)
+
+#include <dlfcn.h>
+
+/*
+Check every block against memory
+    - A block whose bytes were overwritten, or that belongs to another ROM, is left to the interpreter from now on
+*/
+void aot_reset(Aot_t *aot, const Chip8_t *system) {
+    const Aot_Block *block;
+    uint32_t i;
+
+    for (i = 0; i < MEMORY_SIZE; i++) {
+        aot->need[i] = AOT_NEVER;
+    }
+    memset(aot->code_map, 0, sizeof(aot->code_map));
+
+    for (i = 0; i < aot->module->block_count; i++) {
+        block = &aot->module->blocks[i];
+        if (memcmp(system->memory + block->start, aot->module->rom + (block->start - PROGRAM_START), block->end - block->start) != 0) {
+            continue;
+        }
+        aot->need[block->start] = block->count;
+        memset(aot->code_map + block->start, 1, block->end - block->start);
+    }
+    return;
+}
+
+/*
+Check the blocks again if the instruction just interpreted wrote over one of them
+    - Only FX33 and FX55 write memory, the blocks themselves leave both to the interpreter
+    - Returns 1 when a block was written over, the one running may be among them
+*/
+static inline int aot_check_write(Aot_t *aot, Chip8_t *system) {
+    if (chip8_wrote_over(system, aot->code_map)) {
+        aot_reset(aot, system);
+        return 1;
+    }
+    return 0;
+}
+
+/* Run the instruction at pc for a block, which goes on only if nothing was written over and pc is next */
+static int aot_step(Aot_t *aot, Chip8_t *system, uint16_t next) {
+    chip8_emulatecycle(system);
+    return aot_check_write(aot, system) | (system->pc != next) | system->EMU_flags.exit;
+}
+
+/*
+Open a library written by chip8-aot
+    - Returns -1 when it can not be opened, -2 when it is not a translation and -4 when it was built for another version
+    - aot_reset() has to be called with the system before the first aot_run()
+*/
+int aot_load(Aot_t *aot, const char *path) {
+    const Aot_Block *block;
+    uint32_t i;
+
+    memset(aot, 0, sizeof(*aot));
+    aot->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!aot->handle) {
+        return -1;
+    }
+    aot->module = dlsym(aot->handle, AOT_SYMBOL);
+    if (!aot->module) {
+        aot_cleanup(aot);
+        return -2;
+    }
+    if (aot->module->abi != AOT_ABI_VERSION || aot->module->state_size != sizeof(Chip8_t)) {
+        aot_cleanup(aot);
+        return -4;
+    }
+
+    for (i = 0; i < aot->module->block_count; i++) {
+        block = &aot->module->blocks[i];
+        if (block->start < PROGRAM_START || block->end > PROGRAM_START + aot->module->rom_size || block->start >= block->end || block->count == 0) {
+            aot_cleanup(aot);
+            return -2;
+        }
+        aot->fns[block->start] = block->fn;
+    }
+    aot->step = aot_step;
+    for (i = 0; i < MEMORY_SIZE; i++) {
+        aot->need[i] = AOT_NEVER;
+    }
+    return 0;
+}
+
+/*
+Execute up to budget instructions
+    - Blocks call each other directly and only come back here at a return, an indirect jump, an instruction they left to the interpreter or when the budget does not fit the next block
+    - Everything without a valid block goes through chip8_emulatecycle(), the amount executed is exact either way
+*/
+int aot_run(Aot_t *aot, Chip8_t *system, int budget) {
+    int left = budget;
+
+    while (left > 0 && !system->EMU_flags.exit) {
+        if (system->pc < MEMORY_SIZE && left >= aot->need[system->pc]) {
+            left = aot->fns[system->pc](system, aot, left);
+            continue;
+        }
+
+        chip8_emulatecycle(system);
+        left--;
+        aot_check_write(aot, system);
+    }
+    return budget - left;
+}
+
+void aot_cleanup(Aot_t *aot) {
+    if (aot->handle) {
+        dlclose(aot->handle);
+        aot->handle = NULL;
+    }
+    aot->module = NULL;
+    return;
+}
+
+#else
+
+int aot_load(Aot_t *aot, const char *path) {
+    (void)path;
+    memset(aot, 0, sizeof(*aot));
+    return -1;
+}
+
+void aot_reset(Aot_t *aot, const Chip8_t *system) {
+    (void)aot;
+    (void)system;
+    return;
+}
+
+int aot_run(Aot_t *aot, Chip8_t *system, int budget) {
+    int i;
+    (void)aot;
+
+    for (i = 0; i < budget; i++) {
+        chip8_emulatecycle(system);
+    }
+    return budget;
+}
+
+void aot_cleanup(Aot_t *aot) {
+    (void)aot;
+    return;
+}
+
+#endif
\ No newline at end of file
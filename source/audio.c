@@ -0,0 +1,28 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+#include "audio.h"
+
+/* A sink that plays nothing, for headless runs and when no device could be opened */
+void audio_null_init(Audio_t *audio) {
+    memset(audio, 0, sizeof(*audio));
+    atomic_init(&audio->gate, 0);
+    return;
+}
+
+void audio_gate(Audio_t *audio, int on) {
+    atomic_store_explicit(&audio->gate, on, memory_order_relaxed);
+    return;
+}
+
+/* Call it once a frame after the timers were updated, the buzzer sounds while sound_timer is above 0 */
+void audio_update(Audio_t *audio, const Chip8_t *system) {
+    int on = system->sound_timer > 0;
+
+    audio->frames++;
+    audio->tone_frames += on;
+    audio_gate(audio, on);
+    return;
+}
\ No newline at end of file
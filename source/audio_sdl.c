@@ -0,0 +1,59 @@
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+#include "audio.h"
+
+/* Runs on the audio thread, the gate is read once per buffer so a buffer is either all tone or all silence */
+static void square_wave(void *userdata, Uint8 *stream, int len) {
+    Audio_t *audio = userdata;
+    int16_t *out = (int16_t *)stream;
+    int i, count = len / (int)sizeof(int16_t);
+
+    if (!atomic_load_explicit(&audio->gate, memory_order_relaxed)) {
+        memset(stream, 0, len);
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        out[i] = (audio->phase & 0x80000000) ? AUDIO_VOLUME : -AUDIO_VOLUME;
+        audio->phase += audio->step;
+    }
+    return;
+}
+
+/*
+Open the default device with a buffer of samples frames, smaller buffers mean less latency between FX18 and the tone
+    - On failure audio is left as a null sink
+*/
+int audio_sdl_init(Audio_t *audio, int samples, int tone) {
+    SDL_AudioSpec want, have;
+
+    audio_null_init(audio);
+    audio->samples = samples;
+    audio->tone = tone;
+    audio->step = (uint32_t)(((uint64_t)tone << 32) / AUDIO_RATE);
+
+    memset(&want, 0, sizeof(want));
+    want.freq = AUDIO_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = (Uint16)samples;
+    want.callback = square_wave;
+    want.userdata = audio;
+
+    audio->device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (audio->device == 0) {
+        return -1;
+    }
+    SDL_PauseAudioDevice(audio->device, 0);
+    return 0;
+}
+
+void audio_sdl_cleanup(Audio_t *audio) {
+    if (audio->device) {
+        SDL_CloseAudioDevice(audio->device);
+        audio->device = 0;
+    }
+    return;
+}
\ No newline at end of file
@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "chip8.h"
+#include "catalog.h"
+
+/* FNV-1a over the ROM as it is on disk, the same hash chip8_hash() uses for the whole system */
+uint64_t catalog_hash(const uint8_t *data, size_t len) {
+    uint64_t hash = 0xCBF29CE484222325;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3;
+    }
+    return hash;
+}
+
+void catalog_section(uint64_t hash, char *buf) {
+    snprintf(buf, CATALOG_SECTION_BUF, "%016" PRIx64, hash);
+    return;
+}
+
+void catalog_init(Catalog_t *cat) {
+    cat->entries = NULL;
+    cat->count = 0;
+    cat->capacity = 0;
+    return;
+}
+
+static int compare_path(const void *a, const void *b) {
+    return strcmp(((const Catalog_Entry *)a)->path, ((const Catalog_Entry *)b)->path);
+}
+
+/* Takes ownership of path */
+static Catalog_Entry *add_entry(Catalog_t *cat, char *path) {
+    Catalog_Entry *grown;
+    size_t capacity;
+
+    if (cat->count == cat->capacity) {
+        capacity = cat->capacity ? cat->capacity * 2 : 64;
+        grown = realloc(cat->entries, capacity * sizeof(*grown));
+        if (!grown) {
+            return NULL;
+        }
+        cat->entries = grown;
+        cat->capacity = capacity;
+    }
+    memset(&cat->entries[cat->count], 0, sizeof(cat->entries[0]));
+    cat->entries[cat->count].path = path;
+    return &cat->entries[cat->count++];
+}
+
+/*
+Read an index written by catalog_save()
+    - The entries end up sorted by path, a scan looks the files up by it
+    - Returns -1 when the file can not be opened, so a missing index is an empty catalog to the caller
+*/
+int catalog_load(Catalog_t *cat, const char *path) {
+    FILE *fp;
+    char line[4096];
+    int version, offset;
+    size_t len;
+    uint64_t hash, size;
+    int64_t mtime;
+    char *copy;
+    Catalog_Entry *entry;
+
+    catalog_init(cat);
+    fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, CATALOG_MAGIC " ", strlen(CATALOG_MAGIC) + 1) != 0) {
+        fclose(fp);
+        return -2;
+    }
+    if (sscanf(line + strlen(CATALOG_MAGIC) + 1, "%d", &version) != 1 || version != CATALOG_VERSION) {
+        fclose(fp);
+        return -4;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') {
+            fclose(fp);
+            catalog_free(cat);
+            return -2;
+        }
+        line[len - 1] = '\0';
+
+        if (sscanf(line, "%" SCNx64 " %" SCNu64 " %" SCNd64 " %n", &hash, &size, &mtime, &offset) != 3 || line[offset] == '\0') {
+            fclose(fp);
+            catalog_free(cat);
+            return -2;
+        }
+        copy = strdup(line + offset);
+        if (!copy || !(entry = add_entry(cat, copy))) {
+            free(copy);
+            fclose(fp);
+            catalog_free(cat);
+            return -3;
+        }
+        entry->hash = hash;
+        entry->size = size;
+        entry->mtime = mtime;
+    }
+
+    fclose(fp);
+    qsort(cat->entries, cat->count, sizeof(cat->entries[0]), compare_path);
+    return 0;
+}
+
+/* Write the index next to path first and move it over, an interrupted save leaves the old one */
+int catalog_save(const Catalog_t *cat, const char *path) {
+    FILE *fp;
+    char tmp[4096];
+    size_t i;
+    int ok;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        return -1;
+    }
+    fp = fopen(tmp, "w");
+    if (!fp) {
+        return -1;
+    }
+
+    ok = fprintf(fp, "%s %d\n", CATALOG_MAGIC, CATALOG_VERSION) > 0;
+    for (i = 0; i < cat->count && ok; i++) {
+        ok = fprintf(fp, "%016" PRIx64 " %" PRIu64 " %" PRId64 " %s\n", cat->entries[i].hash, cat->entries[i].size, cat->entries[i].mtime, cat->entries[i].path) > 0;
+    }
+    if (fclose(fp) != 0 || !ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        return -3;
+    }
+    return 0;
+}
+
+/* 0 when the file was read and hashed, -1 when it could not be */
+static int hash_file(const char *path, uint64_t size, uint64_t *hash) {
+    uint8_t buf[MEMORY_SIZE];
+    FILE *fp = fopen(path, "rb");
+    size_t bytes_read;
+
+    if (!fp) {
+        return -1;
+    }
+    bytes_read = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    if (bytes_read != size) {
+        return -1;
+    }
+    *hash = catalog_hash(buf, bytes_read);
+    return 0;
+}
+
+/*
+Add or refresh one file
+    - Only the first sorted entries are looked up, those are the ones the catalog had before the scan
+    - A file with the size and modification time of its entry is not read again
+    - Files load_rom() would refuse are skipped
+*/
+static int scan_file(Catalog_t *cat, size_t sorted, char *path, const struct stat *st, Catalog_Scan *report) {
+    Catalog_Entry key, *entry;
+    uint64_t hash;
+    int64_t mtime = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+
+    if (st->st_size == 0 || (uint64_t)st->st_size > MEMORY_SIZE - PROGRAM_START || st->st_size % 2 != 0 || strchr(path, '\n')) {
+        report->skipped++;
+        free(path);
+        return 0;
+    }
+
+    key.path = path;
+    entry = bsearch(&key, cat->entries, sorted, sizeof(cat->entries[0]), compare_path);
+    if (entry && entry->size == (uint64_t)st->st_size && entry->mtime == mtime) {
+        entry->seen = 1;
+        report->unchanged++;
+        report->roms++;
+        free(path);
+        return 0;
+    }
+
+    if (hash_file(path, (uint64_t)st->st_size, &hash) != 0) {
+        report->skipped++;
+        free(path);
+        return 0;
+    }
+
+    if (entry) {
+        free(path);
+        report->changed++;
+    }
+    else {
+        entry = add_entry(cat, path);
+        if (!entry) {
+            free(path);
+            return -3;
+        }
+        report->added++;
+    }
+    entry->hash = hash;
+    entry->size = (uint64_t)st->st_size;
+    entry->mtime = mtime;
+    entry->seen = 1;
+    report->roms++;
+    return 0;
+}
+
+static int scan_dir(Catalog_t *cat, size_t sorted, const char *dir, int depth, Catalog_Scan *report) {
+    DIR *dp = opendir(dir);
+    struct dirent *de;
+    struct stat st;
+    size_t len;
+    char *path;
+    int ret = 0;
+
+    if (!dp) {
+        return -1;
+    }
+
+    while (ret == 0 && (de = readdir(dp))) {
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        len = strlen(dir) + strlen(de->d_name) + 2;
+        path = malloc(len);
+        if (!path) {
+            ret = -3;
+            break;
+        }
+        snprintf(path, len, "%s/%s", dir, de->d_name);
+
+        if (stat(path, &st) != 0) {
+            free(path);
+        }
+        else if (S_ISDIR(st.st_mode)) {
+            if (depth < CATALOG_MAX_DEPTH && scan_dir(cat, sorted, path, depth + 1, report) == -3) {
+                ret = -3;
+            }
+            free(path);
+        }
+        else if (S_ISREG(st.st_mode)) {
+            ret = scan_file(cat, sorted, path, &st, report);
+        }
+        else {
+            free(path);
+        }
+    }
+
+    closedir(dp);
+    return ret;
+}
+
+/*
+Bring the entries below dir up to date with the disk
+    - New files are hashed and added, files whose size or modification time changed are hashed again
+    - Entries below dir whose file is gone are removed, entries elsewhere are kept as they are
+    - Returns -1 when dir can not be opened and -3 when memory ran out, the catalog is still consistent then
+*/
+int catalog_scan(Catalog_t *cat, const char *dir, Catalog_Scan *report) {
+    size_t i, kept, sorted = cat->count, len = strlen(dir);
+    char *root;
+    int ret;
+
+    memset(report, 0, sizeof(*report));
+    while (len > 1 && dir[len - 1] == '/') {
+        len--;
+    }
+    root = malloc(len + 1);
+    if (!root) {
+        return -3;
+    }
+    memcpy(root, dir, len);
+    root[len] = '\0';
+
+    for (i = 0; i < cat->count; i++) {
+        cat->entries[i].seen = 0;
+    }
+
+    ret = scan_dir(cat, sorted, root, 0, report);
+    if (ret != 0) {
+        qsort(cat->entries, cat->count, sizeof(cat->entries[0]), compare_path);
+        free(root);
+        return ret;
+    }
+
+    for (i = 0, kept = 0; i < cat->count; i++) {
+        if (!cat->entries[i].seen && strncmp(cat->entries[i].path, root, len) == 0 && (cat->entries[i].path[len] == '/' || root[len - 1] == '/')) {
+            free(cat->entries[i].path);
+            report->removed++;
+            continue;
+        }
+        cat->entries[kept++] = cat->entries[i];
+    }
+    cat->count = kept;
+    qsort(cat->entries, cat->count, sizeof(cat->entries[0]), compare_path);
+    free(root);
+    return 0;
+}
+
+/* Read the section of the ROM with the hash, returns how many settings it has */
+int catalog_profile(ConfigTable *profiles, uint64_t hash, Catalog_Profile *profile) {
+    char section[CATALOG_SECTION_BUF];
+    int found = 0;
+
+    profile->ips = -1;
+    profile->core = -1;
+    profile->idle_skip = -1;
+    profile->clip = -1;
+    profile->has_background = 0;
+    profile->has_pixel = 0;
+    if (!profiles) {
+        return 0;
+    }
+
+    catalog_section(hash, section);
+    if (config_get_int(profiles, "ips", section, 10, &profile->ips) != 0 || profile->ips < 0) {
+        profile->ips = -1;
+    }
+    if (config_get_int(profiles, "core", section, 10, &profile->core) != 0 || profile->core < 0) {
+        profile->core = -1;
+    }
+    if (config_get_int(profiles, "idle_skip", section, 10, &profile->idle_skip) != 0 || profile->idle_skip < 0) {
+        profile->idle_skip = -1;
+    }
+    if (config_get_int(profiles, "clip", section, 10, &profile->clip) != 0 || profile->clip < 0) {
+        profile->clip = -1;
+    }
+    profile->has_background = config_get_rgba(profiles, "background", section, &profile->background) == 0;
+    profile->has_pixel = config_get_rgba(profiles, "pixel", section, &profile->pixel) == 0;
+
+    found += profile->ips >= 0;
+    found += profile->core >= 0;
+    found += profile->idle_skip >= 0;
+    found += profile->clip >= 0;
+    found += profile->has_background + profile->has_pixel;
+    return found;
+}
+
+void catalog_print_scan(const Catalog_Scan *report, FILE *fp) {
+    fprintf(fp, "ROMS: %" PRIu64 "\n", report->roms);
+    fprintf(fp, "ADDED: %" PRIu64 ", CHANGED: %" PRIu64 ", UNCHANGED: %" PRIu64 ", REMOVED: %" PRIu64 ", SKIPPED: %" PRIu64 "\n", report->added, report->changed, report->unchanged, report->removed, report->skipped);
+    return;
+}
+
+void catalog_free(Catalog_t *cat) {
+    size_t i;
+
+    for (i = 0; i < cat->count; i++) {
+        free(cat->entries[i].path);
+    }
+    free(cat->entries);
+    catalog_init(cat);
+    return;
+}
\ No newline at end of file
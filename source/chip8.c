@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <inttypes.h>
 #include <stdlib.h>
@@ -28,11 +29,26 @@ const uint8_t chip8_fontset[] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-static inline void beep(void) {
-    printf("\a");
-    fflush(stdout);
-    return;
-}
+const uint8_t chip8_fontset_big[] = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+static void predecode_range(Chip8_t *system, uint16_t addr, uint16_t len);
 
 /* 
 Fetch 16-bit opcode from memory 
@@ -40,32 +56,93 @@ Fetch 16-bit opcode from memory
     - We shift the high byte to the left by 8 bits so we can combine with low byte using bitwise OR 
 */
 static inline uint16_t fetch_opcode(Chip8_t *system) {
-    return system->memory[system->pc] << 8 | system->memory[system->pc + 1];
+    return system->memory[system->pc & (MEMORY_SIZE - 1)] << 8 | system->memory[(system->pc + 1) & (MEMORY_SIZE - 1)];
 }
 
 /*
 Clear the graphics screen
-    - Set all bytes in the gfx array to 0
+    - Set all rows in the gfx array to 0 and mark them dirty
 */
 static inline void clear_screen(Chip8_t *system) {
+    system->dirty = DISPLAY_ALL_ROWS;
     return (void)memset(system->gfx, 0, sizeof(system->gfx));
 }
 
+/*
+Scroll the screen down (SUPER-CHIP)
+    - The packed rows are moved down n rows at once, the rows freed at the top are cleared
+*/
+static inline void scroll_down(Chip8_t *system, uint8_t n) {
+    int words = chip8_row_words(system);
+
+    if (n > system->height) {
+        n = system->height;
+    }
+    memmove(system->gfx + n * words, system->gfx, (system->height - n) * words * sizeof(uint64_t));
+    memset(system->gfx, 0, n * words * sizeof(uint64_t));
+    system->dirty = DISPLAY_ALL_ROWS;
+    return;
+}
+
+/*
+Scroll the screen right by 4 pixels (SUPER-CHIP)
+    - Every row is shifted as a whole, the bits leaving one word enter the next one
+*/
+static inline void scroll_right(Chip8_t *system) {
+    int y, w, words = chip8_row_words(system);
+    uint64_t *row;
+
+    for (y = 0; y < system->height; y++) {
+        row = system->gfx + y * words;
+        for (w = words - 1; w > 0; w--) {
+            row[w] = row[w] >> 4 | row[w - 1] << 60;
+        }
+        row[0] >>= 4;
+    }
+    system->dirty = DISPLAY_ALL_ROWS;
+    return;
+}
+
+/*
+Scroll the screen left by 4 pixels (SUPER-CHIP)
+    - Every row is shifted as a whole, the bits leaving one word enter the previous one
+*/
+static inline void scroll_left(Chip8_t *system) {
+    int y, w, words = chip8_row_words(system);
+    uint64_t *row;
+
+    for (y = 0; y < system->height; y++) {
+        row = system->gfx + y * words;
+        for (w = 0; w < words - 1; w++) {
+            row[w] = row[w] << 4 | row[w + 1] >> 60;
+        }
+        row[words - 1] <<= 4;
+    }
+    system->dirty = DISPLAY_ALL_ROWS;
+    return;
+}
+
+/*
+Switch between 64 x 32 and 128 x 64 pixels (SUPER-CHIP)
+    - The rows change their length, so the screen is cleared
+*/
+static inline void set_resolution(Chip8_t *system, int hires) {
+    system->width = hires ? DISPLAY_HIRES_WIDTH : DISPLAY_WIDTH;
+    system->height = hires ? DISPLAY_HIRES_HEIGHT : DISPLAY_HEIGHT;
+    clear_screen(system);
+    return;
+}
+
 /*
 Return from a function:
     - Decrement the stack pointer (sp) to point to the return address
     - Set the program counter (pc) to the return address stored at the new stack pointer location
     - The return address was previously pushed onto the stack when the subroutine was called
+    - The stack index wraps so an unbalanced program can not reach the decoded instructions
 */
 static inline void return_from_subroutine(Chip8_t *system) {
     system->sp--;
-    #if defined(DEBUG)
-    if (system->sp >= STACK_SIZE) {
-        printf("PREVENTED STACK OVERFLOW! SP: %" PRIX16 "\nPROGRAM SHOULD HAVE RETURNED FROM SUBROUTINE, SO UNEXPECTED BEHAVIOR MIGHT OCCUR!\n", system->sp);
-        return;
-    }
-    #endif
-    system->pc = system->stack[system->sp];
+    system->pc = system->stack[system->sp & (STACK_SIZE - 1)];
     return;
 }
 
@@ -82,15 +159,10 @@ static inline void jump_to_address(Chip8_t *system, uint16_t addr) {
 Invoke function
     - Set the return address in the current stack position and push the stack
     - Set the program counter (pc) to the subroutine address
+    - The stack index wraps so an unbalanced program can not reach the decoded instructions
 */
 static inline void call_subroutine(Chip8_t *system, uint16_t addr) {
-    #if defined(DEBUG)
-    if (system->sp >= STACK_SIZE) {
-        printf("PREVENTED STACK OVERFLOW! SP: %" PRIX16 "\nPROGRAM SHOULD HAVE CALLED A SUBROUTINE, SO UNEXPECTED BEHAVIOR MIGHT OCCUR!\n", system->sp);
-        return;
-    }
-    #endif
-    system->stack[system->sp] = system->pc;
+    system->stack[system->sp & (STACK_SIZE - 1)] = system->pc;
     system->sp++;
     system->pc = addr;
     return;
@@ -302,38 +374,123 @@ static inline void jump_to_address_1(Chip8_t *system, uint16_t addr) {
 /*
 Set register to random number
     - We will generate a random number and perform bitwise AND with y, Vx will be set to the result
-    - The generated number is between 0-255
+    - The generated number is between 0-255, taken from the high bits of the systems xorshift generator
 */
 static inline void rand_reg(Chip8_t *system, uint8_t x, uint8_t y) {
-    system->V[x] = (rand() % 256) & y;
+    uint32_t r = system->rng;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    system->rng = r;
+    system->V[x] = (r >> 24) & y;
     return;
 }
 
 /*
-Draw
-    - We draw a sprite at coordinate (Vx, Vy)
-    - Width of 8 pixels, height of z pixels
-    - We set VF to draw flag if a pixel colission occurs
+Draw in low resolution, a screen row is one word
+    - Every sprite row is shifted into place and XORed into the packed screen row at once, a collision is any bit set in both
+    - Wrapping at the right edge is a rotation of the word
 */
-static inline void draw(Chip8_t *system, uint8_t x, uint8_t y, uint8_t z) {
-    uint16_t pixel;
-    int yline, xline;
+static inline void draw_lores(Chip8_t *system, uint8_t x, uint8_t y, uint8_t z) {
+    uint64_t bits;
+    int yline, row;
 
-    uint8_t xx = system->V[x];
-    uint8_t yy = system->V[y];
+    uint8_t xx = system->V[x] % DISPLAY_WIDTH;
+    uint8_t yy = system->V[y] % DISPLAY_HEIGHT;
 
     system->V[0xF] = 0;
     for (yline = 0; yline < z; yline++) {
-        pixel = system->memory[system->I + yline];
-        for (xline = 0; xline < 8; xline++) {
-            if ((pixel & (0x80 >> xline)) != 0) {
-                if (system->gfx[(xx + xline + ((yy + yline) * DISPLAY_WIDTH))]) {
-                    /* PIXEL COLISSION */
-                    system->V[0xF] = PIXELCOLLISION_FLAG;
-                }
-                system->gfx[xx + xline + ((yy + yline) * DISPLAY_WIDTH)] ^= 1;
+        row = yy + yline;
+        if (row >= DISPLAY_HEIGHT) {
+            if (system->quirks.clip) {
+                break;
             }
+            row -= DISPLAY_HEIGHT;
         }
+
+        bits = (uint64_t)system->memory[(system->I + yline) & (MEMORY_SIZE - 1)] << (DISPLAY_WIDTH - 8);
+        if (system->quirks.clip) {
+            bits >>= xx;
+        }
+        else {
+            bits = (bits >> xx) | (bits << ((DISPLAY_WIDTH - xx) & (DISPLAY_WIDTH - 1)));
+        }
+
+        if (system->gfx[row] & bits) {
+            /* PIXEL COLISSION */
+            system->V[0xF] = PIXELCOLLISION_FLAG;
+        }
+        system->gfx[row] ^= bits;
+        system->dirty |= (uint64_t)1 << row;
+    }
+    return;
+}
+
+/*
+Draw in high resolution, a screen row is two words
+    - DXY0 draws 16 x 16 pixels from two bytes per sprite row
+    - A sprite row spans at most two words, what is shifted out of the first one goes to the next, or to the first at the right edge
+*/
+static inline void draw_hires(Chip8_t *system, uint8_t x, uint8_t y, uint8_t z) {
+    uint64_t bits, spill, *line;
+    uint16_t sprite;
+    int yline, row, rows = z ? z : 16, width = z ? 8 : 16;
+
+    int xx = system->V[x] % DISPLAY_HIRES_WIDTH;
+    int yy = system->V[y] % DISPLAY_HIRES_HEIGHT;
+    int word = xx / 64, shift = xx % 64, next = word + 1;
+
+    if (next == DISPLAY_HIRES_WIDTH / 64) {
+        next = system->quirks.clip ? -1 : 0;
+    }
+
+    system->V[0xF] = 0;
+    for (yline = 0; yline < rows; yline++) {
+        row = yy + yline;
+        if (row >= DISPLAY_HIRES_HEIGHT) {
+            if (system->quirks.clip) {
+                break;
+            }
+            row -= DISPLAY_HIRES_HEIGHT;
+        }
+
+        if (width == 16) {
+            sprite = system->memory[(system->I + 2 * yline) & (MEMORY_SIZE - 1)] << 8 | system->memory[(system->I + 2 * yline + 1) & (MEMORY_SIZE - 1)];
+        }
+        else {
+            sprite = system->memory[(system->I + yline) & (MEMORY_SIZE - 1)];
+        }
+        bits = (uint64_t)sprite << (64 - width);
+        spill = shift && next >= 0 ? bits << (64 - shift) : 0;
+        bits >>= shift;
+
+        line = system->gfx + row * (DISPLAY_HIRES_WIDTH / 64);
+        if ((line[word] & bits) || (spill && (line[next] & spill))) {
+            /* PIXEL COLISSION */
+            system->V[0xF] = PIXELCOLLISION_FLAG;
+        }
+        line[word] ^= bits;
+        if (spill) {
+            line[next] ^= spill;
+        }
+        system->dirty |= (uint64_t)1 << row;
+    }
+    return;
+}
+
+/*
+Draw
+    - We draw a sprite at coordinate (Vx, Vy), the coordinate itself wraps around the screen
+    - Width of 8 pixels, height of z pixels, in low resolution DXY0 draws nothing
+    - Past the right and bottom edges the sprite wraps around, or is clipped when the clip quirk is set
+    - We set VF to draw flag if a pixel colission occurs
+*/
+static inline void draw(Chip8_t *system, uint8_t x, uint8_t y, uint8_t z) {
+    if (system->width == DISPLAY_WIDTH) {
+        draw_lores(system, x, y, z);
+    }
+    else {
+        draw_hires(system, x, y, z);
     }
     system->EMU_flags.draw_to_screen = 1;
     return;
@@ -424,35 +581,79 @@ static inline void set_i_to_sprite_addr(Chip8_t *system, uint8_t x) {
     return;
 }
 
+/*
+Set index register (I) to the location of the big sprite for the digit in register (SUPER-CHIP)
+    - Index register (I) will be set to the address of the 8 x 10 sprite of the low nibble of Vx
+*/
+static inline void set_i_to_big_sprite_addr(Chip8_t *system, uint8_t x) {
+    system->I = FONT_BIG_START + (system->V[x] & 0xF) * FONT_BIG_SIZE;
+    return;
+}
+
+/*
+Store registers in the RPL user flags (SUPER-CHIP)
+    - V0 to and including Vx will be stored, there are only RPL_COUNT flags
+*/
+static inline void rpl_save(Chip8_t *system, uint8_t x) {
+    int i;
+    for (i = 0; i <= x && i < RPL_COUNT; i++) {
+        system->rpl[i] = system->V[i];
+    }
+    return;
+}
+
+/*
+Fill registers from the RPL user flags (SUPER-CHIP)
+    - V0 to and including Vx will be filled, there are only RPL_COUNT flags
+*/
+static inline void rpl_load(Chip8_t *system, uint8_t x) {
+    int i;
+    for (i = 0; i <= x && i < RPL_COUNT; i++) {
+        system->V[i] = system->rpl[i];
+    }
+    return;
+}
+
 /*
 Store the binary-coded decimal (BCD) of register in the location of in the index register (I)
     - Hundreds digit at location in I
     - Tens digit at I+1
     - Ones digit at I+2
     - Obtain from Vx
+    - Addresses wrap around memory so a stray I can not write into the decoded instructions
 */
 static inline void store_bcd_reg(Chip8_t *system, uint8_t x) {
-    system->memory[system->I    ] = system->V[x] / 100;
-    system->memory[system->I + 1] = (system->V[x] / 10) % 10;
-    system->memory[system->I + 2] = (system->V[x] / 100) % 10;
+    system->memory[(system->I    ) & (MEMORY_SIZE - 1)] = system->V[x] / 100;
+    system->memory[(system->I + 1) & (MEMORY_SIZE - 1)] = (system->V[x] / 10) % 10;
+    system->memory[(system->I + 2) & (MEMORY_SIZE - 1)] = (system->V[x] / 100) % 10;
+    predecode_range(system, system->I, 3);
     return;
 }
 
 /* 
 Store registers in memory starting at address in index register (I)
     - V0 to and including Vx will be stored in memory starting from address I
+    - Addresses wrap around memory so a stray I can not write into the decoded instructions
 */
 static inline void reg_dump(Chip8_t *system, uint8_t x) {
-    memcpy(system->memory + system->I, system->V, x * sizeof(uint8_t));
+    int i;
+    for (i = 0; i < x; i++) {
+        system->memory[(system->I + i) & (MEMORY_SIZE - 1)] = system->V[i];
+    }
+    predecode_range(system, system->I, x);
     return;
 }
 
 /*
 Fill registers with values from memory starting at address in index register (I)
     - V0 to and including Vx will be filled with values stored in memory starting from address I
+    - Addresses wrap around memory like reg_dump(), a stray I would read past the system otherwise
 */
 static inline void reg_load(Chip8_t *system, uint8_t x) {
-    memcpy(system->V, system->memory + system->I, x * sizeof(uint8_t));
+    int i;
+    for (i = 0; i < x; i++) {
+        system->V[i] = system->memory[(system->I + i) & (MEMORY_SIZE - 1)];
+    }
     return;
 }
 
@@ -467,6 +668,11 @@ void chip8_initialize(Chip8_t *system) {
     memset(system->memory, 0, sizeof(system->memory));
     memset(system->V,      0, sizeof(system->V     ));
     memset(system->gfx,    0, sizeof(system->gfx   ));
+    system->width  = DISPLAY_WIDTH;
+    system->height = DISPLAY_HEIGHT;
+    system->dirty = DISPLAY_ALL_ROWS;
+    system->rom_hash = 0;
+    memset(system->rpl,    0, sizeof(system->rpl   ));
     memset(system->stack,  0, sizeof(system->stack ));
     memset(system->key,    0, sizeof(system->key   ));
 
@@ -474,273 +680,1082 @@ void chip8_initialize(Chip8_t *system) {
     system->EMU_flags.pause          = 0;
     system->EMU_flags.restart        = 0;
     system->EMU_flags.exit           = 0;
+    system->EMU_flags.rewind         = 0;
+    system->EMU_flags.save_state     = 0;
+    system->EMU_flags.load_state     = 0;
+
+    system->quirks.clip = 0;
+    system->rng = DEFAULT_SEED;
 
     memcpy(system->memory, chip8_fontset, sizeof(chip8_fontset));
+    memcpy(system->memory + FONT_BIG_START, chip8_fontset_big, sizeof(chip8_fontset_big));
+    chip8_predecode(system);
+
+    return;
+}
 
+void chip8_seed(Chip8_t *system, uint32_t seed) {
+    system->rng = seed ? seed : DEFAULT_SEED;
     return;
 }
 
+/* Nonzero once the program changed the resolution or the RPL user flags */
+static int schip_state_used(const Chip8_t *system) {
+    int i;
+
+    if (system->width != DISPLAY_WIDTH) {
+        return 1;
+    }
+    for (i = 0; i < RPL_COUNT; i++) {
+        if (system->rpl[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+Hash the state a program can observe
+    - FNV-1a over memory, registers, stack, timers and the screen
+    - Only the words of the screen the resolution uses are hashed, and the resolution and RPL user flags only once they left their initial values, so a CHIP-8 program hashes the same as before SUPER-CHIP existed
+    - The decoded instructions and emulator flags are derived or host state, so they are left out
+*/
+uint64_t chip8_hash(const Chip8_t *system) {
+    uint64_t hash = 0xCBF29CE484222325;
+    const uint8_t *p;
+    size_t i;
+
+    #define HASH_BYTES(start, len) \
+        for (p = (const uint8_t *)(start), i = 0; i < (len); i++) { \
+            hash = (hash ^ p[i]) * 0x100000001B3; \
+        }
+    #define HASH_FIELD(f) HASH_BYTES(&(f), sizeof(f))
+
+    HASH_FIELD(system->I);
+    HASH_FIELD(system->pc);
+    HASH_FIELD(system->delay_timer);
+    HASH_FIELD(system->sound_timer);
+    HASH_FIELD(system->memory);
+    HASH_FIELD(system->V);
+    HASH_BYTES(system->gfx, (size_t)system->height * chip8_row_words(system) * sizeof(uint64_t));
+    HASH_FIELD(system->stack);
+    HASH_FIELD(system->sp);
+    if (schip_state_used(system)) {
+        HASH_FIELD(system->width);
+        HASH_FIELD(system->height);
+        HASH_FIELD(system->rpl);
+    }
+
+    #undef HASH_FIELD
+    #undef HASH_BYTES
+    return hash;
+}
+
 void chip8_update_timers(Chip8_t *system) {
     if (system->delay_timer > 0) {
         system->delay_timer--;
     }
     if (system->sound_timer > 0) {
-        if (system->sound_timer == 1) {
-            beep();
-        }
         system->sound_timer--;
     }
     return;
 }
 
-void chip8_emulatecycle(Chip8_t *system) {
-    uint8_t n, nn, x, y;
-    uint16_t nnn;
+/* Handlers for the decoded instructions, one per opcode. */
+static void op_clear_screen(Chip8_t *system, const Chip8_Instr *instr) {
+    (void)instr;
+    clear_screen(system);
+    system->EMU_flags.draw_to_screen = 1;
+    return;
+}
 
-    /* Fetch opcode and parse */
-    system->opcode = fetch_opcode(system);
-    n   =   system->opcode & 0x000F;
-    nn  =   system->opcode & 0x00FF;
-    nnn =   system->opcode & 0x0FFF;
-    x   =  (system->opcode & 0x0F00) >> 8;
-    y   =  (system->opcode & 0x00F0) >> 4;
+static void op_scroll_down(Chip8_t *system, const Chip8_Instr *instr) {
+    scroll_down(system, instr->n);
+    system->EMU_flags.draw_to_screen = 1;
+    return;
+}
 
-    /* Store next instruction */
-    system->pc += sizeof(uint16_t);
+static void op_scroll_right(Chip8_t *system, const Chip8_Instr *instr) {
+    (void)instr;
+    scroll_right(system);
+    system->EMU_flags.draw_to_screen = 1;
+    return;
+}
+
+static void op_scroll_left(Chip8_t *system, const Chip8_Instr *instr) {
+    (void)instr;
+    scroll_left(system);
+    system->EMU_flags.draw_to_screen = 1;
+    return;
+}
+
+static void op_exit(Chip8_t *system, const Chip8_Instr *instr) {
+    (void)instr;
+    system->EMU_flags.exit = 1;
+    return;
+}
+
+static void op_lores(Chip8_t *system, const Chip8_Instr *instr) {
+    (void)instr;
+    set_resolution(system, 0);
+    system->EMU_flags.draw_to_screen = 1;
+    return;
+}
+
+static void op_hires(Chip8_t *system, const Chip8_Instr *instr) {
+    (void)instr;
+    set_resolution(system, 1);
+    system->EMU_flags.draw_to_screen = 1;
+    return;
+}
+
+static void op_return_from_subroutine(Chip8_t *system, const Chip8_Instr *instr) {
+    (void)instr;
+    return_from_subroutine(system);
+    return;
+}
+
+static void op_jump_to_address(Chip8_t *system, const Chip8_Instr *instr) {
+    jump_to_address(system, instr->nnn);
+    return;
+}
+
+static void op_call_subroutine(Chip8_t *system, const Chip8_Instr *instr) {
+    call_subroutine(system, instr->nnn);
+    return;
+}
+
+static void op_skip_instru_if_equal(Chip8_t *system, const Chip8_Instr *instr) {
+    skip_instru_if_equal(system, instr->x, instr->nn);
+    return;
+}
+
+static void op_skip_instru_if_not_equal(Chip8_t *system, const Chip8_Instr *instr) {
+    skip_instru_if_not_equal(system, instr->x, instr->nn);
+    return;
+}
+
+static void op_skip_instru_if_equal_1(Chip8_t *system, const Chip8_Instr *instr) {
+    skip_instru_if_equal_1(system, instr->x, instr->nn);
+    return;
+}
+
+static void op_set_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    set_reg(system, instr->x, instr->nn);
+    return;
+}
+
+static void op_add_to_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    add_to_reg(system, instr->x, instr->nn);
+    return;
+}
+
+static void op_mov_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    mov_reg(system, instr->x, instr->y);
+    return;
+}
+
+static void op_or_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    or_reg(system, instr->x, instr->y);
+    return;
+}
+
+static void op_and_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    and_reg(system, instr->x, instr->y);
+    return;
+}
+
+static void op_xor_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    xor_reg(system, instr->x, instr->y);
+    return;
+}
+
+static void op_add_reg_to_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    add_reg_to_reg(system, instr->x, instr->y);
+    return;
+}
+
+static void op_sub_reg_from_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    sub_reg_from_reg(system, instr->x, instr->y);
+    return;
+}
+
+static void op_rsh_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    rsh_reg(system, instr->x);
+    return;
+}
+
+static void op_sub_reg_from_reg_1(Chip8_t *system, const Chip8_Instr *instr) {
+    sub_reg_from_reg_1(system, instr->x, instr->y);
+    return;
+}
+
+static void op_lsh_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    lsh_reg(system, instr->x);
+    return;
+}
+
+static void op_skip_instru_if_req_not_equal_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    skip_instru_if_req_not_equal_reg(system, instr->x, instr->y);
+    return;
+}
+
+static void op_set_idx_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    set_idx_reg(system, instr->nnn);
+    return;
+}
+
+static void op_jump_to_address_1(Chip8_t *system, const Chip8_Instr *instr) {
+    jump_to_address_1(system, instr->nnn);
+    return;
+}
+
+static void op_rand_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    rand_reg(system, instr->x, instr->nn);
+    return;
+}
+
+static void op_draw(Chip8_t *system, const Chip8_Instr *instr) {
+    draw(system, instr->x, instr->y, instr->n);
+    system->EMU_flags.draw_to_screen = 1;
+    return;
+}
+
+static void op_skip_instru_if_key_pressed(Chip8_t *system, const Chip8_Instr *instr) {
+    skip_instru_if_key_pressed(system, instr->x);
+    return;
+}
+
+static void op_skip_instru_if_key_not_pressed(Chip8_t *system, const Chip8_Instr *instr) {
+    skip_instru_if_key_not_pressed(system, instr->x);
+    return;
+}
+
+static void op_set_reg_to_delay_timer(Chip8_t *system, const Chip8_Instr *instr) {
+    set_reg_to_delay_timer(system, instr->x);
+    return;
+}
+
+static void op_get_key(Chip8_t *system, const Chip8_Instr *instr) {
+    get_key(system, instr->x);
+    return;
+}
+
+static void op_set_delay_timer_to_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    set_delay_timer_to_reg(system, instr->x);
+    return;
+}
+
+static void op_set_sound_timer_to_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    set_sound_timer_to_reg(system, instr->x);
+    return;
+}
 
-    /* Decode and execode opcode */
-    switch (system->opcode & 0xF000) {
+static void op_add_reg_to_i(Chip8_t *system, const Chip8_Instr *instr) {
+    add_reg_to_i(system, instr->x);
+    return;
+}
+
+static void op_set_i_to_sprite_addr(Chip8_t *system, const Chip8_Instr *instr) {
+    set_i_to_sprite_addr(system, instr->x);
+    return;
+}
+
+static void op_set_i_to_big_sprite_addr(Chip8_t *system, const Chip8_Instr *instr) {
+    set_i_to_big_sprite_addr(system, instr->x);
+    return;
+}
+
+static void op_rpl_save(Chip8_t *system, const Chip8_Instr *instr) {
+    rpl_save(system, instr->x);
+    return;
+}
+
+static void op_rpl_load(Chip8_t *system, const Chip8_Instr *instr) {
+    rpl_load(system, instr->x);
+    return;
+}
+
+static void op_store_bcd_reg(Chip8_t *system, const Chip8_Instr *instr) {
+    store_bcd_reg(system, instr->x);
+    return;
+}
+
+static void op_reg_dump(Chip8_t *system, const Chip8_Instr *instr) {
+    reg_dump(system, instr->x);
+    return;
+}
+
+static void op_reg_load(Chip8_t *system, const Chip8_Instr *instr) {
+    reg_load(system, instr->x);
+    return;
+}
+
+/* Kept out of line so the logging stays off the hot path of every core */
+__attribute__((noinline, cold)) static void invalid_opcode(Chip8_t *system, uint16_t opcode) {
+    #if !defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION)
+    LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "INVALID OPCODE: %" PRIX16, opcode);
+    #else
+    (void)opcode;
+    #endif
+    system->EMU_flags.exit = 1;
+    return;
+}
+
+static void op_invalid(Chip8_t *system, const Chip8_Instr *instr) {
+    invalid_opcode(system, instr->opcode);
+    return;
+}
+
+/* Select the handler for an opcode */
+static Chip8_Handler decode_opcode(uint16_t opcode) {
+    switch (opcode & 0xF000) {
         case 0x0000:
-            switch (system->opcode & 0x00FF) {
+            /* 0x00CN: Scrolls the screen down N rows (SUPER-CHIP). */
+            if ((opcode & 0x00F0) == 0x00C0) {
+                return op_scroll_down;
+            }
+            switch (opcode & 0x00FF) {
                 /* 0x00E0: Clears the screen. */
                 case 0x00E0:
-                    clear_screen(system);
-                    system->EMU_flags.draw_to_screen = 1;
-                    break;
+                    return op_clear_screen;
 
                 /* 0x00EE: Returns from a subroutine. */
                 case 0x00EE:
-                    return_from_subroutine(system);
-                    break;
-                
-                default:
-                    LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "INVALID OPCODE: %" PRIX16, system->opcode);
-                    #if defined(DEBUG)
-                    #else
-                    system->EMU_flags.exit = 1;
-                    #endif
-                    break;
+                    return op_return_from_subroutine;
+
+                /* 0x00FB: Scrolls the screen right by 4 pixels (SUPER-CHIP). */
+                case 0x00FB:
+                    return op_scroll_right;
+
+                /* 0x00FC: Scrolls the screen left by 4 pixels (SUPER-CHIP). */
+                case 0x00FC:
+                    return op_scroll_left;
+
+                /* 0x00FD: Exits the interpreter (SUPER-CHIP). */
+                case 0x00FD:
+                    return op_exit;
+
+                /* 0x00FE: Switches to 64 x 32 pixels (SUPER-CHIP). */
+                case 0x00FE:
+                    return op_lores;
+
+                /* 0x00FF: Switches to 128 x 64 pixels (SUPER-CHIP). */
+                case 0x00FF:
+                    return op_hires;
             }
             break;
-        
+
         /* 0x1NNN: Jumps to address NNN. */
         case 0x1000:
-            jump_to_address(system, nnn);
-            break;
+            return op_jump_to_address;
 
         /* 0x2NNN: Calls subroutine at NNN. */
         case 0x2000:
-            call_subroutine(system, nnn);
-            break;
-        
+            return op_call_subroutine;
+
         /* 0x3XNN: Skips the next instruction if VX equals NN. */
         case 0x3000:
-            skip_instru_if_equal(system, x, nn);
-            break;
-        
+            return op_skip_instru_if_equal;
+
         /* 0x4XNN: Skips the next instruction if VX does not equal NN. */
         case 0x4000:
-            skip_instru_if_not_equal(system, x, nn);
-            break;
-        
+            return op_skip_instru_if_not_equal;
+
         /* 0x5XNN: Skips the next instruction if VX equals VY. */
         case 0x5000:
-            skip_instru_if_equal_1(system, x, nn);
-            break;
-        
+            return op_skip_instru_if_equal_1;
+
         /* 6XNN: Sets VX to NN. */
         case 0x6000:
-            set_reg(system, x, nn);
-            break;
-        
+            return op_set_reg;
+
         /* 7XNN: Adds NN to VX. */
         case 0x7000:
-            add_to_reg(system, x, nn);
-            break;
+            return op_add_to_reg;
 
         case 0x8000:
-            switch (system->opcode & 0x000F) {
+            switch (opcode & 0x000F) {
                 /* 8XY0: Sets VX to the value of VY. */
                 case 0x0000:
-                    mov_reg(system, x, y);
-                    break;
+                    return op_mov_reg;
 
                 /* 8XY1: Sets VX to VX OR VY. */
                 case 0x0001:
-                    or_reg(system, x, y);
-                    break;
-                
+                    return op_or_reg;
+
                 /* 8XY2: Sets VX to VX AND VY. */
                 case 0x0002:
-                    and_reg(system, x, y);
-                    break;
-                
+                    return op_and_reg;
+
                 /* 8XY3: Sets VX to VX XOR VY. */
                 case 0x0003:
-                    xor_reg(system, x, y);
-                    break;
-                
+                    return op_xor_reg;
+
                 /* 8XY4: Adds VY to VX. */
                 case 0x0004:
-                    add_reg_to_reg(system, x, y);
-                    break;
-                
+                    return op_add_reg_to_reg;
+
                 /* 8XY5: VY is subtracted from VX. */
                 case 0x0005:
-                    sub_reg_from_reg(system, x, y);
-                    break;
+                    return op_sub_reg_from_reg;
 
                 /* 8XY6: Shifts VX to the right by 1. */
                 case 0x0006:
-                    rsh_reg(system, x);
-                    break;
-                
+                    return op_rsh_reg;
+
                 /* 8XY7: Sets VX to VY minus VX. */
                 case 0x0007:
-                    sub_reg_from_reg_1(system, x, y);
-                    break;
+                    return op_sub_reg_from_reg_1;
 
                 /* 8XYE: Shifts VX to the left by 1. */
                 case 0x000E:
-                    lsh_reg(system, x);
-                    break;
-
-                default:
-                    LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "INVALID OPCODE: %" PRIX16, system->opcode);
-                    #if defined(DEBUG)
-                    #else
-                    system->EMU_flags.exit = 1;
-                    #endif
-                    break;
+                    return op_lsh_reg;
             }
             break;
-        
+
         /* 9XY0: Skips the next instruction if VX does not equal VY. */
         case 0x9000:
-            skip_instru_if_req_not_equal_reg(system, x, y);
-            break;
+            return op_skip_instru_if_req_not_equal_reg;
 
         /* ANNN: Sets I to the address NNN. */
         case 0xA000:
-            set_idx_reg(system, nnn);
-            break;
+            return op_set_idx_reg;
 
         /* BNNN: Jumps to the address NNN plus V0. */
         case 0xB000:
-            jump_to_address_1(system, nnn);
-            break;
+            return op_jump_to_address_1;
 
         /* CXNN: Sets VX to the result of a bitwise and operation on a random number. */
         case 0xC000:
-            rand_reg(system, x, nn);
-            break;
+            return op_rand_reg;
 
         /* DXYN: Draws a sprite at coordinate (VX, VY). */
         case 0xD000:
-            draw(system, x, y, n);
-            system->EMU_flags.draw_to_screen = 1;
-            break;
+            return op_draw;
 
         case 0xE000:
-            switch (system->opcode & 0x00FF) {
+            switch (opcode & 0x00FF) {
                 /* EX9E: Skips the next instruction if the key stored in VX is pressed. */
                 case 0x009E:
-                    skip_instru_if_key_pressed(system, x);
-                    break;
+                    return op_skip_instru_if_key_pressed;
 
                 /* EXA1: Skips the next instruction if the key stored in VX is not pressed. */
                 case 0x00A1:
-                    skip_instru_if_key_not_pressed(system, x);
-                    break;
-
-                default:
-                    LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "INVALID OPCODE: %" PRIX16, system->opcode);
-                    #if defined(DEBUG)
-                    #else
-                    system->EMU_flags.exit = 1;
-                    #endif
-                    break;
+                    return op_skip_instru_if_key_not_pressed;
             }
             break;
 
         case 0xF000:
-            switch (system->opcode & 0x00FF) {
+            switch (opcode & 0x00FF) {
                 /* FX07: Sets VX to the value of the delay timer. */
                 case 0x0007:
-                    set_reg_to_delay_timer(system, x);
-                    break;
+                    return op_set_reg_to_delay_timer;
 
                 /* FX0A: A key press is awaited, and then stored in VX. */
                 case 0x000A:
-                    get_key(system, x);
-                    break;
+                    return op_get_key;
 
                 /* FX15: Sets the delay timer to VX. */
                 case 0x0015:
-                    set_delay_timer_to_reg(system, x);
-                    break;
+                    return op_set_delay_timer_to_reg;
 
                 /* FX18: Sets the sound timer to VX. */
                 case 0x0018:
-                    set_sound_timer_to_reg(system, x);
-                    break;
+                    return op_set_sound_timer_to_reg;
 
                 /* FX1E: Adds VX to I. */
                 case 0x001E:
-                    add_reg_to_i(system, x);
-                    break;
+                    return op_add_reg_to_i;
 
                 /* FX29: Sets I to the location of the sprite for the character in VX. */
                 case 0x0029:
-                    set_i_to_sprite_addr(system, x);
-                    break;
+                    return op_set_i_to_sprite_addr;
+
+                /* FX30: Sets I to the location of the 8 x 10 sprite for the digit in VX (SUPER-CHIP). */
+                case 0x0030:
+                    return op_set_i_to_big_sprite_addr;
 
                 /* FX33: Stores the binary-coded decimal representation of VX. */
                 case 0x0033:
-                    store_bcd_reg(system, x);
-                    break;
+                    return op_store_bcd_reg;
 
                 /* FX55: Stores from V0 to VX (including VX) in memory. */
                 case 0x0055:
-                    reg_dump(system, x);
-                    break;
+                    return op_reg_dump;
 
                 /* FX65: Fills from V0 to VX (including VX) with values from memory. */
                 case 0x0065:
-                    reg_load(system, x);
-                    break;
-                
-                default:
-                    LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "INVALID OPCODE: %" PRIX16, system->opcode);
-                    #if defined(DEBUG)
-                    #else
-                    system->EMU_flags.exit = 1;
-                    #endif
-                    break;
+                    return op_reg_load;
+
+                /* FX75: Stores V0 to VX (including VX) in the RPL user flags (SUPER-CHIP). */
+                case 0x0075:
+                    return op_rpl_save;
+
+                /* FX85: Fills V0 to VX (including VX) from the RPL user flags (SUPER-CHIP). */
+                case 0x0085:
+                    return op_rpl_load;
             }
             break;
+    }
+    return op_invalid;
+}
 
-        default:
-            LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "INVALID OPCODE: %" PRIX16, system->opcode);
-            #if defined(DEBUG)
-            #else
-            system->EMU_flags.exit = 1;
-            #endif
+/*
+Decode the instruction starting at an address
+    - The opcode is parsed once and stored with its handler
+*/
+static inline void predecode_addr(Chip8_t *system, uint16_t addr, uint16_t opcode) {
+    Chip8_Instr *instr = &system->decoded[addr];
+
+    instr->opcode  = opcode;
+    instr->n       =  opcode & 0x000F;
+    instr->nn      =  opcode & 0x00FF;
+    instr->nnn     =  opcode & 0x0FFF;
+    instr->x       = (opcode & 0x0F00) >> 8;
+    instr->y       = (opcode & 0x00F0) >> 4;
+    instr->handler = decode_opcode(opcode);
+    return;
+}
+
+/* Opcode starting at an address, the low byte wraps around to the start of memory at the last address */
+static inline uint16_t opcode_at(Chip8_t *system, uint16_t addr) {
+    return system->memory[addr] << 8 | system->memory[(addr + 1) & (MEMORY_SIZE - 1)];
+}
+
+/*
+Decode again after memory has been written
+    - A written byte belongs to the instruction starting at it and the one starting the byte before
+    - Data writes usually do not change the opcode there, so those entries are kept
+    - The pages of both are marked dirty for chip8_restore()
+*/
+static void predecode_range(Chip8_t *system, uint16_t addr, uint16_t len) {
+    uint16_t i, at, opcode;
+    for (i = 0; i <= len; i++) {
+        at = (addr + i - 1) & (MEMORY_SIZE - 1);
+        system->dirty_pages |= (uint64_t)1 << (at / MEMORY_PAGE_SIZE);
+        opcode = opcode_at(system, at);
+        if (system->decoded[at].opcode != opcode) {
+            predecode_addr(system, at, opcode);
+        }
+    }
+    return;
+}
+
+/* Decode all of memory after it was replaced as a whole, every page counts as dirty */
+void chip8_predecode(Chip8_t *system) {
+    uint16_t addr;
+    for (addr = 0; addr < MEMORY_SIZE; addr++) {
+        predecode_addr(system, addr, opcode_at(system, addr));
+    }
+    system->dirty_pages = ~(uint64_t)0;
+    return;
+}
+
+/* Copy data into memory at addr, wrapping around like the instructions that write memory, and decode only what it changed */
+void chip8_write(Chip8_t *system, uint16_t addr, const uint8_t *data, uint16_t len) {
+    uint16_t i;
+    for (i = 0; i < len; i++) {
+        system->memory[(addr + i) & (MEMORY_SIZE - 1)] = data[i];
+    }
+    predecode_range(system, addr, len);
+    return;
+}
+
+/*
+Bring a system back to a copy of itself taken earlier
+    - The system must have been equal to snapshot after its last chip8_restore() or struct copy, only what changed since is copied back
+    - Registers, screen and flags are small and copied whole, memory and the decoded instructions only in the pages marked in dirty_pages
+    - Resetting this way is much cheaper than chip8_initialize(), which clears and decodes all 4 KB
+*/
+void chip8_restore(Chip8_t *system, const Chip8_t *snapshot) {
+    uint64_t pages = system->dirty_pages;
+    int page;
+
+    memcpy(system, snapshot, offsetof(Chip8_t, memory));
+    memcpy(system->V, snapshot->V, offsetof(Chip8_t, decoded) - offsetof(Chip8_t, V));
+    while (pages) {
+        page = __builtin_ctzll(pages);
+        pages &= pages - 1;
+        memcpy(system->memory + page * MEMORY_PAGE_SIZE, snapshot->memory + page * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE);
+        memcpy(system->decoded + page * MEMORY_PAGE_SIZE, snapshot->decoded + page * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE * sizeof(Chip8_Instr));
+    }
+    system->dirty_pages = 0;
+    return;
+}
+
+void chip8_emulatecycle(Chip8_t *system) {
+    /* Fetch the decoded instruction */
+    const Chip8_Instr *instr = &system->decoded[system->pc & (MEMORY_SIZE - 1)];
+    system->opcode = instr->opcode;
+
+    /* Store next instruction */
+    system->pc += sizeof(uint16_t);
+
+    /* Execute opcode */
+    instr->handler(system, instr);
+    return;
+}
+
+/* Same as chip8_emulatecycle() with an instruction decoded from another system running the same code at pc */
+void chip8_execute(Chip8_t *system, const Chip8_Instr *instr) {
+    system->opcode = instr->opcode;
+    system->pc += sizeof(uint16_t);
+    instr->handler(system, instr);
+    return;
+}
+
+/*
+Memory the instruction will read or write when it executes next, besides fetching itself
+    - Every access starts at I and wraps around memory, so it is known from the operands before running it
+    - len is 0 when the instruction touches no memory
+*/
+Chip8_Access chip8_access(const Chip8_t *system, const Chip8_Instr *instr, uint16_t *addr, uint16_t *len) {
+    *addr = system->I & (MEMORY_SIZE - 1);
+    *len = 0;
+    if (instr->handler == op_draw) {
+        if (system->width == DISPLAY_WIDTH) {
+            *len = instr->n;
+        }
+        else {
+            *len = instr->n ? instr->n : 32;
+        }
+        return *len ? CHIP8_ACCESS_READ : CHIP8_ACCESS_NONE;
+    }
+    if (instr->handler == op_reg_load) {
+        *len = instr->x;
+        return *len ? CHIP8_ACCESS_READ : CHIP8_ACCESS_NONE;
+    }
+    if (instr->handler == op_reg_dump) {
+        *len = instr->x;
+        return *len ? CHIP8_ACCESS_WRITE : CHIP8_ACCESS_NONE;
+    }
+    if (instr->handler == op_store_bcd_reg) {
+        *len = 3;
+        return CHIP8_ACCESS_WRITE;
+    }
+    return CHIP8_ACCESS_NONE;
+}
+
+/*
+Whether the instruction just executed wrote over an address marked in map, MEMORY_SIZE bytes that are non-zero where translated code came from
+    - Only FX33 and FX55 write memory, FX55 is taken to write V0 to Vx
+    - Counted over the length, I may be anywhere up to 0xFFFF and the addresses wrap around memory
+*/
+int chip8_wrote_over(const Chip8_t *system, const uint8_t *map) {
+    uint16_t k, len;
+
+    switch (system->opcode & 0xF0FF) {
+        case 0xF033:
+            len = 3;
+            break;
+        case 0xF055:
+            len = ((system->opcode & 0x0F00) >> 8) + 1;
             break;
+        default:
+            return 0;
     }
+
+    for (k = 0; k < len; k++) {
+        if (map[(system->I + k) & (MEMORY_SIZE - 1)]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Whether executing the instruction would stop the emulator as an invalid opcode */
+int chip8_invalid(const Chip8_Instr *instr) {
+    return instr->handler == op_invalid;
+}
+
+/* What an idle loop may change, it is compared from one iteration to the next */
+typedef struct {
+    uint8_t V[REGISTER_COUNT];
+    uint16_t I;
+    uint16_t sp;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+} Idle_Snapshot;
+
+static void idle_snapshot(const Chip8_t *system, Idle_Snapshot *snap) {
+    memcpy(snap->V, system->V, sizeof(snap->V));
+    snap->I = system->I;
+    snap->sp = system->sp;
+    snap->delay_timer = system->delay_timer;
+    snap->sound_timer = system->sound_timer;
     return;
 }
 
+static int idle_unchanged(const Chip8_t *system, const Idle_Snapshot *snap) {
+    return memcmp(snap->V, system->V, sizeof(snap->V)) == 0 && snap->I == system->I && snap->sp == system->sp
+        && snap->delay_timer == system->delay_timer && snap->sound_timer == system->sound_timer;
+}
+
+/* Instructions that only read and write what Idle_Snapshot holds, everything else ends the search for an idle loop */
+static int idle_safe(Chip8_Handler handler) {
+    return handler != op_invalid && handler != op_clear_screen && handler != op_return_from_subroutine && handler != op_call_subroutine
+        && handler != op_rand_reg && handler != op_draw && handler != op_store_bcd_reg && handler != op_reg_dump
+        && handler != op_scroll_down && handler != op_scroll_right && handler != op_scroll_left && handler != op_exit
+        && handler != op_lores && handler != op_hires && handler != op_rpl_save;
+}
+
+/*
+Execute budget instructions on the interpreter, skipping busy waits
+    - A jump to an address at or before itself, or FX0A finding no key, starts a loop. One iteration from its head is then run while watching it.
+    - If that iteration only used idle_safe() instructions and came back to the head with the registers, I, sp and timers unchanged, every further iteration this frame does the same: timers tick and keys change only between frames
+    - Whole iterations are then counted in elided instead of run, the remainder still runs, so the frame ends in the exact state it would have without skipping
+    - Returns the instructions executed and elided
+*/
+int chip8_run_idle(Chip8_t *system, int budget, uint64_t *elided) {
+    const Chip8_Instr *instr;
+    Idle_Snapshot snap;
+    uint16_t pc, head;
+    int i = 0, n, safe, skip;
+
+    while (i < budget && !system->EMU_flags.exit) {
+        pc = system->pc;
+        instr = &system->decoded[pc & (MEMORY_SIZE - 1)];
+        chip8_emulatecycle(system);
+        i++;
+
+        if (!((instr->handler == op_jump_to_address && instr->nnn <= pc) || (instr->handler == op_get_key && system->pc == pc))) {
+            continue;
+        }
+
+        head = system->pc;
+        idle_snapshot(system, &snap);
+        safe = 1;
+        for (n = 0; i < budget && n < IDLE_MAX_LOOP && !system->EMU_flags.exit; ) {
+            instr = &system->decoded[system->pc & (MEMORY_SIZE - 1)];
+            safe &= idle_safe(instr->handler);
+            chip8_emulatecycle(system);
+            i++;
+            n++;
+            if (system->pc == head) {
+                break;
+            }
+        }
+
+        if (safe && n > 0 && system->pc == head && idle_unchanged(system, &snap)) {
+            skip = (budget - i) / n * n;
+            i += skip;
+            *elided += skip;
+        }
+    }
+    return i;
+}
+
+#if defined(__GNUC__)
+
+/* Handlers in the same order as the labels in chip8_run_threaded(), the first one is used for every invalid opcode. */
+static const Chip8_Handler threaded_handlers[] = {
+    op_invalid,
+    op_clear_screen,
+    op_return_from_subroutine,
+    op_jump_to_address,
+    op_call_subroutine,
+    op_skip_instru_if_equal,
+    op_skip_instru_if_not_equal,
+    op_skip_instru_if_equal_1,
+    op_set_reg,
+    op_add_to_reg,
+    op_mov_reg,
+    op_or_reg,
+    op_and_reg,
+    op_xor_reg,
+    op_add_reg_to_reg,
+    op_sub_reg_from_reg,
+    op_rsh_reg,
+    op_sub_reg_from_reg_1,
+    op_lsh_reg,
+    op_skip_instru_if_req_not_equal_reg,
+    op_set_idx_reg,
+    op_jump_to_address_1,
+    op_rand_reg,
+    op_draw,
+    op_skip_instru_if_key_pressed,
+    op_skip_instru_if_key_not_pressed,
+    op_set_reg_to_delay_timer,
+    op_get_key,
+    op_set_delay_timer_to_reg,
+    op_set_sound_timer_to_reg,
+    op_add_reg_to_i,
+    op_set_i_to_sprite_addr,
+    op_store_bcd_reg,
+    op_reg_dump,
+    op_reg_load,
+    op_scroll_down,
+    op_scroll_right,
+    op_scroll_left,
+    op_exit,
+    op_lores,
+    op_hires,
+    op_set_i_to_big_sprite_addr,
+    op_rpl_save,
+    op_rpl_load
+};
+
+/* Every possible opcode mapped to its label in chip8_run_threaded(). */
+static uint8_t threaded_table[0x10000];
+
+/*
+Build the opcode table before main() runs
+    - The handler decode_opcode() picks for an opcode is looked up in threaded_handlers
+    - Done at load time so instances on different threads never race on it
+*/
+__attribute__((constructor)) static void build_threaded_table(void) {
+    uint32_t opcode;
+    uint8_t i;
+    Chip8_Handler handler;
+
+    for (opcode = 0; opcode <= 0xFFFF; opcode++) {
+        handler = decode_opcode(opcode);
+        for (i = 0; threaded_handlers[i] != handler; i++);
+        threaded_table[opcode] = i;
+    }
+    return;
+}
+
+/*
+Execute instructions with threaded dispatch
+    - Every handler ends by fetching the next opcode and jumping straight to its label, there is no central loop or switch
+    - Semantically the same as calling chip8_emulatecycle() budget times, stopping after an invalid opcode or 00FD like the interpreter loop
+    - Returns the instructions executed
+*/
+int chip8_run_threaded(Chip8_t *system, int budget) {
+    static const void *labels[] = {
+        &&lbl_invalid,
+        &&lbl_clear_screen,
+        &&lbl_return_from_subroutine,
+        &&lbl_jump_to_address,
+        &&lbl_call_subroutine,
+        &&lbl_skip_instru_if_equal,
+        &&lbl_skip_instru_if_not_equal,
+        &&lbl_skip_instru_if_equal_1,
+        &&lbl_set_reg,
+        &&lbl_add_to_reg,
+        &&lbl_mov_reg,
+        &&lbl_or_reg,
+        &&lbl_and_reg,
+        &&lbl_xor_reg,
+        &&lbl_add_reg_to_reg,
+        &&lbl_sub_reg_from_reg,
+        &&lbl_rsh_reg,
+        &&lbl_sub_reg_from_reg_1,
+        &&lbl_lsh_reg,
+        &&lbl_skip_instru_if_req_not_equal_reg,
+        &&lbl_set_idx_reg,
+        &&lbl_jump_to_address_1,
+        &&lbl_rand_reg,
+        &&lbl_draw,
+        &&lbl_skip_instru_if_key_pressed,
+        &&lbl_skip_instru_if_key_not_pressed,
+        &&lbl_set_reg_to_delay_timer,
+        &&lbl_get_key,
+        &&lbl_set_delay_timer_to_reg,
+        &&lbl_set_sound_timer_to_reg,
+        &&lbl_add_reg_to_i,
+        &&lbl_set_i_to_sprite_addr,
+        &&lbl_store_bcd_reg,
+        &&lbl_reg_dump,
+        &&lbl_reg_load,
+        &&lbl_scroll_down,
+        &&lbl_scroll_right,
+        &&lbl_scroll_left,
+        &&lbl_exit,
+        &&lbl_lores,
+        &&lbl_hires,
+        &&lbl_set_i_to_big_sprite_addr,
+        &&lbl_rpl_save,
+        &&lbl_rpl_load
+    };
+    uint16_t opcode;
+    int remaining = budget;
+
+    #define X   ((opcode & 0x0F00) >> 8)
+    #define Y   ((opcode & 0x00F0) >> 4)
+    #define N   (opcode & 0x000F)
+    #define NN  (opcode & 0x00FF)
+    #define NNN (opcode & 0x0FFF)
+    #define DISPATCH() \
+        do { \
+            if (remaining <= 0) goto done; \
+            remaining--; \
+            opcode = opcode_at(system, system->pc & (MEMORY_SIZE - 1)); \
+            system->opcode = opcode; \
+            system->pc += sizeof(uint16_t); \
+            goto *labels[threaded_table[opcode]]; \
+        } while (0)
+
+    DISPATCH();
+
+lbl_invalid:
+    invalid_opcode(system, opcode);
+    goto done;
+lbl_clear_screen:
+    clear_screen(system);
+    system->EMU_flags.draw_to_screen = 1;
+    DISPATCH();
+lbl_return_from_subroutine:
+    return_from_subroutine(system);
+    DISPATCH();
+lbl_jump_to_address:
+    jump_to_address(system, NNN);
+    DISPATCH();
+lbl_call_subroutine:
+    call_subroutine(system, NNN);
+    DISPATCH();
+lbl_skip_instru_if_equal:
+    skip_instru_if_equal(system, X, NN);
+    DISPATCH();
+lbl_skip_instru_if_not_equal:
+    skip_instru_if_not_equal(system, X, NN);
+    DISPATCH();
+lbl_skip_instru_if_equal_1:
+    skip_instru_if_equal_1(system, X, NN);
+    DISPATCH();
+lbl_set_reg:
+    set_reg(system, X, NN);
+    DISPATCH();
+lbl_add_to_reg:
+    add_to_reg(system, X, NN);
+    DISPATCH();
+lbl_mov_reg:
+    mov_reg(system, X, Y);
+    DISPATCH();
+lbl_or_reg:
+    or_reg(system, X, Y);
+    DISPATCH();
+lbl_and_reg:
+    and_reg(system, X, Y);
+    DISPATCH();
+lbl_xor_reg:
+    xor_reg(system, X, Y);
+    DISPATCH();
+lbl_add_reg_to_reg:
+    add_reg_to_reg(system, X, Y);
+    DISPATCH();
+lbl_sub_reg_from_reg:
+    sub_reg_from_reg(system, X, Y);
+    DISPATCH();
+lbl_rsh_reg:
+    rsh_reg(system, X);
+    DISPATCH();
+lbl_sub_reg_from_reg_1:
+    sub_reg_from_reg_1(system, X, Y);
+    DISPATCH();
+lbl_lsh_reg:
+    lsh_reg(system, X);
+    DISPATCH();
+lbl_skip_instru_if_req_not_equal_reg:
+    skip_instru_if_req_not_equal_reg(system, X, Y);
+    DISPATCH();
+lbl_set_idx_reg:
+    set_idx_reg(system, NNN);
+    DISPATCH();
+lbl_jump_to_address_1:
+    jump_to_address_1(system, NNN);
+    DISPATCH();
+lbl_rand_reg:
+    rand_reg(system, X, NN);
+    DISPATCH();
+lbl_draw:
+    draw(system, X, Y, N);
+    system->EMU_flags.draw_to_screen = 1;
+    DISPATCH();
+lbl_skip_instru_if_key_pressed:
+    skip_instru_if_key_pressed(system, X);
+    DISPATCH();
+lbl_skip_instru_if_key_not_pressed:
+    skip_instru_if_key_not_pressed(system, X);
+    DISPATCH();
+lbl_set_reg_to_delay_timer:
+    set_reg_to_delay_timer(system, X);
+    DISPATCH();
+lbl_get_key:
+    get_key(system, X);
+    DISPATCH();
+lbl_set_delay_timer_to_reg:
+    set_delay_timer_to_reg(system, X);
+    DISPATCH();
+lbl_set_sound_timer_to_reg:
+    set_sound_timer_to_reg(system, X);
+    DISPATCH();
+lbl_add_reg_to_i:
+    add_reg_to_i(system, X);
+    DISPATCH();
+lbl_set_i_to_sprite_addr:
+    set_i_to_sprite_addr(system, X);
+    DISPATCH();
+lbl_store_bcd_reg:
+    store_bcd_reg(system, X);
+    DISPATCH();
+lbl_reg_dump:
+    reg_dump(system, X);
+    DISPATCH();
+lbl_reg_load:
+    reg_load(system, X);
+    DISPATCH();
+lbl_scroll_down:
+    scroll_down(system, N);
+    system->EMU_flags.draw_to_screen = 1;
+    DISPATCH();
+lbl_scroll_right:
+    scroll_right(system);
+    system->EMU_flags.draw_to_screen = 1;
+    DISPATCH();
+lbl_scroll_left:
+    scroll_left(system);
+    system->EMU_flags.draw_to_screen = 1;
+    DISPATCH();
+lbl_exit:
+    system->EMU_flags.exit = 1;
+    goto done;
+lbl_lores:
+    set_resolution(system, 0);
+    system->EMU_flags.draw_to_screen = 1;
+    DISPATCH();
+lbl_hires:
+    set_resolution(system, 1);
+    system->EMU_flags.draw_to_screen = 1;
+    DISPATCH();
+lbl_set_i_to_big_sprite_addr:
+    set_i_to_big_sprite_addr(system, X);
+    DISPATCH();
+lbl_rpl_save:
+    rpl_save(system, X);
+    DISPATCH();
+lbl_rpl_load:
+    rpl_load(system, X);
+    DISPATCH();
+
+done:
+    #undef X
+    #undef Y
+    #undef N
+    #undef NN
+    #undef NNN
+    #undef DISPATCH
+    return budget - remaining;
+}
+
+#else
+
+/* Without computed goto this is the regular interpreter. */
+int chip8_run_threaded(Chip8_t *system, int budget) {
+    int i;
+    for (i = 0; i < budget; i++) {
+        chip8_emulatecycle(system);
+        if (system->EMU_flags.exit) {
+            return i + 1;
+        }
+    }
+    return budget;
+}
+
+#endif
+
 void chip8_print(Chip8_t *system) {
     int i;
 
@@ -1,14 +1,17 @@
+#include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "chip8.h"
-#include "graphics.h"
 #include "debugger.h"
 
+static const char *compare_names[] = {"==", "!=", "<", ">"};
+
 static int str_to_u16_1(const char *s, uint16_t *i) {
     long l;
     errno = 0;
@@ -42,15 +45,277 @@ static int str_to_u16_2(const char *s, uint16_t *x, uint16_t *y) {
     return 0;
 }
 
-void debugger_cli(Debugger_t *dbg, Chip8_t *system, Chip8_Graphics *gfx) {
+static int str_to_u64_1(const char *s, uint64_t *i) {
+    unsigned long long l;
+    errno = 0;
+
+    if (strchr(s, '-')) {
+        return -1;
+    }
+    l = strtoull(s, NULL, 16);
+    if (errno != 0) {
+        return -1;
+    }
+    *i = (uint64_t)l;
+
+    return 0;
+}
+
+/* Parse "<V0x0|I> <==|!=|<|>> <0x0>" into a condition */
+static int str_to_condition(const char *s, Debug_Condition *cond) {
+    char reg[4], op[3];
+    unsigned int value;
+    char *end = NULL;
+    long l;
+    int i;
+
+    if (sscanf(s, "%3s %2s %x", reg, op, &value) != 3 || value > UINT16_MAX) {
+        return -1;
+    }
+    if ((reg[0] == 'I' || reg[0] == 'i') && reg[1] == '\0') {
+        cond->reg = DEBUGGER_REG_I;
+    }
+    else {
+        l = strtol(reg[0] == 'V' || reg[0] == 'v' ? reg + 1 : reg, &end, 16);
+        if (*end != '\0' || l < 0 || l >= REGISTER_COUNT) {
+            return -2;
+        }
+        cond->reg = (uint8_t)l;
+    }
+    for (i = 0; i < (int)(sizeof(compare_names) / sizeof(compare_names[0])); i++) {
+        if (strcmp(op, compare_names[i]) == 0) {
+            cond->compare = (uint8_t)i;
+            cond->value = (uint16_t)value;
+            cond->held = false;
+            return 0;
+        }
+    }
+    return -2;
+}
+
+static void print_condition(const Debug_Condition *cond) {
+    if (cond->reg == DEBUGGER_REG_I) {
+        printf("I %s %" PRIX16, compare_names[cond->compare], cond->value);
+    }
+    else {
+        printf("V%" PRIX8 " %s %" PRIX16, cond->reg, compare_names[cond->compare], cond->value);
+    }
+    return;
+}
+
+static bool condition_true(const Debug_Condition *cond, const Chip8_t *system) {
+    uint16_t v = cond->reg == DEBUGGER_REG_I ? system->I : system->V[cond->reg];
+
+    switch (cond->compare) {
+        case DEBUG_EQUAL:
+            return v == cond->value;
+        case DEBUG_NOT_EQUAL:
+            return v != cond->value;
+        case DEBUG_LESS:
+            return v < cond->value;
+        default:
+            return v > cond->value;
+    }
+}
+
+/* Set or clear points at an address, watches counts the addresses with a watchpoint */
+void debugger_set_point(Debugger_t *dbg, uint16_t addr, uint8_t point, bool on) {
+    uint8_t *p = &dbg->points[addr & (MEMORY_SIZE - 1)];
+    bool watched = *p & (DEBUG_WATCH_READ | DEBUG_WATCH_WRITE);
+
+    *p = on ? *p | point : *p & ~point;
+    dbg->watches += (bool)(*p & (DEBUG_WATCH_READ | DEBUG_WATCH_WRITE)) - watched;
+    return;
+}
+
+static void toggle_point(Debugger_t *dbg, uint16_t addr, uint8_t point) {
+    uint8_t *p = &dbg->points[addr & (MEMORY_SIZE - 1)];
+
+    debugger_set_point(dbg, addr, point, !(*p & point));
+    printf("%s %s at %03" PRIX16 "\n", point == DEBUG_BREAK ? "Breakpoint" : (point == DEBUG_WATCH_READ ? "Read watchpoint" : "Write watchpoint"), *p & point ? "set" : "cleared", addr & (MEMORY_SIZE - 1));
+    return;
+}
+
+static void list_points(const Debugger_t *dbg) {
+    int addr, i;
+
+    for (addr = 0; addr < MEMORY_SIZE; addr++) {
+        if (dbg->points[addr]) {
+            printf("%03X:%s%s%s\n", addr, dbg->points[addr] & DEBUG_BREAK ? " break" : "", dbg->points[addr] & DEBUG_WATCH_READ ? " read" : "", dbg->points[addr] & DEBUG_WATCH_WRITE ? " write" : "");
+        }
+    }
+    for (i = 0; i < dbg->condition_count; i++) {
+        printf("%d: ", i);
+        print_condition(&dbg->conditions[i]);
+        printf("\n");
+    }
+    return;
+}
+
+void debugger_init(Debugger_t *dbg) {
+    memset(dbg, 0, sizeof(*dbg));
+    return;
+}
+
+/* Take the system over from the selected core, the command line comes up before the next instruction */
+void debugger_attach(Debugger_t *dbg) {
+    dbg->active = true;
+    dbg->run = false;
+    dbg->resume = false;
+    printf("Debugger attached, 'h' shows all commands.\n");
+    return;
+}
+
+/* Stop before the next instruction without the command line, for a remote client */
+void debugger_halt(Debugger_t *dbg) {
+    dbg->active = true;
+    dbg->run = false;
+    dbg->stop = DEBUG_STOP_HALT;
+    return;
+}
+
+/* Run count instructions on the instrumented core, 0 runs until something breaks */
+void debugger_resume(Debugger_t *dbg, uint64_t count) {
+    dbg->active = true;
+    dbg->run = true;
+    dbg->resume = true;
+    dbg->executed = 0;
+    dbg->exec_max = count;
+    dbg->stop = DEBUG_STOP_NONE;
+    return;
+}
+
+/* Add a condition from "<V0x0|I> <==|!=|<|>> <0x0>", it only breaks once it turns true after this */
+int debugger_add_condition(Debugger_t *dbg, const Chip8_t *system, const char *s) {
+    Debug_Condition cond;
+
+    if (dbg->condition_count >= DEBUGGER_MAX_CONDITIONS) {
+        return -1;
+    }
+    if (str_to_condition(s, &cond) != 0) {
+        return -2;
+    }
+    cond.held = condition_true(&cond, system);
+    dbg->conditions[dbg->condition_count++] = cond;
+    return 0;
+}
+
+/* Whether the instruction at pc has to break before it runs, prints why */
+static bool break_before(Debugger_t *dbg, const Chip8_t *system, uint16_t pc, const Chip8_Instr *instr) {
+    uint16_t addr, len, i;
+    Chip8_Access access;
+
+    dbg->stop_addr = pc;
+    if (dbg->points[pc] & DEBUG_BREAK) {
+        dbg->stop = DEBUG_STOP_BREAK;
+        printf("BREAKPOINT AT %03" PRIX16 "\n", pc);
+        return true;
+    }
+    if (chip8_invalid(instr)) {
+        dbg->stop = DEBUG_STOP_INVALID;
+        printf("INVALID OPCODE %04" PRIX16 " AT %03" PRIX16 "\n", instr->opcode, pc);
+        return true;
+    }
+    if ((instr->opcode & 0xF000) == 0x2000 && system->sp >= STACK_SIZE) {
+        dbg->stop = DEBUG_STOP_OVERFLOW;
+        printf("STACK OVERFLOW AT %03" PRIX16 ", SP: %" PRIX16 "\n", pc, system->sp);
+        return true;
+    }
+    if (instr->opcode == 0x00EE && (system->sp == 0 || system->sp > STACK_SIZE)) {
+        dbg->stop = DEBUG_STOP_UNDERFLOW;
+        printf("STACK UNDERFLOW AT %03" PRIX16 ", SP: %" PRIX16 "\n", pc, system->sp);
+        return true;
+    }
+    if (dbg->watches == 0) {
+        return false;
+    }
+
+    access = chip8_access(system, instr, &addr, &len);
+    for (i = 0; i < len; i++) {
+        if (dbg->points[(addr + i) & (MEMORY_SIZE - 1)] & (access == CHIP8_ACCESS_READ ? DEBUG_WATCH_READ : DEBUG_WATCH_WRITE)) {
+            dbg->stop = access == CHIP8_ACCESS_READ ? DEBUG_STOP_READ : DEBUG_STOP_WRITE;
+            dbg->stop_addr = (addr + i) & (MEMORY_SIZE - 1);
+            printf("WATCHPOINT %s %03X BY %04" PRIX16 " AT %03" PRIX16 "\n", access == CHIP8_ACCESS_READ ? "READ" : "WRITE", (addr + i) & (MEMORY_SIZE - 1), instr->opcode, pc);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Whether a condition turned true with the instruction at pc, every condition keeps track of its last value */
+static bool break_after(Debugger_t *dbg, const Chip8_t *system, uint16_t pc) {
+    Debug_Condition *cond;
+    bool hit = false, now;
+    int i;
+
+    for (i = 0; i < dbg->condition_count; i++) {
+        cond = &dbg->conditions[i];
+        now = condition_true(cond, system);
+        if (now && !cond->held) {
+            printf("CONDITION ");
+            print_condition(cond);
+            printf(" AFTER %03" PRIX16 "\n", pc);
+            if (!hit) {
+                dbg->stop = DEBUG_STOP_CONDITION;
+                dbg->stop_addr = (uint16_t)i;
+            }
+            hit = true;
+        }
+        cond->held = now;
+    }
+    return hit;
+}
+
+/*
+The instrumented core, executes up to budget instructions on the interpreter
+    - Breakpoints, invalid opcodes, stack overflows and watchpoints are checked before an instruction and stop without running it
+    - chip8_access() tells what memory the instruction is about to touch, so the handlers are the same ones every other core runs
+    - Conditions are checked after every instruction
+    - Returns 1 once the command line has to take over, the rest of the frame does not run then
+*/
+int debugger_run(Debugger_t *dbg, Chip8_t *system, int budget) {
+    const Chip8_Instr *instr;
+    uint16_t pc;
+    int i;
+
+    for (i = 0; i < budget && dbg->run; i++) {
+        pc = system->pc & (MEMORY_SIZE - 1);
+        instr = &system->decoded[pc];
+        if (!dbg->resume && break_before(dbg, system, pc, instr)) {
+            dbg->run = false;
+            break;
+        }
+        dbg->resume = false;
+
+        chip8_emulatecycle(system);
+        dbg->executed++;
+        if (dbg->condition_count > 0 && break_after(dbg, system, pc)) {
+            dbg->run = false;
+        }
+        if (dbg->run && dbg->exec_max > 0 && dbg->executed >= dbg->exec_max) {
+            dbg->stop = DEBUG_STOP_STEP;
+            dbg->stop_addr = system->pc & (MEMORY_SIZE - 1);
+            dbg->run = false;
+        }
+    }
+    return !dbg->run;
+}
+
+void debugger_cli(Debugger_t *dbg, Chip8_t *system) {
     char line[DEBUGGER_BUF] = {0};
     char arg;
     char *delim;
     uint16_t v1 = 0, v2 = 0;
     if (!dbg->run) {
+        dbg->exec_max = 1;
         for (;;) {
             printf("> ");
-            if (fgets(line, sizeof(line), stdin)) {
+            if (!fgets(line, sizeof(line), stdin)) {
+                /* Nobody is left to type, so the selected core takes over again */
+                arg = 'D';
+                dbg->active = false;
+            }
+            else {
                 arg = line[0];
                 switch (arg) {
                     case 's':
@@ -76,7 +341,7 @@ void debugger_cli(Debugger_t *dbg, Chip8_t *system, Chip8_Graphics *gfx) {
                         delim = strchr(line + 1, ' ');
                         if (delim) {
                             if (str_to_u16_1(delim + 1, &v1) == 0) {
-                                printf("%" PRIX8 "\n", system->memory[v1]);
+                                printf("%" PRIX8 "\n", system->memory[v1 & (MEMORY_SIZE - 1)]);
                             }
                             else {
                                 printf("Failed to parse.\n");
@@ -89,29 +354,71 @@ void debugger_cli(Debugger_t *dbg, Chip8_t *system, Chip8_Graphics *gfx) {
                     case 'e':
                         delim = strchr(line + 1, ' ');
                         if (delim) {
-                            if (str_to_u16_1(delim + 1, &dbg->exec_max) == 0) {
-                                if (dbg->exec_max > 0) {
-                                    dbg->run = true;
-                                }
-                                else {
+                            if (str_to_u64_1(delim + 1, &dbg->exec_max) == 0) {
+                                if (dbg->exec_max == 0) {
                                     printf("Number of instructions to execute is not set.\n");
+                                    dbg->exec_max = 1;
+                                    arg = 0;
                                 }
                             }
                             else {
                                 printf("Failed to parse\n");
+                                arg = 0;
                             }
                         }
                         else {
                             printf("e <0x0>\n");
+                            arg = 0;
                         }
                         break;
+                    case 'x':
+                        dbg->exec_max = 0;
+                        break;
+                    case 'k':
+                    case 'w':
+                    case 'W':
+                        delim = strchr(line + 1, ' ');
+                        if (delim) {
+                            if (str_to_u16_1(delim + 1, &v1) == 0) {
+                                toggle_point(dbg, v1, arg == 'k' ? DEBUG_BREAK : (arg == 'w' ? DEBUG_WATCH_WRITE : DEBUG_WATCH_READ));
+                            }
+                            else {
+                                printf("Failed to parse.\n");
+                            }
+                        }
+                        else {
+                            printf("%c <0x0>\n", arg);
+                        }
+                        break;
+                    case 'i':
+                        switch (debugger_add_condition(dbg, system, line + 1)) {
+                            case 0:
+                                break;
+                            case -1:
+                                printf("Too many conditions.\n");
+                                break;
+                            default:
+                                printf("i <V0x0|I> <==|!=|<|>> <0x0>\n");
+                                break;
+                        }
+                        break;
+                    case 'I':
+                        dbg->condition_count = 0;
+                        break;
+                    case 'l':
+                        list_points(dbg);
+                        break;
+                    case 'D':
+                        dbg->active = false;
+                        printf("Debugger detached.\n");
+                        break;
                     case 'q':
                         system->EMU_flags.exit = 1;
-                        dbg->run = true;
                         break;
                     case 'c':
                         memset(system->gfx, 0, sizeof(system->gfx));
-                        graphics_update(gfx, system);
+                        system->dirty = DISPLAY_ALL_ROWS;
+                        system->EMU_flags.draw_to_screen = 1;
                         break;
                     case 'p':
                         delim = strchr(line + 1, ' ');
@@ -163,6 +470,14 @@ void debugger_cli(Debugger_t *dbg, Chip8_t *system, Chip8_Graphics *gfx) {
                         printf("'g <0x0>'        - Go to location\n");
                         printf("'m <0x0>'        - Print value at memory location\n");
                         printf("'e <0x0>'        - Execute amount of instructions\n");
+                        printf("'x'              - Run until a breakpoint, watchpoint or condition\n");
+                        printf("'k <0x0>'        - Toggle a breakpoint at an address\n");
+                        printf("'w <0x0>'        - Toggle a watchpoint on writes to an address\n");
+                        printf("'W <0x0>'        - Toggle a watchpoint on reads of an address\n");
+                        printf("'i <V0x0|I> <==|!=|<|>> <0x0>' - Break when the register compares true\n");
+                        printf("'I'              - Clear all conditions\n");
+                        printf("'l'              - List breakpoints, watchpoints and conditions\n");
+                        printf("'D'              - Detach, the selected core runs again\n");
                         printf("'q'              - Quit\n");
                         printf("'c'              - Clear the display\n");
                         printf("'p <0x0>'        - Push a value onto the stack\n");
@@ -175,10 +490,13 @@ void debugger_cli(Debugger_t *dbg, Chip8_t *system, Chip8_Graphics *gfx) {
                         break;
                 }
             }
-            if (arg == 's' || arg == 'b' || arg == 'q' || arg == 'g' || arg == 'e') {
+            if (arg == 's' || arg == 'b' || arg == 'q' || arg == 'g' || arg == 'e' || arg == 'x' || arg == 'D') {
                 break;
             }
         }
+        dbg->run = true;
+        dbg->resume = true;
+        dbg->executed = 0;
     }
     return;
 }
\ No newline at end of file
@@ -1,45 +1,130 @@
 #include <SDL2/SDL.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include "graphics.h"
 #include "chip8.h"
 
-SDL_Rect pos = {.h = DISPLAY_HEIGHT, .w = DISPLAY_WIDTH, .x = 0, .y = 0};
-
 void graphics_delay(uint32_t ms) {
     SDL_Delay(ms);
     return;
 }
 
-void graphics_update(Chip8_Graphics *gfx, Chip8_t *system) {
-    int x, y;
+/* Upload the rows first to last - 1 of the pixel buffer */
+static void upload_rows(Chip8_Graphics *gfx, int first, int last) {
+    SDL_Rect rect;
+
+    rect.x = 0;
+    rect.y = first;
+    rect.w = gfx->width;
+    rect.h = last - first;
+    SDL_UpdateTexture(gfx->texture, &rect, gfx->pixels + first * gfx->width, gfx->width * sizeof(uint32_t));
+    gfx->rows_uploaded += last - first;
+    return;
+}
+
+/* Switch to the texture of the resolution, everything is uploaded again afterwards */
+static int set_resolution(Chip8_Graphics *gfx, int width, int height) {
+    int mode = width == DISPLAY_HIRES_WIDTH;
+
+    if (!gfx->textures[mode]) {
+        gfx->textures[mode] = SDL_CreateTexture(gfx->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (!gfx->textures[mode]) {
+            return -1;
+        }
+    }
+    gfx->texture = gfx->textures[mode];
+    gfx->width = width;
+    gfx->height = height;
+    gfx->pos.w = width;
+    gfx->pos.h = height;
+    SDL_RenderSetLogicalSize(gfx->renderer, width, height);
+    gfx->valid = 0;
+    return 0;
+}
+
+/*
+Show a screen given as packed rows
+    - Only the rows marked dirty are compared with the ones on the screen, and only those that differ are expanded and uploaded
+    - Consecutive changed rows go to the texture in one upload
+    - When no row changed, for example a sprite drawn twice at the same place, the frame is not presented at all
+    - A row is width / 64 words, a change of resolution redraws the whole screen
+*/
+void graphics_present(Chip8_Graphics *gfx, const uint64_t *rows, int width, int height, uint64_t dirty) {
+    int x, y, first = -1, changed = 0, words = width / 64;
+    const uint64_t *row;
+    uint32_t *line;
 
     uint32_t pixel_color = (gfx->pixel->red << 24) | (gfx->pixel->green << 16) | (gfx->pixel->blue << 8) | (gfx->pixel->alpha);
     uint32_t background_color = (gfx->background->red << 24) | (gfx->background->green << 16) | (gfx->background->blue << 8) | (gfx->background->alpha);
-    
-    memset(gfx->pixels, 0, sizeof(gfx->pixels));
 
-    for (x = 0; x < DISPLAY_WIDTH; x++) {
-        for (y = 0; y < DISPLAY_HEIGHT; y++) {
-            if (system->gfx[x + (y * DISPLAY_WIDTH)]) {
-                gfx->pixels[x + (y * DISPLAY_WIDTH)] = pixel_color;
-            }
-            else {
-                gfx->pixels[x + (y * DISPLAY_WIDTH)] = background_color;
+    if (width != gfx->width && set_resolution(gfx, width, height) != 0) {
+        return;
+    }
+    if (!gfx->valid) {
+        dirty = DISPLAY_ALL_ROWS;
+    }
+
+    /* Expand the changed packed rows, leftmost pixel first */
+    for (y = 0; y < height; y++) {
+        row = rows + y * words;
+        if (!((dirty >> y) & 1) || (gfx->valid && memcmp(row, gfx->shown + y * words, words * sizeof(*row)) == 0)) {
+            if (first >= 0) {
+                upload_rows(gfx, first, y);
+                first = -1;
             }
+            continue;
+        }
+
+        memcpy(gfx->shown + y * words, row, words * sizeof(*row));
+        line = gfx->pixels + y * width;
+        for (x = 0; x < width; x++) {
+            line[x] = (row[x / 64] >> (63 - x % 64)) & 1 ? pixel_color : background_color;
         }
+        if (first < 0) {
+            first = y;
+        }
+        changed = 1;
+    }
+    if (first >= 0) {
+        upload_rows(gfx, first, height);
     }
 
-    SDL_UpdateTexture(gfx->texture, NULL, gfx->pixels, DISPLAY_WIDTH * sizeof(uint32_t));
+    if (!changed) {
+        gfx->frames_skipped++;
+        return;
+    }
+    gfx->valid = 1;
+    gfx->frames_presented++;
+
     SDL_RenderClear(gfx->renderer);
-    SDL_RenderCopy(gfx->renderer, gfx->texture, NULL, &pos);
+    SDL_RenderCopy(gfx->renderer, gfx->texture, NULL, &gfx->pos);
     SDL_RenderPresent(gfx->renderer);
+    return;
+}
 
+/* Show the screen of the system and hand its dirty rows over to the renderer */
+void graphics_update(Chip8_Graphics *gfx, Chip8_t *system) {
+    graphics_present(gfx, system->gfx, system->width, system->height, system->dirty);
+    system->dirty = 0;
     system->EMU_flags.draw_to_screen = 0;
     return;
 }
 
 int graphics_init(Chip8_Graphics *gfx, int scaling, const char *rom) {
+    gfx->pos.x = 0;
+    gfx->pos.y = 0;
+    gfx->pos.w = DISPLAY_WIDTH;
+    gfx->pos.h = DISPLAY_HEIGHT;
+    gfx->textures[0] = NULL;
+    gfx->textures[1] = NULL;
+    gfx->width = DISPLAY_WIDTH;
+    gfx->height = DISPLAY_HEIGHT;
+    gfx->valid = 0;
+    gfx->frames_presented = 0;
+    gfx->frames_skipped = 0;
+    gfx->rows_uploaded = 0;
+
     if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
         return -1;
     }
@@ -54,7 +139,8 @@ int graphics_init(Chip8_Graphics *gfx, int scaling, const char *rom) {
         return -3;
     };
 
-    gfx->texture = SDL_CreateTexture(gfx->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    gfx->textures[0] = SDL_CreateTexture(gfx->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    gfx->texture = gfx->textures[0];
     if (!gfx->texture) {
         return -4;
     }
@@ -69,10 +155,15 @@ int graphics_init(Chip8_Graphics *gfx, int scaling, const char *rom) {
 void graphics_cleanup(Chip8_Graphics *gfx) {
     if (!gfx) return;
 
-    if (gfx->texture) {
-        SDL_DestroyTexture(gfx->texture);
-        gfx->texture = NULL;
+    if (gfx->textures[0]) {
+        SDL_DestroyTexture(gfx->textures[0]);
+        gfx->textures[0] = NULL;
+    }
+    if (gfx->textures[1]) {
+        SDL_DestroyTexture(gfx->textures[1]);
+        gfx->textures[1] = NULL;
     }
+    gfx->texture = NULL;
     if (gfx->renderer) {
         SDL_DestroyRenderer(gfx->renderer);
         gfx->renderer = NULL;
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <time.h>
+
+#include <config.h>
+
+#include "audio.h"
+#include "chip8.h"
+#include "headless.h"
+#include "input.h"
+#include "jit.h"
+#include "profile.h"
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_interrupt(int sig) {
+    (void)sig;
+    interrupted = 1;
+    return;
+}
+
+double headless_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+Write the framebuffer to a netpbm image
+    - PGM is written as black and white
+    - PPM uses the configured background and pixel colors
+*/
+int headless_dump_frame(Chip8_t *system, const char *path, Dump_Format format, RGBA_t *background, RGBA_t *pixel) {
+    FILE *fp;
+    int x, y;
+    uint8_t rgb[3];
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        return -1;
+    }
+
+    if (format == DUMP_FORMAT_PPM) {
+        fprintf(fp, "P6\n%d %d\n255\n", system->width, system->height);
+        for (y = 0; y < system->height; y++) {
+            for (x = 0; x < system->width; x++) {
+                RGBA_t *color = chip8_pixel(system, x, y) ? pixel : background;
+                rgb[0] = color->red;
+                rgb[1] = color->green;
+                rgb[2] = color->blue;
+                fwrite(rgb, 1, sizeof(rgb), fp);
+            }
+        }
+    }
+    else {
+        fprintf(fp, "P5\n%d %d\n255\n", system->width, system->height);
+        for (y = 0; y < system->height; y++) {
+            for (x = 0; x < system->width; x++) {
+                fputc(chip8_pixel(system, x, y) ? 0xFF : 0x00, fp);
+            }
+        }
+    }
+
+    if (fclose(fp) != 0) {
+        return -2;
+    }
+    return 0;
+}
+
+static int should_dump(const Headless_t *opts, uint64_t frame) {
+    int i;
+    for (i = 0; i < opts->dump_count; i++) {
+        if (opts->dump_frames[i] == frame) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* budget instructions on the selected core without the timer update, the interpreter stops early when the ROM exits */
+int headless_execute(Chip8_t *system, Chip8_Core core, Jit_t *jit, int budget) {
+    int i, executed = 0;
+
+    switch (core) {
+        case CORE_JIT:
+            executed = jit_run(jit, system, budget);
+            break;
+        case CORE_THREADED:
+            executed = chip8_run_threaded(system, budget);
+            break;
+        default:
+            for (i = 0; i < budget; i++) {
+                chip8_emulatecycle(system);
+                executed++;
+                if (system->EMU_flags.exit) {
+                    break;
+                }
+            }
+            break;
+    }
+    return executed;
+}
+
+/*
+Execute one frame
+    - budget instructions on the selected core followed by one timer update
+    - Returns the amount of instructions executed, the interpreter stops early when the ROM exits
+*/
+int headless_frame(Chip8_t *system, Chip8_Core core, Jit_t *jit, int budget) {
+    int executed = headless_execute(system, core, jit, budget);
+
+    chip8_update_timers(system);
+    return executed;
+}
+
+/*
+Run the system as fast as the host allows
+    - A frame is the instructions due at ips followed by one timer update, same as the SDL loop but without the delay
+    - Stops when the ROM exits, a budget runs out or SIGINT is received
+*/
+int headless_run(Chip8_t *system, const Headless_t *opts, Headless_Report *report) {
+    int budget, executed;
+    double start;
+    Ipf_Counter ipf;
+    char path[HEADLESS_PATH_BUF];
+    const char *ext = (opts->dump_format == DUMP_FORMAT_PPM) ? "ppm" : "pgm";
+
+    report->frames = 0;
+    report->instructions = 0;
+    report->sound_frames = 0;
+    report->elided = 0;
+
+    interrupted = 0;
+    signal(SIGINT, on_interrupt);
+
+    ipf_init(&ipf, opts->ips);
+    start = headless_time();
+    while (!interrupted) {
+        budget = ipf_next(&ipf);
+        if (opts->max_instructions && opts->max_instructions - report->instructions < (uint64_t)budget) {
+            budget = opts->max_instructions - report->instructions;
+        }
+
+        if (opts->input) {
+            input_apply(opts->input, system, report->frames);
+        }
+        if (opts->trace) {
+            trace_begin(opts->trace, system, budget);
+        }
+        if (opts->profile) {
+            executed = profile_run(opts->profile, system, budget);
+        }
+        else if (opts->idle_skip) {
+            executed = chip8_run_idle(system, budget, &report->elided);
+        }
+        else if (opts->core == CORE_AOT) {
+            executed = aot_run(opts->aot, system, budget);
+        }
+        else {
+            executed = headless_execute(system, opts->core, opts->jit, budget);
+        }
+        /* Before the timers tick, the trace notes that tick as a change at the start of the next run */
+        if (opts->trace) {
+            trace_end(opts->trace, system, executed);
+        }
+        chip8_update_timers(system);
+        report->instructions += executed;
+        if (opts->audio) {
+            audio_update(opts->audio, system);
+        }
+        report->frames++;
+
+        if (should_dump(opts, report->frames)) {
+            snprintf(path, sizeof(path), "%s_%06" PRIu64 ".%s", opts->dump_prefix, report->frames, ext);
+            if (headless_dump_frame(system, path, opts->dump_format, opts->background, opts->pixel) != 0) {
+                fprintf(stderr, "FAILED TO WRITE %s!\n", path);
+            }
+        }
+
+        if (system->EMU_flags.exit) {
+            break;
+        }
+        if (opts->max_frames && report->frames >= opts->max_frames) {
+            break;
+        }
+        if (opts->max_instructions && report->instructions >= opts->max_instructions) {
+            break;
+        }
+    }
+    report->seconds = headless_time() - start;
+    if (opts->audio) {
+        report->sound_frames = opts->audio->tone_frames;
+    }
+
+    signal(SIGINT, SIG_DFL);
+    return 0;
+}
+
+void headless_print_report(const Headless_Report *report) {
+    double ips = (report->seconds > 0) ? report->instructions / report->seconds : 0;
+
+    printf("FRAMES: %" PRIu64 "\n", report->frames);
+    printf("INSTRUCTIONS: %" PRIu64 "\n", report->instructions);
+    printf("SOUND FRAMES: %" PRIu64 "\n", report->sound_frames);
+    printf("ELIDED: %" PRIu64 " (%.1f%%)\n", report->elided, report->instructions ? report->elided * 100.0 / report->instructions : 0);
+    printf("TIME: %.3f s\n", report->seconds);
+    printf("IPS: %.0f\n", ips);
+    return;
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "chip8.h"
+#include "input.h"
+
+/* Append an event, the array doubles when it is full */
+int input_push(Input_Script *script, uint64_t frame, uint8_t key, uint8_t down) {
+    size_t cap;
+    Input_Event *events;
+
+    if (script->count == script->cap) {
+        cap = script->cap ? script->cap * 2 : 64;
+        events = realloc(script->events, cap * sizeof(Input_Event));
+        if (!events) {
+            return -3;
+        }
+        script->events = events;
+        script->cap = cap;
+    }
+    script->events[script->count].frame = frame;
+    script->events[script->count].key = key;
+    script->events[script->count].down = down;
+    script->count++;
+    return 0;
+}
+
+int input_load(Input_Script *script, const char *path) {
+    FILE *fp;
+    char line[INPUT_LINE_BUF];
+    uint64_t frame;
+    unsigned int key, down;
+
+    script->events = NULL;
+    script->count = 0;
+    script->cap = 0;
+    script->next = 0;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%" SCNu64 " %x %u", &frame, &key, &down) != 3 || key >= NUM_KEYS || down > 1) {
+            fclose(fp);
+            input_free(script);
+            return -2;
+        }
+        if (script->count > 0 && frame < script->events[script->count - 1].frame) {
+            fclose(fp);
+            input_free(script);
+            return -2;
+        }
+
+        if (input_push(script, frame, key, down) != 0) {
+            fclose(fp);
+            input_free(script);
+            return -3;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/* Apply every event up to and including frame that has not been applied yet */
+void input_apply(Input_Script *script, Chip8_t *system, uint64_t frame) {
+    Input_Event *event;
+    while (script->next < script->count && script->events[script->next].frame <= frame) {
+        event = &script->events[script->next];
+        system->key[event->key] = event->down;
+        script->next++;
+    }
+    return;
+}
+
+void input_free(Input_Script *script) {
+    free(script->events);
+    script->events = NULL;
+    script->count = 0;
+    script->cap = 0;
+    script->next = 0;
+    return;
+}
\ No newline at end of file
@@ -0,0 +1,394 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "jit.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+
+#include <sys/mman.h>
+
+#define OFF_V(x)     ((int32_t)(offsetof(Chip8_t, V) + (x)))
+#define OFF_I        ((int32_t)offsetof(Chip8_t, I))
+#define OFF_PC       ((int32_t)offsetof(Chip8_t, pc))
+#define OFF_OPCODE   ((int32_t)offsetof(Chip8_t, opcode))
+#define OFF_DELAY    ((int32_t)offsetof(Chip8_t, delay_timer))
+#define OFF_SOUND    ((int32_t)offsetof(Chip8_t, sound_timer))
+
+/* x86-64 register numbers used in the ModRM reg field */
+#define REG_AL 0
+#define REG_CL 1
+
+enum {
+    EMIT_NONE,
+    EMIT_OK,
+    EMIT_END
+};
+
+static inline void emit8(Jit_t *jit, uint8_t b) {
+    jit->code[jit->used++] = b;
+    return;
+}
+
+static inline void emit16(Jit_t *jit, uint16_t w) {
+    memcpy(jit->code + jit->used, &w, sizeof(w));
+    jit->used += sizeof(w);
+    return;
+}
+
+static inline void emit32(Jit_t *jit, int32_t d) {
+    memcpy(jit->code + jit->used, &d, sizeof(d));
+    jit->used += sizeof(d);
+    return;
+}
+
+/* ModRM for [rdi + disp32], rdi holds the Chip8_t pointer for the whole block */
+static inline void emit_mem(Jit_t *jit, uint8_t reg, int32_t disp) {
+    emit8(jit, 0x80 | (reg << 3) | 0x07);
+    emit32(jit, disp);
+    return;
+}
+
+/* mov r8, byte [rdi + disp] */
+static inline void emit_load8(Jit_t *jit, uint8_t reg, int32_t disp) {
+    emit8(jit, 0x8A);
+    emit_mem(jit, reg, disp);
+    return;
+}
+
+/* mov byte [rdi + disp], r8 */
+static inline void emit_store8(Jit_t *jit, uint8_t reg, int32_t disp) {
+    emit8(jit, 0x88);
+    emit_mem(jit, reg, disp);
+    return;
+}
+
+/* mov word [rdi + disp], imm16 */
+static inline void emit_store16_imm(Jit_t *jit, int32_t disp, uint16_t imm) {
+    emit8(jit, 0x66);
+    emit8(jit, 0xC7);
+    emit_mem(jit, 0, disp);
+    emit16(jit, imm);
+    return;
+}
+
+/* mov byte [rdi + disp], al then mov byte [V + F], cl */
+static inline void emit_store_with_flag(Jit_t *jit, uint8_t x) {
+    emit_store8(jit, REG_AL, OFF_V(x));
+    emit_store8(jit, REG_CL, OFF_V(0xF));
+    return;
+}
+
+/*
+Skip the next instruction depending on the flags of a preceding compare
+    - ax = next, dx = next + 2, the cmov picks the skip target
+*/
+static inline void emit_skip(Jit_t *jit, uint16_t next, uint8_t cmov) {
+    emit8(jit, 0x66); emit8(jit, 0xB8); emit16(jit, next);
+    emit8(jit, 0x66); emit8(jit, 0xBA); emit16(jit, next + sizeof(uint16_t));
+    emit8(jit, 0x66); emit8(jit, 0x0F); emit8(jit, cmov); emit8(jit, 0xC2);
+    emit8(jit, 0x66); emit8(jit, 0x89);
+    emit_mem(jit, REG_AL, OFF_PC);
+    return;
+}
+
+/*
+Translate one instruction
+    - Returns EMIT_NONE for instructions that are left to the interpreter
+    - Returns EMIT_END when the instruction wrote pc itself and the block has to end
+*/
+static int emit_instr(Jit_t *jit, uint16_t opcode, uint16_t pc) {
+    uint8_t nn = opcode & 0x00FF;
+    uint16_t nnn = opcode & 0x0FFF;
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint16_t next = pc + sizeof(uint16_t);
+
+    switch (opcode & 0xF000) {
+        /* 1NNN */
+        case 0x1000:
+            emit_store16_imm(jit, OFF_PC, nnn);
+            return EMIT_END;
+
+        /* 3XNN, 4XNN: cmp byte [Vx], imm8 */
+        case 0x3000:
+        case 0x4000:
+            emit8(jit, 0x80);
+            emit_mem(jit, 7, OFF_V(x));
+            emit8(jit, nn);
+            emit_skip(jit, next, (opcode & 0xF000) == 0x3000 ? 0x44 : 0x45);
+            return EMIT_END;
+
+        /* 6XNN: mov byte [Vx], imm8 */
+        case 0x6000:
+            emit8(jit, 0xC6);
+            emit_mem(jit, 0, OFF_V(x));
+            emit8(jit, nn);
+            return EMIT_OK;
+
+        /* 7XNN: add byte [Vx], imm8 */
+        case 0x7000:
+            emit8(jit, 0x80);
+            emit_mem(jit, 0, OFF_V(x));
+            emit8(jit, nn);
+            return EMIT_OK;
+
+        case 0x8000:
+            switch (opcode & 0x000F) {
+                /* 8XY0 */
+                case 0x0000:
+                    emit_load8(jit, REG_AL, OFF_V(y));
+                    emit_store8(jit, REG_AL, OFF_V(x));
+                    return EMIT_OK;
+
+                /* 8XY1, 8XY2, 8XY3: op byte [Vx], al */
+                case 0x0001:
+                case 0x0002:
+                case 0x0003:
+                    emit_load8(jit, REG_AL, OFF_V(y));
+                    emit8(jit, (opcode & 0x000F) == 0x0001 ? 0x08 : (opcode & 0x000F) == 0x0002 ? 0x20 : 0x30);
+                    emit_mem(jit, REG_AL, OFF_V(x));
+                    return EMIT_OK;
+
+                /* 8XY4: add al, [Vy]; setc cl */
+                case 0x0004:
+                    emit_load8(jit, REG_AL, OFF_V(x));
+                    emit8(jit, 0x02);
+                    emit_mem(jit, REG_AL, OFF_V(y));
+                    emit8(jit, 0x0F); emit8(jit, 0x92); emit8(jit, 0xC1);
+                    emit_store_with_flag(jit, x);
+                    return EMIT_OK;
+
+                /* 8XY5, 8XY7: sub al, [..]; setnc cl */
+                case 0x0005:
+                case 0x0007:
+                    emit_load8(jit, REG_AL, OFF_V((opcode & 0x000F) == 0x0005 ? x : y));
+                    emit8(jit, 0x2A);
+                    emit_mem(jit, REG_AL, OFF_V((opcode & 0x000F) == 0x0005 ? y : x));
+                    emit8(jit, 0x0F); emit8(jit, 0x93); emit8(jit, 0xC1);
+                    emit_store_with_flag(jit, x);
+                    return EMIT_OK;
+
+                /* 8XY6, 8XYE: shr/shl al, 1; setc cl */
+                case 0x0006:
+                case 0x000E:
+                    emit_load8(jit, REG_AL, OFF_V(x));
+                    emit8(jit, 0xD0);
+                    emit8(jit, (opcode & 0x000F) == 0x0006 ? 0xE8 : 0xE0);
+                    emit8(jit, 0x0F); emit8(jit, 0x92); emit8(jit, 0xC1);
+                    emit_store_with_flag(jit, x);
+                    return EMIT_OK;
+            }
+            return EMIT_NONE;
+
+        /* 9XY0: cmp al, [Vy] */
+        case 0x9000:
+            if ((opcode & 0x000F) != 0) {
+                return EMIT_NONE;
+            }
+            emit_load8(jit, REG_AL, OFF_V(x));
+            emit8(jit, 0x3A);
+            emit_mem(jit, REG_AL, OFF_V(y));
+            emit_skip(jit, next, 0x45);
+            return EMIT_END;
+
+        /* ANNN */
+        case 0xA000:
+            emit_store16_imm(jit, OFF_I, nnn);
+            return EMIT_OK;
+
+        /* BNNN: movzx eax, byte [V0]; add ax, nnn; mov [pc], ax */
+        case 0xB000:
+            emit8(jit, 0x0F); emit8(jit, 0xB6);
+            emit_mem(jit, REG_AL, OFF_V(0));
+            emit8(jit, 0x66); emit8(jit, 0x05); emit16(jit, nnn);
+            emit8(jit, 0x66); emit8(jit, 0x89);
+            emit_mem(jit, REG_AL, OFF_PC);
+            return EMIT_END;
+
+        case 0xF000:
+            switch (opcode & 0x00FF) {
+                /* FX07 */
+                case 0x0007:
+                    emit_load8(jit, REG_AL, OFF_DELAY);
+                    emit_store8(jit, REG_AL, OFF_V(x));
+                    return EMIT_OK;
+
+                /* FX15, FX18 */
+                case 0x0015:
+                case 0x0018:
+                    emit_load8(jit, REG_AL, OFF_V(x));
+                    emit_store8(jit, REG_AL, (opcode & 0x00FF) == 0x0015 ? OFF_DELAY : OFF_SOUND);
+                    return EMIT_OK;
+
+                /* FX1E: movzx eax, byte [Vx]; add word [I], ax */
+                case 0x001E:
+                    emit8(jit, 0x0F); emit8(jit, 0xB6);
+                    emit_mem(jit, REG_AL, OFF_V(x));
+                    emit8(jit, 0x66); emit8(jit, 0x01);
+                    emit_mem(jit, REG_AL, OFF_I);
+                    return EMIT_OK;
+
+                /* FX29: movzx eax, byte [Vx]; lea eax, [rax + rax * 4]; mov word [I], ax */
+                case 0x0029:
+                    emit8(jit, 0x0F); emit8(jit, 0xB6);
+                    emit_mem(jit, REG_AL, OFF_V(x));
+                    emit8(jit, 0x8D); emit8(jit, 0x04); emit8(jit, 0x80);
+                    emit8(jit, 0x66); emit8(jit, 0x89);
+                    emit_mem(jit, REG_AL, OFF_I);
+                    return EMIT_OK;
+            }
+            return EMIT_NONE;
+    }
+    return EMIT_NONE;
+}
+
+/*
+Translate the basic block starting at an address
+    - DXYN, FX0A, the stack instructions and everything that writes memory end the block before them
+    - The block leaves pc at the next instruction to execute and updates opcode like the interpreter would
+*/
+static int jit_compile(Jit_t *jit, Chip8_t *system, uint16_t start) {
+    Jit_Block *block = &jit->blocks[start];
+    size_t entry;
+    uint16_t pc = start, opcode = 0, last = 0;
+    int count = 0, res = EMIT_OK;
+
+    if (jit->used + JIT_MAX_BLOCK_CODE > JIT_CODE_SIZE) {
+        jit_reset(jit);
+    }
+    if (mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        block->failed = 1;
+        return -1;
+    }
+    entry = jit->used;
+
+    while (res == EMIT_OK && count < JIT_MAX_BLOCK && pc <= MEMORY_SIZE - sizeof(uint16_t)) {
+        opcode = system->memory[pc] << 8 | system->memory[pc + 1];
+        res = emit_instr(jit, opcode, pc);
+        if (res == EMIT_NONE) {
+            break;
+        }
+        last = opcode;
+        count++;
+        pc += sizeof(uint16_t);
+    }
+
+    if (count == 0) {
+        jit->used = entry;
+        block->failed = 1;
+    }
+    else {
+        if (res != EMIT_END) {
+            emit_store16_imm(jit, OFF_PC, pc);
+        }
+        emit_store16_imm(jit, OFF_OPCODE, last);
+        emit8(jit, 0xC3);
+
+        block->fn = (Jit_Fn)(void *)(jit->code + entry);
+        block->count = count;
+        memset(jit->code_map + start, 1, pc - start);
+    }
+
+    mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+    return count ? 0 : -1;
+}
+
+int jit_init(Jit_t *jit) {
+    void *code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        jit->code = NULL;
+        return -1;
+    }
+    jit->code = code;
+    jit_reset(jit);
+    return 0;
+}
+
+void jit_reset(Jit_t *jit) {
+    jit->used = 0;
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->code_map, 0, sizeof(jit->code_map));
+    return;
+}
+
+/*
+Drop every block if the interpreted instruction wrote over translated code
+    - Only FX33 and FX55 write memory, the blocks themselves never do
+*/
+static inline void jit_check_write(Jit_t *jit, Chip8_t *system) {
+    if (chip8_wrote_over(system, jit->code_map)) {
+        jit_reset(jit);
+    }
+    return;
+}
+
+/*
+Execute up to budget instructions
+    - Translated blocks are only entered when they fit in what is left of the budget, so the amount executed is exact
+    - Everything else, including a pc that ran past the end of memory, goes through chip8_emulatecycle()
+    - Stops after an invalid opcode or 00FD like the interpreter loop, neither is ever part of a block
+*/
+int jit_run(Jit_t *jit, Chip8_t *system, int budget) {
+    int executed = 0;
+    Jit_Block *block;
+
+    while (executed < budget && !system->EMU_flags.exit) {
+        if (system->pc < MEMORY_SIZE) {
+            block = &jit->blocks[system->pc];
+
+            if (!block->fn && !block->failed && ++block->hits >= JIT_HOT_THRESHOLD) {
+                jit_compile(jit, system, system->pc);
+            }
+
+            if (block->fn && block->count <= budget - executed) {
+                block->fn(system);
+                executed += block->count;
+                continue;
+            }
+        }
+
+        chip8_emulatecycle(system);
+        executed++;
+        jit_check_write(jit, system);
+    }
+    return executed;
+}
+
+void jit_cleanup(Jit_t *jit) {
+    if (jit->code) {
+        munmap(jit->code, JIT_CODE_SIZE);
+        jit->code = NULL;
+    }
+    return;
+}
+
+#else
+
+/* No backend for this host, callers fall back to the interpreter. */
+int jit_init(Jit_t *jit) {
+    jit->code = NULL;
+    return -1;
+}
+
+void jit_reset(Jit_t *jit) {
+    (void)jit;
+    return;
+}
+
+int jit_run(Jit_t *jit, Chip8_t *system, int budget) {
+    int i;
+    (void)jit;
+    for (i = 0; i < budget; i++) {
+        chip8_emulatecycle(system);
+    }
+    return budget;
+}
+
+void jit_cleanup(Jit_t *jit) {
+    (void)jit;
+    return;
+}
+
+#endif
\ No newline at end of file
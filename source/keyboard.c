@@ -3,127 +3,109 @@
 #include "chip8.h"
 #include "graphics.h"
 #include "keyboard.h"
+#include "scheduler.h"
+#include "sync.h"
+
+/* Key of the keypad a keyboard key stands for, -1 if none */
+static int keypad_index(SDL_Keycode sym) {
+    switch (sym) {
+        case SDLK_x:
+            return 0x0;
+        case SDLK_1:
+            return 0x1;
+        case SDLK_2:
+            return 0x2;
+        case SDLK_3:
+            return 0x3;
+        case SDLK_q:
+            return 0x4;
+        case SDLK_w:
+            return 0x5;
+        case SDLK_e:
+            return 0x6;
+        case SDLK_a:
+            return 0x7;
+        case SDLK_s:
+            return 0x8;
+        case SDLK_d:
+            return 0x9;
+        case SDLK_z:
+            return 0xA;
+        case SDLK_c:
+            return 0xB;
+        case SDLK_4:
+            return 0xC;
+        case SDLK_r:
+            return 0xD;
+        case SDLK_f:
+            return 0xE;
+        case SDLK_v:
+            return 0xF;
+    }
+    return -1;
+}
+
+static void push_event(Event_Queue *queue, uint8_t type, uint8_t key, uint8_t down) {
+    Host_Event ev = {.time = scheduler_now(), .type = type, .key = key, .down = down};
+
+    if (queue_push(queue, &ev) != 0) {
+        fprintf(stderr, "INPUT QUEUE IS FULL, EVENT DROPPED!\n");
+    }
+    return;
+}
+
+/* Turn the pending SDL events into input events for the emulation thread */
+void await_keypress(SDL_Event *event, Event_Queue *queue) {
+    int key;
 
-void await_keypress(SDL_Event *event, Chip8_t *system) {
     while (SDL_PollEvent(event)) {
         switch (event->type) {
             case SDL_QUIT:
-                system->EMU_flags.exit = 1;
+                push_event(queue, EVENT_EXIT, 0, 1);
                 break;
 
             case SDL_KEYDOWN:
                 switch (event->key.keysym.sym) {
                     case SDLK_SPACE:
-                        system->EMU_flags.pause = 1;
+                        push_event(queue, EVENT_PAUSE, 0, 1);
                         break;
                     case SDLK_BACKSPACE:
-                        system->EMU_flags.restart = 1;
+                        push_event(queue, EVENT_RESTART, 0, 1);
                         break;
                     case SDLK_ESCAPE:
-                        system->EMU_flags.exit = 1;
-                        break;
-                    
-                    case SDLK_x:
-                        system->key[0x0] = 1;
-                        break;
-                    case SDLK_1:
-                        system->key[0x1] = 1;
-                        break;
-                    case SDLK_2:
-                        system->key[0x2] = 1;
-                        break;
-                    case SDLK_3:
-                        system->key[0x3] = 1;
-                        break;
-                    case SDLK_q:
-                        system->key[0x4] = 1;
-                        break;
-                    case SDLK_w:
-                        system->key[0x5] = 1;
-                        break;
-                    case SDLK_e:
-                        system->key[0x6] = 1;
-                        break;
-                    case SDLK_a:
-                        system->key[0x7] = 1;
-                        break;
-                    case SDLK_s:
-                        system->key[0x8] = 1;
+                        push_event(queue, EVENT_EXIT, 0, 1);
                         break;
-                    case SDLK_d:
-                        system->key[0x9] = 1;
+                    case SDLK_LEFT:
+                        push_event(queue, EVENT_REWIND, 0, 1);
                         break;
-                    case SDLK_z:
-                        system->key[0xA] = 1;
+                    case SDLK_F5:
+                        push_event(queue, EVENT_SAVE_STATE, 0, 1);
                         break;
-                    case SDLK_c:
-                        system->key[0xB] = 1;
+                    case SDLK_F9:
+                        push_event(queue, EVENT_LOAD_STATE, 0, 1);
                         break;
-                    case SDLK_4:
-                        system->key[0xC] = 1;
+                    case SDLK_F12:
+                        push_event(queue, EVENT_DEBUG, 0, 1);
                         break;
-                    case SDLK_r:
-                        system->key[0xD] = 1;
+                    default:
+                        key = keypad_index(event->key.keysym.sym);
+                        if (key >= 0) {
+                            push_event(queue, EVENT_KEY, (uint8_t)key, 1);
+                        }
                         break;
-                    case SDLK_f:
-                        system->key[0xE] = 1;
-                        break;
-                    case SDLK_v:
-                        system->key[0xF] = 1;
-                        break;
-                    
                 }
                 break;
 
             case SDL_KEYUP:
                 switch (event->key.keysym.sym) {
-                    case SDLK_x:
-                        system->key[0x0] = 0;
-                        break;
-                    case SDLK_1:
-                        system->key[0x1] = 0;
-                        break;
-                    case SDLK_2:
-                        system->key[0x2] = 0;
-                        break;
-                    case SDLK_3:
-                        system->key[0x3] = 0;
-                        break;
-                    case SDLK_q:
-                        system->key[0x4] = 0;
-                        break;
-                    case SDLK_w:
-                        system->key[0x5] = 0;
-                        break;
-                    case SDLK_e:
-                        system->key[0x6] = 0;
-                        break;
-                    case SDLK_a:
-                        system->key[0x7] = 0;
+                    case SDLK_LEFT:
+                        push_event(queue, EVENT_REWIND, 0, 0);
                         break;
-                    case SDLK_s:
-                        system->key[0x8] = 0;
-                        break;
-                    case SDLK_d:
-                        system->key[0x9] = 0;
-                        break;
-                    case SDLK_z:
-                        system->key[0xA] = 0;
-                        break;
-                    case SDLK_c:
-                        system->key[0xB] = 0;
-                        break;
-                    case SDLK_4:
-                        system->key[0xC] = 0;
-                        break;
-                    case SDLK_r:
-                        system->key[0xD] = 0;
-                        break;
-                    case SDLK_f:
-                        system->key[0xE] = 0;
-                        break;
-                    case SDLK_v:
-                        system->key[0xF] = 0;
+                    default:
+                        key = keypad_index(event->key.keysym.sym);
+                        if (key >= 0) {
+                            push_event(queue, EVENT_KEY, (uint8_t)key, 0);
+                        }
                         break;
                 }
                 break;
@@ -132,23 +114,33 @@ void await_keypress(SDL_Event *event, Chip8_t *system) {
     return;
 }
 
-void await_unpause(SDL_Event *event, Chip8_t *system) {
-    while (system->EMU_flags.pause) {
-        while (SDL_PollEvent(event)) {
-            switch (event->type) {
-                case SDL_QUIT:
-                    system->EMU_flags.exit = 1;
-                    break;
-
-                case SDL_KEYDOWN:
-                    switch (event->key.keysym.sym) {
-                        case SDLK_SPACE:
-                            system->EMU_flags.pause = 0;
-                            break;
-                    }
-                    break;
-            }
-        }
+/* Apply an input event to the system, on the emulation thread. SPACE toggles the pause. */
+void keyboard_apply(Chip8_t *system, const Host_Event *ev) {
+    switch (ev->type) {
+        case EVENT_KEY:
+            system->key[ev->key & 0xF] = ev->down;
+            break;
+        case EVENT_PAUSE:
+            system->EMU_flags.pause = !system->EMU_flags.pause;
+            break;
+        case EVENT_RESTART:
+            system->EMU_flags.restart = 1;
+            break;
+        case EVENT_EXIT:
+            system->EMU_flags.exit = 1;
+            break;
+        case EVENT_REWIND:
+            system->EMU_flags.rewind = ev->down ? 1 : 0;
+            break;
+        case EVENT_SAVE_STATE:
+            system->EMU_flags.save_state = 1;
+            break;
+        case EVENT_LOAD_STATE:
+            system->EMU_flags.load_state = 1;
+            break;
+        case EVENT_DEBUG:
+            system->EMU_flags.debug = 1;
+            break;
     }
     return;
 }
\ No newline at end of file
@@ -0,0 +1,491 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "lockstep.h"
+#include "utils.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define LOCKSTEP_AVX2
+#endif
+
+static inline uint16_t lane_opcode(const Chip8_t *system, uint16_t pc) {
+    return system->memory[pc & (MEMORY_SIZE - 1)] << 8 | system->memory[(pc + 1) & (MEMORY_SIZE - 1)];
+}
+
+/* Opcodes that have a vector version, everything else runs one lane at a time */
+static int vectorizable(uint16_t opcode) {
+    switch (opcode & 0xF000) {
+        case 0x1000:
+        case 0x3000:
+        case 0x4000:
+        case 0x6000:
+        case 0x7000:
+        case 0xA000:
+            return 1;
+        case 0x8000:
+            return (opcode & 0xF) <= 0x7 || (opcode & 0xF) == 0xE;
+        case 0x9000:
+            return (opcode & 0xF) == 0;
+        case 0xF000:
+            switch (opcode & 0xFF) {
+                case 0x07:
+                case 0x15:
+                case 0x18:
+                case 0x1E:
+                    return 1;
+            }
+            return 0;
+    }
+    return 0;
+}
+
+/* Run one instruction of one lane through the scalar core, with the group leader's decoded instruction when there is one */
+static void lane_scalar(Lockstep_t *ls, int lane, const Chip8_Instr *instr) {
+    Chip8_t *system = &ls->systems[lane];
+    uint16_t opcode, start;
+    int i;
+
+    for (i = 0; i < REGISTER_COUNT; i++) {
+        system->V[i] = ls->V[i][lane];
+    }
+    system->I = ls->I[lane];
+    system->pc = ls->pc[lane];
+    system->delay_timer = ls->delay_timer[lane];
+    system->sound_timer = ls->sound_timer[lane];
+
+    if (instr) chip8_execute(system, instr);
+    else chip8_emulatecycle(system);
+
+    /* The same write ranges the JIT watches for */
+    opcode = system->opcode;
+    if ((opcode & 0xF0FF) == 0xF033 || (opcode & 0xF0FF) == 0xF055) {
+        start = system->I;
+        for (i = 0; i < ((opcode & 0xFF) == 0x33 ? 3 : ((opcode >> 8) & 0xF) + 1); i++) {
+            ls->written[(start + i) & (MEMORY_SIZE - 1)] = 1;
+        }
+    }
+
+    for (i = 0; i < REGISTER_COUNT; i++) {
+        ls->V[i][lane] = system->V[i];
+    }
+    ls->I[lane] = system->I;
+    ls->pc[lane] = system->pc;
+    ls->delay_timer[lane] = system->delay_timer;
+    ls->sound_timer[lane] = system->sound_timer;
+    ls->scalar_instructions++;
+    return;
+}
+
+/* Generic versions, used when the CPU has no AVX2 */
+static int build_group_generic(Lockstep_t *ls, uint16_t pc) {
+    int i, count = 0;
+
+    for (i = 0; i < ls->width; i++) {
+        ls->mask16[i] = (ls->pending[i] && ls->pc[i] == pc) ? 0xFFFF : 0;
+        ls->mask8[i] = (uint8_t)ls->mask16[i];
+        ls->pending[i] &= ~ls->mask16[i];
+        count += ls->mask8[i] & 1;
+    }
+    return count;
+}
+
+static void exec_group_generic(Lockstep_t *ls, uint16_t opcode) {
+    int i;
+    uint8_t x = (opcode >> 8) & 0xF, y = (opcode >> 4) & 0xF, nn = opcode & 0xFF;
+    uint16_t nnn = opcode & 0xFFF;
+    uint8_t *vx = ls->V[x], *vy = ls->V[y], *vf = ls->V[0xF];
+    uint8_t a, b, f;
+
+    for (i = 0; i < ls->width; i++) {
+        if (!ls->mask8[i]) continue;
+        ls->pc[i] += 2;
+        a = vx[i];
+        b = vy[i];
+        switch (opcode & 0xF000) {
+            case 0x1000: ls->pc[i] = nnn; break;
+            case 0x3000: if (a == nn) ls->pc[i] += 2; break;
+            case 0x4000: if (a != nn) ls->pc[i] += 2; break;
+            case 0x9000: if (a != b) ls->pc[i] += 2; break;
+            case 0x6000: vx[i] = nn; break;
+            case 0x7000: vx[i] = a + nn; break;
+            case 0xA000: ls->I[i] = nnn; break;
+            case 0x8000:
+                switch (opcode & 0xF) {
+                    case 0x0: vx[i] = b; break;
+                    case 0x1: vx[i] = a | b; break;
+                    case 0x2: vx[i] = a & b; break;
+                    case 0x3: vx[i] = a ^ b; break;
+                    case 0x4: f = (a + b) > 0xFF; vx[i] = a + b; vf[i] = f; break;
+                    case 0x5: f = a >= b; vx[i] = a - b; vf[i] = f; break;
+                    case 0x6: f = a & 1; vx[i] = a >> 1; vf[i] = f; break;
+                    case 0x7: f = b >= a; vx[i] = b - a; vf[i] = f; break;
+                    case 0xE: f = a >> 7; vx[i] = a << 1; vf[i] = f; break;
+                }
+                break;
+            case 0xF000:
+                switch (nn) {
+                    case 0x07: vx[i] = ls->delay_timer[i]; break;
+                    case 0x15: ls->delay_timer[i] = a; break;
+                    case 0x18: ls->sound_timer[i] = a; break;
+                    case 0x1E: ls->I[i] += a; break;
+                }
+                break;
+        }
+    }
+    return;
+}
+
+#if defined(LOCKSTEP_AVX2)
+/*
+Mark the pending lanes at pc as the group and take them out of pending
+    - mask16 is built from 16 bit compares on pc, mask8 packs it down for the byte registers
+    - packs works per 128 bit half, the permute puts the quarters back in lane order
+*/
+__attribute__((target("avx2")))
+static int build_group_avx2(Lockstep_t *ls, uint16_t pc) {
+    int i, count = 0;
+    const __m256i lead = _mm256_set1_epi16((short)pc);
+    __m256i lo, hi, p;
+
+    for (i = 0; i < ls->width; i += 32) {
+        lo = _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_load_si256((__m256i *)&ls->pc[i]), lead), _mm256_load_si256((__m256i *)&ls->pending[i]));
+        hi = _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_load_si256((__m256i *)&ls->pc[i + 16]), lead), _mm256_load_si256((__m256i *)&ls->pending[i + 16]));
+        _mm256_store_si256((__m256i *)&ls->mask16[i], lo);
+        _mm256_store_si256((__m256i *)&ls->mask16[i + 16], hi);
+        _mm256_store_si256((__m256i *)&ls->pending[i], _mm256_andnot_si256(lo, _mm256_load_si256((__m256i *)&ls->pending[i])));
+        _mm256_store_si256((__m256i *)&ls->pending[i + 16], _mm256_andnot_si256(hi, _mm256_load_si256((__m256i *)&ls->pending[i + 16])));
+
+        p = _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8);
+        _mm256_store_si256((__m256i *)&ls->mask8[i], p);
+        count += __builtin_popcount((unsigned)_mm256_movemask_epi8(p));
+    }
+    return count;
+}
+
+/* Add 2 to pc in every lane where the byte condition is set */
+__attribute__((target("avx2")))
+static inline void skip_avx2(uint16_t *pc, __m256i cond) {
+    const __m256i two = _mm256_set1_epi16(2);
+    __m256i lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(cond));
+    __m256i hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(cond, 1));
+
+    _mm256_store_si256((__m256i *)pc, _mm256_add_epi16(_mm256_load_si256((__m256i *)pc), _mm256_and_si256(lo, two)));
+    _mm256_store_si256((__m256i *)(pc + 16), _mm256_add_epi16(_mm256_load_si256((__m256i *)(pc + 16)), _mm256_and_si256(hi, two)));
+    return;
+}
+
+/*
+Run one opcode in every lane of the group, 32 byte registers or 16 addresses per vector
+    - Results are blended in under mask8/mask16 so lanes outside the group keep their state
+    - VF is written after VX, so a flag result still wins when X is F
+*/
+__attribute__((target("avx2")))
+static void exec_group_avx2(Lockstep_t *ls, uint16_t opcode) {
+    int i;
+    uint8_t x = (opcode >> 8) & 0xF, y = (opcode >> 4) & 0xF, nn = opcode & 0xFF;
+    uint16_t nnn = opcode & 0xFFF;
+    uint8_t *vx = ls->V[x], *vy = ls->V[y], *vf = ls->V[0xF];
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i imm8 = _mm256_set1_epi8((char)nn);
+    const __m256i imm16 = _mm256_set1_epi16((short)nnn);
+    __m256i m, a, b, r, f;
+
+    for (i = 0; i < ls->width; i += 16) {
+        m = _mm256_load_si256((__m256i *)&ls->mask16[i]);
+        r = _mm256_add_epi16(_mm256_load_si256((__m256i *)&ls->pc[i]), _mm256_and_si256(m, _mm256_set1_epi16(2)));
+        if ((opcode & 0xF000) == 0x1000) {
+            r = _mm256_blendv_epi8(r, imm16, m);
+        }
+        _mm256_store_si256((__m256i *)&ls->pc[i], r);
+        if ((opcode & 0xF000) == 0xA000) {
+            _mm256_store_si256((__m256i *)&ls->I[i], _mm256_blendv_epi8(_mm256_load_si256((__m256i *)&ls->I[i]), imm16, m));
+        }
+    }
+    if ((opcode & 0xF000) == 0x1000 || (opcode & 0xF000) == 0xA000) {
+        return;
+    }
+
+    for (i = 0; i < ls->width; i += 32) {
+        m = _mm256_load_si256((__m256i *)&ls->mask8[i]);
+        a = _mm256_load_si256((__m256i *)&vx[i]);
+        b = _mm256_load_si256((__m256i *)&vy[i]);
+        f = _mm256_setzero_si256();
+
+        switch (opcode & 0xF000) {
+            case 0x3000:
+                skip_avx2(&ls->pc[i], _mm256_and_si256(_mm256_cmpeq_epi8(a, imm8), m));
+                continue;
+            case 0x4000:
+                skip_avx2(&ls->pc[i], _mm256_andnot_si256(_mm256_cmpeq_epi8(a, imm8), m));
+                continue;
+            case 0x9000:
+                skip_avx2(&ls->pc[i], _mm256_andnot_si256(_mm256_cmpeq_epi8(a, b), m));
+                continue;
+            case 0x6000:
+                _mm256_store_si256((__m256i *)&vx[i], _mm256_blendv_epi8(a, imm8, m));
+                continue;
+            case 0x7000:
+                _mm256_store_si256((__m256i *)&vx[i], _mm256_blendv_epi8(a, _mm256_add_epi8(a, imm8), m));
+                continue;
+            case 0xF000:
+                switch (nn) {
+                    case 0x07:
+                        _mm256_store_si256((__m256i *)&vx[i], _mm256_blendv_epi8(a, _mm256_load_si256((__m256i *)&ls->delay_timer[i]), m));
+                        break;
+                    case 0x15:
+                        _mm256_store_si256((__m256i *)&ls->delay_timer[i], _mm256_blendv_epi8(_mm256_load_si256((__m256i *)&ls->delay_timer[i]), a, m));
+                        break;
+                    case 0x18:
+                        _mm256_store_si256((__m256i *)&ls->sound_timer[i], _mm256_blendv_epi8(_mm256_load_si256((__m256i *)&ls->sound_timer[i]), a, m));
+                        break;
+                    case 0x1E:
+                        r = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(_mm256_and_si256(a, m)));
+                        _mm256_store_si256((__m256i *)&ls->I[i], _mm256_add_epi16(_mm256_load_si256((__m256i *)&ls->I[i]), r));
+                        r = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(_mm256_and_si256(a, m), 1));
+                        _mm256_store_si256((__m256i *)&ls->I[i + 16], _mm256_add_epi16(_mm256_load_si256((__m256i *)&ls->I[i + 16]), r));
+                        break;
+                }
+                continue;
+        }
+
+        /* 8XY_, the only family left */
+        switch (opcode & 0xF) {
+            case 0x0: r = b; break;
+            case 0x1: r = _mm256_or_si256(a, b); break;
+            case 0x2: r = _mm256_and_si256(a, b); break;
+            case 0x3: r = _mm256_xor_si256(a, b); break;
+            case 0x4:
+                r = _mm256_add_epi8(a, b);
+                f = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_adds_epu8(a, b), r), one);
+                break;
+            case 0x5:
+                r = _mm256_sub_epi8(a, b);
+                f = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a), one);
+                break;
+            case 0x6:
+                r = _mm256_and_si256(_mm256_srli_epi16(a, 1), _mm256_set1_epi8(0x7F));
+                f = _mm256_and_si256(a, one);
+                break;
+            case 0x7:
+                r = _mm256_sub_epi8(b, a);
+                f = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), b), one);
+                break;
+            default:
+                r = _mm256_add_epi8(a, a);
+                f = _mm256_and_si256(_mm256_srli_epi16(a, 7), one);
+                break;
+        }
+        _mm256_store_si256((__m256i *)&vx[i], _mm256_blendv_epi8(a, r, m));
+        if ((opcode & 0xF) >= 0x4) {
+            _mm256_store_si256((__m256i *)&vf[i], _mm256_blendv_epi8(_mm256_load_si256((__m256i *)&vf[i]), f, m));
+        }
+    }
+    return;
+}
+#endif
+
+int lockstep_init(Lockstep_t *ls, int lanes) {
+    int i;
+    size_t width;
+
+    memset(ls, 0, sizeof(*ls));
+    if (lanes < 1) {
+        return -1;
+    }
+    width = (lanes + LOCKSTEP_WIDTH - 1) / LOCKSTEP_WIDTH * LOCKSTEP_WIDTH;
+    ls->lanes = lanes;
+    ls->width = (int)width;
+
+    for (i = 0; i < REGISTER_COUNT; i++) {
+        ls->V[i] = aligned_alloc(32, width);
+    }
+    ls->I = aligned_alloc(32, width * sizeof(uint16_t));
+    ls->pc = aligned_alloc(32, width * sizeof(uint16_t));
+    ls->delay_timer = aligned_alloc(32, width);
+    ls->sound_timer = aligned_alloc(32, width);
+    ls->pending = aligned_alloc(32, width * sizeof(uint16_t));
+    ls->mask16 = aligned_alloc(32, width * sizeof(uint16_t));
+    ls->mask8 = aligned_alloc(32, width);
+    ls->systems = calloc(lanes, sizeof(Chip8_t));
+
+    for (i = 0; i < REGISTER_COUNT; i++) {
+        if (!ls->V[i]) {
+            lockstep_cleanup(ls);
+            return -3;
+        }
+        memset(ls->V[i], 0, width);
+    }
+    if (!ls->I || !ls->pc || !ls->delay_timer || !ls->sound_timer || !ls->pending || !ls->mask16 || !ls->mask8 || !ls->systems) {
+        lockstep_cleanup(ls);
+        return -3;
+    }
+    memset(ls->I, 0, width * sizeof(uint16_t));
+    memset(ls->pc, 0, width * sizeof(uint16_t));
+    memset(ls->delay_timer, 0, width);
+    memset(ls->sound_timer, 0, width);
+
+#if defined(LOCKSTEP_AVX2)
+    __builtin_cpu_init();
+    ls->avx2 = __builtin_cpu_supports("avx2");
+#endif
+    for (i = 0; i < lanes; i++) {
+        chip8_initialize(&ls->systems[i]);
+    }
+    lockstep_pack(ls);
+    return 0;
+}
+
+/* Load the same ROM into every lane, the return values are the ones of load_rom() */
+int lockstep_load(Lockstep_t *ls, const char *rom) {
+    int i, ret;
+
+    for (i = 0; i < ls->lanes; i++) {
+        ret = load_rom(&ls->systems[i], rom);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    memset(ls->written, 0, sizeof(ls->written));
+    lockstep_pack(ls);
+    return 0;
+}
+
+/* Copy the registers of every system into the lanes, after changing ls->systems directly */
+void lockstep_pack(Lockstep_t *ls) {
+    int i, r;
+
+    for (i = 0; i < ls->lanes; i++) {
+        for (r = 0; r < REGISTER_COUNT; r++) {
+            ls->V[r][i] = ls->systems[i].V[r];
+        }
+        ls->I[i] = ls->systems[i].I;
+        ls->pc[i] = ls->systems[i].pc;
+        ls->delay_timer[i] = ls->systems[i].delay_timer;
+        ls->sound_timer[i] = ls->systems[i].sound_timer;
+    }
+    return;
+}
+
+/* Copy the lanes back into the systems, before reading them (e.g. chip8_hash()) */
+void lockstep_sync(Lockstep_t *ls) {
+    int i, r;
+
+    for (i = 0; i < ls->lanes; i++) {
+        for (r = 0; r < REGISTER_COUNT; r++) {
+            ls->systems[i].V[r] = ls->V[r][i];
+        }
+        ls->systems[i].I = ls->I[i];
+        ls->systems[i].pc = ls->pc[i];
+        ls->systems[i].delay_timer = ls->delay_timer[i];
+        ls->systems[i].sound_timer = ls->sound_timer[i];
+    }
+    return;
+}
+
+/*
+One instruction in every lane
+    - The first pending lane leads a group of all pending lanes at the same pc
+    - A vector opcode runs for the whole group at once, anything else runs lane by lane on the leader's decoded instruction
+    - Where some lane wrote to memory, lanes whose opcode differs from the leader's are put back
+    - After LOCKSTEP_MAX_GROUPS groups, the lanes that are left all step on their own
+*/
+static void lockstep_step(Lockstep_t *ls) {
+    int i, lane = 0, groups = 0, count;
+    uint16_t pc, opcode;
+    const Chip8_Instr *instr;
+
+    for (i = 0; i < ls->width; i++) {
+        ls->pending[i] = i < ls->lanes ? 0xFFFF : 0;
+    }
+
+    while (1) {
+        while (lane < ls->lanes && !ls->pending[lane]) lane++;
+        if (lane >= ls->lanes) break;
+
+        if (groups >= LOCKSTEP_MAX_GROUPS) {
+            ls->pending[lane] = 0;
+            lane_scalar(ls, lane, NULL);
+            continue;
+        }
+
+        pc = ls->pc[lane];
+        opcode = lane_opcode(&ls->systems[lane], pc);
+#if defined(LOCKSTEP_AVX2)
+        count = ls->avx2 ? build_group_avx2(ls, pc) : build_group_generic(ls, pc);
+#else
+        count = build_group_generic(ls, pc);
+#endif
+        if (ls->written[pc & (MEMORY_SIZE - 1)] || ls->written[(pc + 1) & (MEMORY_SIZE - 1)]) {
+            for (i = lane + 1; i < ls->lanes; i++) {
+                if (ls->mask8[i] && lane_opcode(&ls->systems[i], pc) != opcode) {
+                    ls->mask8[i] = 0;
+                    ls->mask16[i] = 0;
+                    ls->pending[i] = 0xFFFF;
+                    count--;
+                }
+            }
+        }
+        groups++;
+
+        if (!vectorizable(opcode)) {
+            instr = &ls->systems[lane].decoded[pc & (MEMORY_SIZE - 1)];
+            for (i = lane; i < ls->lanes; i++) {
+                if (ls->mask8[i]) lane_scalar(ls, i, instr);
+            }
+            continue;
+        }
+
+#if defined(LOCKSTEP_AVX2)
+        if (ls->avx2) exec_group_avx2(ls, opcode);
+        else exec_group_generic(ls, opcode);
+#else
+        exec_group_generic(ls, opcode);
+#endif
+        ls->vector_instructions += count;
+    }
+    return;
+}
+
+/* Run budget instructions in every lane */
+void lockstep_run(Lockstep_t *ls, int budget) {
+    int i;
+
+    for (i = 0; i < budget; i++) {
+        lockstep_step(ls);
+    }
+    return;
+}
+
+/* Same as chip8_update_timers() for every lane */
+void lockstep_update_timers(Lockstep_t *ls) {
+    int i;
+
+    for (i = 0; i < ls->width; i++) {
+        if (ls->delay_timer[i] > 0) ls->delay_timer[i]--;
+        if (ls->sound_timer[i] > 0) ls->sound_timer[i]--;
+    }
+    return;
+}
+
+void lockstep_cleanup(Lockstep_t *ls) {
+    int i;
+
+    for (i = 0; i < REGISTER_COUNT; i++) {
+        free(ls->V[i]);
+        ls->V[i] = NULL;
+    }
+    free(ls->I);
+    free(ls->pc);
+    free(ls->delay_timer);
+    free(ls->sound_timer);
+    free(ls->pending);
+    free(ls->mask16);
+    free(ls->mask8);
+    free(ls->systems);
+    ls->I = ls->pc = ls->pending = ls->mask16 = NULL;
+    ls->delay_timer = ls->sound_timer = ls->mask8 = NULL;
+    ls->systems = NULL;
+    return;
+}
\ No newline at end of file
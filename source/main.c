@@ -1,33 +1,752 @@
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+#if !defined(NO_SDL)
 #include <SDL2/SDL.h>
+#endif
 
 #include <config.h>
 #include <log.h>
 
+#include "aot.h"
+#include "audio.h"
+#include "catalog.h"
 #include "chip8.h"
-#include "graphics.h"
-#include "keyboard.h"
+#include "headless.h"
+#include "jit.h"
+#include "movie.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "state.h"
+#include "trace.h"
 #include "utils.h"
 
-#if defined(DEBUG)
+#if !defined(NO_SDL)
+#include "graphics.h"
+#include "keyboard.h"
+#include "rewind.h"
+#include "sync.h"
 #include "debugger.h"
+#include "remote.h"
 #endif
 
 #define CONFIG_FILE_PATH "chip8-emu.conf"
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "%s <path to ROM>\n", argv[0]);
+static void usage(const char *prog) {
+    fprintf(stderr, "%s [options] <path to ROM>\n", prog);
+    fprintf(stderr, "  --core <name>           Execution core: interpreter, threaded or jit\n");
+    fprintf(stderr, "  --aot <library>         Run the ROM translated by chip8-aot and compiled into the library\n");
+    fprintf(stderr, "  --idle-skip             Skip the rest of a frame spent in a busy wait, runs on the interpreter\n");
+    fprintf(stderr, "  --ips <n|unlimited>     Instructions per second, unlimited runs as many as fit in every frame (window)\n");
+    fprintf(stderr, "  --headless              Run without a window and without pacing\n");
+    fprintf(stderr, "  --mute                  Do not open the audio device\n");
+    fprintf(stderr, "  --debug                 Start in the debugger, F12 attaches it while running (window)\n");
+    fprintf(stderr, "  --debug-socket <path>   Serve debug clients on a Unix domain socket (window)\n");
+    fprintf(stderr, "  --input <frame|timed>   Apply key events at the start of a frame or at the instruction matching their time (default frame)\n");
+    fprintf(stderr, "  --input-poll <n>        Spread every frame over its period and take key events every n instructions\n");
+    fprintf(stderr, "  --frames <n>            Stop after n frames (headless)\n");
+    fprintf(stderr, "  --instructions <n>      Stop after n instructions (headless)\n");
+    fprintf(stderr, "  --dump <n,n,...>        Dump the framebuffer at the given frames (headless)\n");
+    fprintf(stderr, "  --dump-format <pgm|ppm> Image format of the dumps (default pgm)\n");
+    fprintf(stderr, "  --dump-prefix <path>    Path prefix of the dumps (default frame)\n");
+    fprintf(stderr, "  --load-state <path>     Start from a saved state\n");
+    fprintf(stderr, "  --save-state <path>     Save the state when the emulator exits\n");
+    fprintf(stderr, "  --seed <n>              Seed of the random number generator (default the time)\n");
+    fprintf(stderr, "  --record <path>         Record the keypad to a movie\n");
+    fprintf(stderr, "  --play <path>           Play back a movie\n");
+    fprintf(stderr, "  --profile <prefix>      Profile the ROM on the interpreter, writes <prefix>.folded and <prefix>.txt\n");
+    fprintf(stderr, "  --profile-top <n>       Entries in every list of the profile report (default %d)\n", PROFILE_DEFAULT_TOP);
+    fprintf(stderr, "  --trace <path>          Where the last %d or more instructions are written when the ROM faults or the emulator crashes (default <ROM>.trace)\n", TRACE_SIZE);
+    fprintf(stderr, "  --no-trace              Do not keep the trace\n");
+    fprintf(stderr, "%s --scan <directory>\n", prog);
+    fprintf(stderr, "  Add the ROMs below the directory to %s, only files that changed are read again\n", CATALOG_INDEX_PATH);
+    return;
+}
+
+/* Write the folded stacks and the report next to each other */
+static void write_profile(Profile_t *prof, const char *prefix, int top) {
+    char path[PROFILE_PATH_BUF];
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s.folded", prefix);
+    if (profile_write_folded(prof, path) != 0) {
+        fprintf(stderr, "FAILED TO WRITE %s!\n", path);
+    }
+
+    snprintf(path, sizeof(path), "%s.txt", prefix);
+    fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "FAILED TO WRITE %s!\n", path);
+        return;
+    }
+    profile_write_report(prof, fp, top);
+    fclose(fp);
+    printf("Profile written to %s.folded and %s.txt\n", prefix, prefix);
+    return;
+}
+
+static int parse_dump_frames(char *s, Headless_t *opts) {
+    char *tok;
+    for (tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+        if (opts->dump_count >= HEADLESS_MAX_DUMPS) {
+            return -1;
+        }
+        if (str_to_u64(tok, &opts->dump_frames[opts->dump_count]) != 0) {
+            return -2;
+        }
+        opts->dump_count++;
+    }
+    return 0;
+}
+
+/* Bring the catalog up to date with the ROMs below dir */
+static int scan_roms(const char *dir) {
+    Catalog_t cat;
+    Catalog_Scan report;
+
+    switch (catalog_load(&cat, CATALOG_INDEX_PATH)) {
+        case 0:
+        case -1:
+            break;
+        case -3:
+            fprintf(stderr, "OUT OF MEMORY!\n");
+            return 1;
+        case -4:
+            fprintf(stderr, "UNSUPPORTED CATALOG VERSION!\n");
+            return 1;
+        default:
+            fprintf(stderr, "INVALID CATALOG!\n");
+            return 1;
+    }
+
+    switch (catalog_scan(&cat, dir, &report)) {
+        case 0:
+            break;
+        case -1:
+            fprintf(stderr, "INVALID ROM DIRECTORY!\n");
+            catalog_free(&cat);
+            return 1;
+        default:
+            fprintf(stderr, "OUT OF MEMORY!\n");
+            catalog_free(&cat);
+            return 1;
+    }
+
+    if (catalog_save(&cat, CATALOG_INDEX_PATH) != 0) {
+        fprintf(stderr, "FAILED TO WRITE THE CATALOG!\n");
+        catalog_free(&cat);
         return 1;
     }
+    catalog_print_scan(&report, stdout);
+    catalog_free(&cat);
+    return 0;
+}
+
+#if !defined(NO_SDL)
+/*
+Everything the emulation thread works with, it owns the system until done is set
+    - The SDL thread sends the keypad and the hotkeys through events and takes finished screens from frames
+    - Neither side waits for the other, so a slow present does not steal time from the emulation
+*/
+/* When the keypad is applied to the system */
+typedef enum {
+    INPUT_FRAME,
+    INPUT_TIMED,
+    INPUT_POLL
+} Input_Sampling;
+
+typedef struct {
+    Chip8_t *sys;
+    const char *rom;
+    int clip;
+    uint32_t seed;
+    int core;
+    int idle_skip;
+    uint64_t ips;
+    Jit_t *jit;
+    Aot_t *aot;
+    Profile_t *prof;
+    Trace_t *trace;
+    Audio_t *audio;
+    Debugger_t dbg;
+    Remote_t *remote;
+
+    Rewind_t *rw;
+    int rewind_enabled;
+    const char *state_path;
+
+    Movie_Recorder *recorder;
+    const char *record;
+    int recording;
+    Movie_t *movie;
+    const char *play;
+    int playing;
+    uint8_t movie_keys[NUM_KEYS];
+    uint64_t frame;
+    uint64_t instructions;
+    uint64_t elided;
+
+    int sampling;
+    int poll;
+    uint64_t presses;
+    _Atomic uint64_t press_times[EVENT_QUEUE_SIZE];
+
+    Event_Queue events;
+    Triple_Buffer frames;
+    atomic_int done;
+} Session_t;
+
+/* Key presses are numbered, so the SDL thread can tell how long each one took to reach the screen */
+static void apply_event(Session_t *s, const Host_Event *ev) {
+    keyboard_apply(s->sys, ev);
+    if (ev->type == EVENT_KEY && ev->down) {
+        atomic_store_explicit(&s->press_times[s->presses % EVENT_QUEUE_SIZE], ev->time, memory_order_relaxed);
+        s->presses++;
+    }
+    return;
+}
+
+static void drain_events(Session_t *s) {
+    Host_Event ev;
+
+    while (queue_pop(&s->events, &ev) == 0) {
+        apply_event(s, &ev);
+    }
+    return;
+}
+
+/* Hand the screen and the rows drawn since the last frame over to the SDL thread */
+static void publish_frame(Session_t *s) {
+    Frame_t *out = triple_back(&s->frames);
+
+    memcpy(out->gfx, s->sys->gfx, sizeof(out->gfx));
+    out->width = s->sys->width;
+    out->height = s->sys->height;
+    out->dirty = s->sys->dirty;
+    out->inputs = s->presses;
+    triple_publish(&s->frames);
+
+    s->sys->dirty = 0;
+    s->sys->EMU_flags.draw_to_screen = 0;
+    return;
+}
+
+/* Run budget instructions on the selected core, 1 when the rest of the frame should not run */
+static int run_instructions(Session_t *s, int budget) {
+    Chip8_t *sys = s->sys;
+    uint64_t elided, before;
+    int i, executed = budget, stop = 0;
+
+    s->instructions += budget;
+    if (s->trace) {
+        trace_begin(s->trace, sys, budget);
+    }
+    if (s->dbg.active) {
+        before = s->dbg.executed;
+        stop = debugger_run(&s->dbg, sys, budget);
+        executed = (int)(s->dbg.executed - before);
+    }
+    else if (s->prof) {
+        executed = profile_run(s->prof, sys, budget);
+    }
+    else if (s->idle_skip) {
+        elided = s->elided;
+        executed = chip8_run_idle(sys, budget, &s->elided);
+        /* The rest of the frame would only be the same busy wait */
+        stop = s->ips == IPS_UNLIMITED && s->elided != elided;
+    }
+    else if (s->core == CORE_JIT) {
+        executed = jit_run(s->jit, sys, budget);
+    }
+    else if (s->core == CORE_AOT) {
+        executed = aot_run(s->aot, sys, budget);
+    }
+    else if (s->core == CORE_THREADED) {
+        executed = chip8_run_threaded(sys, budget);
+    }
+    else {
+        for (i = 0; i < budget; i++) {
+            chip8_emulatecycle(sys);
+        }
+    }
+    if (s->trace) {
+        trace_end(s->trace, sys, executed);
+    }
+    return stop;
+}
+
+/* The state was replaced from outside the ROM, cores that cache code start over and the trace takes a checkpoint */
+static void state_replaced(Session_t *s) {
+    if (s->jit) {
+        jit_reset(s->jit);
+    }
+    if (s->aot) {
+        aot_reset(s->aot, s->sys);
+    }
+    if (s->trace) {
+        trace_checkpoint(s->trace, s->sys);
+    }
+    return;
+}
+
+/* Movies store the keypad once a frame and the instructions run at unlimited IPS have no time of their own */
+static int frame_sampled(const Session_t *s) {
+    return s->sampling == INPUT_FRAME || s->ips == IPS_UNLIMITED || s->recording || s->playing;
+}
+
+/*
+Run the instructions of one frame
+    - Sampling once a frame applies every event at the start, with unlimited IPS the frame runs in chunks until it is over
+    - Timed sampling applies every event at the instruction that stands for the time it arrived, a key held for a part of a frame is seen for that part
+    - Polling spreads the frame over its period, takes the events every poll instructions and publishes what was drawn right away
+*/
+static void run_frame(Session_t *s, Scheduler_t *sched) {
+    int budget, done, at, n;
+    Host_Event ev;
+
+    if (frame_sampled(s)) {
+        do {
+            if (run_instructions(s, scheduler_budget(sched))) {
+                break;
+            }
+        } while (s->ips == IPS_UNLIMITED && !s->sys->EMU_flags.exit && !scheduler_due(sched));
+        return;
+    }
+
+    budget = scheduler_budget(sched);
+    if (s->sampling == INPUT_TIMED) {
+        for (done = 0; done < budget; done = at) {
+            at = budget;
+            if (queue_peek(&s->events, &ev) == 0) {
+                at = scheduler_index(sched, ev.time, budget);
+                if (at <= done) {
+                    queue_pop(&s->events, &ev);
+                    apply_event(s, &ev);
+                    continue;
+                }
+            }
+            if (run_instructions(s, at - done)) {
+                break;
+            }
+        }
+    }
+    else {
+        for (done = 0; done < budget; done += n) {
+            scheduler_sleep_until(scheduler_slot(sched, done, budget));
+            drain_events(s);
+            n = budget - done < s->poll ? budget - done : s->poll;
+            if (run_instructions(s, n)) {
+                break;
+            }
+            if (s->sys->EMU_flags.draw_to_screen) {
+                publish_frame(s);
+            }
+        }
+    }
+    return;
+}
+
+/* Time from a key press arriving to the present of the first frame published after it was applied */
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} Latency_t;
+
+/* Count the presses up to inputs against the present that just finished, presses the ring no longer holds are dropped */
+static uint64_t count_latency(Latency_t *l, Session_t *s, uint64_t counted, uint64_t inputs) {
+    uint64_t now = scheduler_now(), t;
+
+    if (inputs - counted > EVENT_QUEUE_SIZE) {
+        counted = inputs - EVENT_QUEUE_SIZE;
+    }
+    for (; counted < inputs; counted++) {
+        t = atomic_load_explicit(&s->press_times[counted % EVENT_QUEUE_SIZE], memory_order_relaxed);
+        if (t > now) {
+            continue;
+        }
+        l->count++;
+        l->sum += now - t;
+        if (now - t < l->min) l->min = now - t;
+        if (now - t > l->max) l->max = now - t;
+    }
+    return counted;
+}
+
+static const char *sampling_name(const Session_t *s) {
+    if (frame_sampled(s)) {
+        return "once a frame";
+    }
+    return s->sampling == INPUT_POLL ? "polled" : "timed";
+}
+
+/* EMU LOOP, paced to the clock on its own thread */
+static int emulation_main(void *arg) {
+    Session_t *s = arg;
+    Chip8_t *sys = s->sys;
+    uint64_t hash;
+
+    /* We need to control execution by time */
+    Scheduler_t sched;
+    scheduler_init(&sched, s->ips);
+
+    for (;;) {
+        if (frame_sampled(s)) {
+            drain_events(s);
+        }
+
+        if (s->recording || s->playing) {
+            sys->EMU_flags.rewind = 0;
+            sys->EMU_flags.restart = 0;
+            sys->EMU_flags.load_state = 0;
+        }
+        if (s->playing) {
+            memcpy(sys->key, s->movie_keys, NUM_KEYS);
+            input_apply(&s->movie->script, sys, s->frame);
+            memcpy(s->movie_keys, sys->key, NUM_KEYS);
+        }
+        else if (s->recording && movie_record_frame(s->recorder, sys, s->frame) != 0) {
+            LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "FAILED TO WRITE TO %s, RECORDING STOPPED", s->record);
+            movie_record_finish(s->recorder, sys, s->frame);
+            s->recording = 0;
+        }
+
+        /* F12 attaches the debugger, or breaks into it when it is attached already */
+        if (sys->EMU_flags.debug) {
+            sys->EMU_flags.debug = 0;
+            if (s->dbg.active) {
+                debugger_halt(&s->dbg);
+            }
+            else {
+                debugger_attach(&s->dbg);
+            }
+        }
+        /* A remote client gets the debugger instead of the command line, and never holds up the frame */
+        if (s->remote) {
+            hash = s->trace ? chip8_hash(sys) : 0;
+            /* Registers the client set leave cached code alone, only the trace has to know */
+            if (remote_poll(s->remote, &s->dbg, sys) || (s->trace && chip8_hash(sys) != hash)) {
+                state_replaced(s);
+            }
+        }
+        if (s->dbg.active && !s->dbg.run && !(s->remote && remote_connected(s->remote))) {
+            audio_gate(s->audio, 0);
+            hash = chip8_hash(sys);
+            debugger_cli(&s->dbg, sys);
+            /* The command line may have moved pc, a core that caches code starts over, and stepping alone leaves the trace alone */
+            if (!s->dbg.active || chip8_hash(sys) != hash) {
+                state_replaced(s);
+            }
+            scheduler_resync(&sched);
+        }
+
+        /* Step back through the history while rewind is held, instead of executing */
+        if (sys->EMU_flags.rewind && s->rewind_enabled) {
+            if (rewind_step(s->rw, sys) == 0) {
+                state_replaced(s);
+            }
+            audio_gate(s->audio, 0);
+            /* No instruction runs to apply the release of the rewind key at */
+            drain_events(s);
+        }
+        else if (s->dbg.active && !s->dbg.run) {
+            /* Halted by the remote client, frames are still shown and polled */
+            audio_gate(s->audio, 0);
+            drain_events(s);
+        }
+        else {
+            run_frame(s, &sched);
+            chip8_update_timers(sys);
+            audio_update(s->audio, sys);
+
+            if (s->rewind_enabled) {
+                rewind_push(s->rw, sys);
+            }
+            s->frame++;
+        }
+
+        /* The keypad is handed back once the movie is over */
+        if (s->playing && s->frame == s->movie->frames) {
+            if (chip8_hash(sys) == s->movie->end_hash) {
+                printf("Playback matched\n");
+            }
+            else {
+                LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "PLAYBACK DIVERGED FROM %s", s->play);
+            }
+            memset(sys->key, 0, NUM_KEYS);
+            movie_free(s->movie);
+            s->playing = 0;
+        }
+
+        if (sys->EMU_flags.draw_to_screen) {
+            publish_frame(s);
+        }
+
+        if (sys->EMU_flags.exit) {
+            printf("Exiting...\n");
+            break;
+        }
+        else if (sys->EMU_flags.pause) {
+            printf("Paused\n");
+            audio_gate(s->audio, 0);
+            while (sys->EMU_flags.pause && !sys->EMU_flags.exit) {
+                SDL_Delay(1);
+                drain_events(s);
+            }
+            scheduler_resync(&sched);
+            printf("Unpaused\n");
+        }
+        else if (sys->EMU_flags.restart) {
+            printf("Restarting...\n");
+            chip8_initialize(sys);
+            load_rom(sys, s->rom);
+            sys->quirks.clip = s->clip ? 1 : 0;
+            chip8_seed(sys, s->seed);
+            state_replaced(s);
+            if (s->rewind_enabled) {
+                rewind_clear(s->rw);
+            }
+            printf("Restarted\n");
+        }
+
+        if (sys->EMU_flags.save_state) {
+            sys->EMU_flags.save_state = 0;
+            if (state_save(sys, s->state_path) == 0) {
+                printf("State saved to %s\n", s->state_path);
+            }
+            else {
+                LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "FAILED TO SAVE STATE TO %s", s->state_path);
+            }
+        }
+        else if (sys->EMU_flags.load_state) {
+            sys->EMU_flags.load_state = 0;
+            if (state_load(sys, s->state_path) == 0) {
+                state_replaced(s);
+                if (s->rewind_enabled) {
+                    rewind_clear(s->rw);
+                }
+                printf("State loaded from %s\n", s->state_path);
+            }
+            else {
+                LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "FAILED TO LOAD STATE FROM %s", s->state_path);
+            }
+        }
+
+        /* Maintain within the clock period */
+        scheduler_wait(&sched);
+    }
+
+    scheduler_report(&sched, stdout);
+    if (s->idle_skip) {
+        printf("ELIDED: %" PRIu64 " of %" PRIu64 " instructions (%.1f%%)\n", s->elided, s->instructions, s->instructions ? s->elided * 100.0 / s->instructions : 0);
+    }
+    atomic_store(&s->done, 1);
+    return 0;
+}
+#endif
+
+int main(int argc, char **argv) {
+    int i;
+    const char *rom = NULL;
+    const char *load_state = NULL, *save_state = NULL;
+    const char *record = NULL, *play = NULL;
+    const char *profile = NULL;
+    const char *scan = NULL;
+    const char *aot_path = NULL;
+    const char *trace_path = NULL;
+    int tracing = 1;
+    uint64_t profile_top = PROFILE_DEFAULT_TOP;
+    uint64_t seed = (uint64_t)time(NULL);
+    #if defined(NO_SDL)
+    int headless = 1;
+    #else
+    int headless = 0;
+    #endif
+    #if !defined(NO_SDL)
+    int mute = 0;
+    int debug = 0;
+    const char *debug_socket = NULL;
+    int sampling = -1, poll = -1;
+    #endif
+    int core = -1;
+    int ips = -1;
+    int idle_skip = -1;
+    uint64_t value;
+    Chip8_Core selected;
+    Headless_t opts = {.ips = DEFAULT_IPS, .core = CORE_INTERPRETER, .jit = NULL, .max_frames = 0, .max_instructions = 0, .dump_format = DUMP_FORMAT_PGM, .dump_prefix = "frame", .dump_count = 0};
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        }
+        #if !defined(NO_SDL)
+        else if (strcmp(argv[i], "--mute") == 0) {
+            mute = 1;
+        }
+        else if (strcmp(argv[i], "--debug") == 0) {
+            debug = 1;
+        }
+        else if (strcmp(argv[i], "--debug-socket") == 0 && i + 1 < argc) {
+            debug_socket = argv[++i];
+        }
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "frame") == 0) {
+                sampling = INPUT_FRAME;
+            }
+            else if (strcmp(argv[i], "timed") == 0) {
+                sampling = INPUT_TIMED;
+            }
+            else {
+                fprintf(stderr, "INVALID INPUT SAMPLING!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--input-poll") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &value) != 0 || value < 1 || value > INT_MAX) {
+                fprintf(stderr, "INVALID INPUT POLL INTERVAL!\n");
+                return 1;
+            }
+            poll = (int)value;
+        }
+        #endif
+        else if (strcmp(argv[i], "--core") == 0 && i + 1 < argc) {
+            if (parse_core(argv[++i], &selected) != 0) {
+                fprintf(stderr, "INVALID CORE!\n");
+                return 1;
+            }
+            core = selected;
+        }
+        else if (strcmp(argv[i], "--aot") == 0 && i + 1 < argc) {
+            aot_path = argv[++i];
+            core = CORE_AOT;
+        }
+        else if (strcmp(argv[i], "--idle-skip") == 0) {
+            idle_skip = 1;
+        }
+        else if (strcmp(argv[i], "--ips") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "unlimited") == 0) {
+                ips = IPS_UNLIMITED;
+            }
+            else if (str_to_u64(argv[i], &value) == 0 && value > 0 && value <= INT_MAX) {
+                ips = (int)value;
+            }
+            else {
+                fprintf(stderr, "INVALID IPS!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &opts.max_frames) != 0) {
+                fprintf(stderr, "INVALID FRAME COUNT!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--instructions") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &opts.max_instructions) != 0) {
+                fprintf(stderr, "INVALID INSTRUCTION COUNT!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            if (parse_dump_frames(argv[++i], &opts) != 0) {
+                fprintf(stderr, "INVALID DUMP FRAMES!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--dump-format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "ppm") == 0) {
+                opts.dump_format = DUMP_FORMAT_PPM;
+            }
+            else if (strcmp(argv[i], "pgm") == 0) {
+                opts.dump_format = DUMP_FORMAT_PGM;
+            }
+            else {
+                fprintf(stderr, "INVALID DUMP FORMAT!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--dump-prefix") == 0 && i + 1 < argc) {
+            opts.dump_prefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--load-state") == 0 && i + 1 < argc) {
+            load_state = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save-state") == 0 && i + 1 < argc) {
+            save_state = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &seed) != 0 || seed > UINT32_MAX) {
+                fprintf(stderr, "INVALID SEED!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record = argv[++i];
+        }
+        else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            play = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile-top") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &profile_top) != 0 || profile_top < 1 || profile_top > MEMORY_SIZE) {
+                fprintf(stderr, "INVALID PROFILE SIZE!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-trace") == 0) {
+            tracing = 0;
+        }
+        else if (strcmp(argv[i], "--scan") == 0 && i + 1 < argc) {
+            scan = argv[++i];
+        }
+        else if (argv[i][0] == '-' || rom) {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            rom = argv[i];
+        }
+    }
 
-    srand(time(NULL));
+    if (scan) {
+        return scan_roms(scan);
+    }
+    if (!rom) {
+        usage(argv[0]);
+        return 1;
+    }
+    if ((record || play) && load_state) {
+        fprintf(stderr, "A MOVIE CAN NOT START FROM A STATE!\n");
+        return 1;
+    }
+    if (record && (play || headless)) {
+        fprintf(stderr, "RECORDING NEEDS THE WINDOW AND NO PLAYBACK!\n");
+        return 1;
+    }
+    #if !defined(NO_SDL)
+    if ((debug || debug_socket) && headless) {
+        fprintf(stderr, "THE DEBUGGER NEEDS THE WINDOW!\n");
+        return 1;
+    }
+    #endif
 
     /* INITIALIZE THE CHIP-8 SYSTEM */
     Chip8_t sys;
     chip8_initialize(&sys);
-    int res = load_rom(&sys, argv[1]);
+    int res = load_rom(&sys, rom);
     switch (res) {
         case -1:
             fprintf(stderr, "INVALID ROM PATH!\n");
@@ -39,17 +758,36 @@ int main(int argc, char **argv) {
             fprintf(stderr, "FAILED TO LOAD ROM!\n");
             return 1;
         default:
-            printf("%s loaded!\n", argv[1]);
+            printf("%s loaded!\n", rom);
             break;
     }
 
+    /* Settings of this ROM in the catalog come before the configuration, the command line still wins */
+    Catalog_Profile rom_profile;
+    char section[CATALOG_SECTION_BUF];
+    ConfigTable *profiles = config_parse_file(CATALOG_PROFILES_PATH);
+    catalog_section(sys.rom_hash, section);
+    if (catalog_profile(profiles, sys.rom_hash, &rom_profile) > 0) {
+        printf("Using the profile of %s\n", section);
+        if (ips < 0) ips = rom_profile.ips;
+        if (core < 0) core = rom_profile.core;
+        if (idle_skip < 0) idle_skip = rom_profile.idle_skip;
+    }
+    if (profiles) {
+        config_cleanup(profiles);
+    }
+
     /* USER-CONFIGURATION */
+    #if !defined(NO_SDL)
     int scaling;
-    int ips;
+    int samples, tone;
+    #endif
+    int clip;
     RGBA_t background, pixel;
     ConfigTable *table = config_parse_file(CONFIG_FILE_PATH);
 
     if (table) {
+        #if !defined(NO_SDL)
         if (config_get_int(table, "scaling", "graphics", 10, &scaling) != 0) {
             scaling = DEFAULT_SCALING;
         }
@@ -58,22 +796,38 @@ int main(int argc, char **argv) {
             if (scaling > MAX_SCALING) scaling = MAX_SCALING;
         }
 
-        if (config_get_int(table, "instructions", "ips", 10, &ips) != 0) {
+        if (config_get_int(table, "samples", "audio", 10, &samples) != 0) {
+            samples = AUDIO_DEFAULT_SAMPLES;
+        }
+        if (config_get_int(table, "tone", "audio", 10, &tone) != 0 || tone < 1 || tone >= AUDIO_RATE / 2) {
+            tone = AUDIO_DEFAULT_TONE;
+        }
+
+        if (sampling < 0 && config_get_int(table, "sampling", "input", 10, &sampling) != 0) {
+            sampling = INPUT_FRAME;
+        }
+        if (poll < 0 && config_get_int(table, "poll", "input", 10, &poll) != 0) {
+            poll = 0;
+        }
+        #endif
+
+        if (ips < 0 && config_get_int(table, "ips", "instructions", 10, &ips) != 0) {
             ips = DEFAULT_IPS;
         }
-        else {
-            if (ips < 1) ips = DEFAULT_IPS;
-            if (ips > MAX_IPS) ips = MAX_IPS;
+        if (ips < 0) ips = DEFAULT_IPS;
+
+        if (core < 0 && config_get_int(table, "core", "instructions", 10, &core) != 0) {
+            core = CORE_INTERPRETER;
+        }
+
+        if (idle_skip < 0 && config_get_int(table, "idle_skip", "instructions", 10, &idle_skip) != 0) {
+            idle_skip = 0;
+        }
+
+        if (config_get_int(table, "clip", "quirks", 10, &clip) != 0) {
+            clip = 0;
         }
-    }
-    else {
-        scaling = DEFAULT_SCALING;
-        ips = DEFAULT_IPS;
-    }
 
-    /* INITIALIZE GRAPHICS */
-    Chip8_Graphics gfx;
-    if (table) {
         if (config_get_rgba(table, "background", "color", &background) != 0) {
             background.red = 0;
             background.green = 0;
@@ -88,6 +842,18 @@ int main(int argc, char **argv) {
         }
     }
     else {
+        #if !defined(NO_SDL)
+        scaling = DEFAULT_SCALING;
+        samples = AUDIO_DEFAULT_SAMPLES;
+        tone = AUDIO_DEFAULT_TONE;
+        if (sampling < 0) sampling = INPUT_FRAME;
+        if (poll < 0) poll = 0;
+        #endif
+        if (ips < 0) ips = DEFAULT_IPS;
+        if (core < 0) core = CORE_INTERPRETER;
+        if (idle_skip < 0) idle_skip = 0;
+        clip = 0;
+
         background.red = 0;
         background.green = 0;
         background.blue = 0;
@@ -98,86 +864,390 @@ int main(int argc, char **argv) {
         pixel.blue = 255;
         pixel.alpha = 255;
     }
-    gfx.background = &background;
-    gfx.pixel = &pixel;
 
-    if (graphics_init(&gfx, scaling, argv[1]) < 0) {
-        LOG_TO_STREAM(stderr, LOG_LEVEL_CRITICAL, LOG_FLAGS, "FAILED TO INITIALIZE GRAPHICS: %s", SDL_GetError());
-        graphics_cleanup(&gfx);
-    }
-    SDL_Event event;
+    if (rom_profile.clip >= 0) clip = rom_profile.clip;
+    if (rom_profile.has_background) background = rom_profile.background;
+    if (rom_profile.has_pixel) pixel = rom_profile.pixel;
+    sys.quirks.clip = clip ? 1 : 0;
 
-    /* We need to control execution by time */
-    int i;
-    uint64_t start, end;
-    double elapsed_time;
-    const double freq = SDL_GetPerformanceFrequency();
-    int ipf = ips / CLOCK_FREQUENCY;
+    /* A movie decides the seed, the instructions per second and the quirks, so the run repeats exactly */
+    Movie_t movie;
+    int playing = 0;
+    if (play) {
+        switch (movie_load(&movie, play)) {
+            case 0:
+                printf("%s loaded!\n", play);
+                break;
+            case -1:
+                fprintf(stderr, "INVALID MOVIE PATH!\n");
+                return 1;
+            case -3:
+                fprintf(stderr, "OUT OF MEMORY!\n");
+                return 1;
+            case -4:
+                fprintf(stderr, "UNSUPPORTED MOVIE VERSION!\n");
+                return 1;
+            default:
+                fprintf(stderr, "INVALID MOVIE!\n");
+                return 1;
+        }
+        seed = movie.seed;
+        ips = (int)movie.ips;
+        clip = movie.clip;
+        sys.quirks.clip = clip ? 1 : 0;
+        playing = 1;
+    }
+    /* How many instructions run at unlimited IPS depends on the host, so such a run can not be repeated */
+    if (ips == IPS_UNLIMITED && (headless || record)) {
+        fprintf(stderr, "UNLIMITED IPS NEED THE WINDOW AND NO RECORDING!\n");
+        return 1;
+    }
+    chip8_seed(&sys, (uint32_t)seed);
+    if (playing && !movie.big_font) {
+        memset(sys.memory + FONT_BIG_START, 0, 16 * FONT_BIG_SIZE);
+        chip8_predecode(&sys);
+    }
+    if (playing && chip8_hash(&sys) != movie.start_hash) {
+        fprintf(stderr, "THE MOVIE WAS RECORDED WITH ANOTHER ROM!\n");
+        movie_free(&movie);
+        return 1;
+    }
 
-    #if defined(DEBUG)
-    Debugger_t dbg = {.run = false, .executed = 0, .exec_max = 0};
-    #endif
+    /* A saved state replaces everything set up so far, including the quirks it was saved with */
+    if (load_state) {
+        switch (state_load(&sys, load_state)) {
+            case 0:
+                printf("%s loaded!\n", load_state);
+                break;
+            case -1:
+                fprintf(stderr, "INVALID STATE PATH!\n");
+                return 1;
+            case -4:
+                fprintf(stderr, "UNSUPPORTED STATE VERSION!\n");
+                return 1;
+            default:
+                fprintf(stderr, "INVALID STATE!\n");
+                return 1;
+        }
+    }
 
-    /* EMU LOOP*/
-    for (;;) {
-        start = SDL_GetPerformanceCounter();
+    /* The profiler counts every instruction, so it runs its own interpreter loop */
+    static Profile_t prof;
+    Profile_t *profp = NULL;
+    if (profile) {
+        if (profile_init(&prof) != 0) {
+            fprintf(stderr, "OUT OF MEMORY!\n");
+            return 1;
+        }
+        if (core > CORE_INTERPRETER) {
+            fprintf(stderr, "THE PROFILER RUNS ON THE INTERPRETER, USING THE INTERPRETER!\n");
+        }
+        core = CORE_INTERPRETER;
+        profp = &prof;
+    }
 
-        await_keypress(&event, &sys);
+    /* Finding busy waits means watching single instructions, so it runs on the interpreter as well */
+    if (idle_skip > 0 && !profp) {
+        if (core > CORE_INTERPRETER) {
+            fprintf(stderr, "IDLE SKIPPING RUNS ON THE INTERPRETER, USING THE INTERPRETER!\n");
+        }
+        core = CORE_INTERPRETER;
+    }
+    else {
+        idle_skip = 0;
+    }
 
-        #if defined(DEBUG)
-        debugger_cli(&dbg, &sys, &gfx);
-        #endif
+    /* INITIALIZE THE EXECUTION CORE */
+    Jit_t *jitp = NULL;
+    Aot_t *aotp = NULL;
+    static Jit_t jit;
+    if (core == CORE_JIT) {
+        if (jit_init(&jit) == 0) {
+            jitp = &jit;
+        }
+        else {
+            fprintf(stderr, "FAILED TO INITIALIZE THE JIT, USING THE INTERPRETER!\n");
+            core = CORE_INTERPRETER;
+        }
+    }
 
-        /* Execute the amount of instructions per frame*/
-        for (i = 0; i < ipf; i++) {
-            chip8_emulatecycle(&sys);
-            #if defined(DEBUG)
-            dbg.executed++;
-            if (dbg.executed >= dbg.exec_max) {
+    /* The blocks of a translation are checked against memory, so it is loaded once the state is */
+    static Aot_t aot;
+    if (core == CORE_AOT && !aot_path) {
+        fprintf(stderr, "THE AOT CORE NEEDS A LIBRARY FROM --aot, USING THE INTERPRETER!\n");
+        core = CORE_INTERPRETER;
+    }
+    else if (core == CORE_AOT) {
+        switch (aot_load(&aot, aot_path)) {
+            case 0:
                 break;
+            case -1:
+                fprintf(stderr, "INVALID AOT LIBRARY PATH!\n");
+                return 1;
+            case -4:
+                fprintf(stderr, "UNSUPPORTED AOT LIBRARY VERSION!\n");
+                return 1;
+            default:
+                fprintf(stderr, "INVALID AOT LIBRARY!\n");
+                return 1;
+        }
+        if (aot.module->rom_hash != sys.rom_hash) {
+            fprintf(stderr, "THE LIBRARY WAS TRANSLATED FROM ANOTHER ROM!\n");
+            aot_cleanup(&aot);
+            return 1;
+        }
+        aot_reset(&aot, &sys);
+        aotp = &aot;
+    }
+    if (core != CORE_JIT && core != CORE_THREADED && core != CORE_AOT) {
+        core = CORE_INTERPRETER;
+    }
+
+    /* Every core keeps what it takes to replay its last instructions for a post-mortem */
+    static Trace_t trace;
+    Trace_t *tracep = NULL;
+    char trace_default[TRACE_PATH_BUF];
+    if (tracing) {
+        if (!trace_path && snprintf(trace_default, sizeof(trace_default), "%s.trace", rom) < (int)sizeof(trace_default)) {
+            trace_path = trace_default;
+        }
+        if (trace_path && trace_init(&trace, trace_path, &sys) == 0) {
+            trace_catch_signals(&trace);
+            tracep = &trace;
+        }
+        else {
+            fprintf(stderr, "THE TRACE PATH IS TOO LONG, TRACING IS DISABLED!\n");
+        }
+    }
+
+    /* The buzzer, headless runs only count the frames it sounds */
+    static Audio_t audio;
+    audio_null_init(&audio);
+
+    /* HEADLESS MODE */
+    if (headless) {
+        Headless_Report report;
+        int ret = 0;
+
+        opts.ips = (uint64_t)ips;
+        opts.background = &background;
+        opts.pixel = &pixel;
+        opts.core = core;
+        opts.jit = jitp;
+        opts.aot = aotp;
+        opts.profile = profp;
+        opts.trace = tracep;
+        opts.idle_skip = idle_skip;
+        opts.audio = &audio;
+        if (playing) {
+            opts.input = &movie.script;
+            if (!opts.max_frames && !opts.max_instructions) {
+                opts.max_frames = movie.frames;
             }
-            #endif
         }
 
-        chip8_update_timers(&sys);
+        headless_run(&sys, &opts, &report);
+        headless_print_report(&report);
+
+        if (playing && report.frames == movie.frames) {
+            if (chip8_hash(&sys) == movie.end_hash) {
+                printf("PLAYBACK MATCHED\n");
+            }
+            else {
+                fprintf(stderr, "PLAYBACK DIVERGED!\n");
+                ret = 1;
+            }
+        }
+        else if (playing && sys.EMU_flags.exit) {
+            fprintf(stderr, "PLAYBACK STOPPED AT FRAME %" PRIu64 " OF %" PRIu64 "!\n", report.frames, movie.frames);
+            ret = 1;
+        }
+        if (playing) {
+            movie_free(&movie);
+        }
 
-        if (sys.EMU_flags.draw_to_screen) {
-            graphics_update(&gfx, &sys);
+        if (save_state && state_save(&sys, save_state) != 0) {
+            fprintf(stderr, "FAILED TO SAVE STATE!\n");
         }
 
-        if (sys.EMU_flags.exit) {
-            printf("Exiting...\n");
-            break;
+        if (profp) {
+            write_profile(profp, profile, (int)profile_top);
+            profile_cleanup(profp);
         }
-        else if (sys.EMU_flags.pause) {
-            printf("Paused\n");
-            await_unpause(&event, &sys);
-            printf("Unpaused\n");
+        if (jitp) {
+            jit_cleanup(jitp);
         }
-        else if (sys.EMU_flags.restart) {
-            printf("Restarting...\n");
-            chip8_initialize(&sys);
-            load_rom(&sys, argv[1]);
-            printf("Restarted\n");
+        if (aotp) {
+            aot_cleanup(aotp);
+        }
+        if (table) {
+            config_cleanup(table);
         }
+        return ret;
+    }
 
-        /* Maintain within the clock period */
-        end = SDL_GetPerformanceCounter();
-        elapsed_time = ((end - start) * 1000) / freq;
+    #if !defined(NO_SDL)
+    /* INITIALIZE GRAPHICS */
+    Chip8_Graphics gfx;
+    gfx.background = &background;
+    gfx.pixel = &pixel;
+
+    if (graphics_init(&gfx, scaling, rom) < 0) {
+        LOG_TO_STREAM(stderr, LOG_LEVEL_CRITICAL, LOG_FLAGS, "FAILED TO INITIALIZE GRAPHICS: %s", SDL_GetError());
+        graphics_cleanup(&gfx);
+    }
+    SDL_Event event;
+
+    /* The device wants a power of two, smaller buffers start and stop the tone sooner */
+    int buffer = 64;
+    while (buffer < samples && buffer < AUDIO_MAX_SAMPLES) {
+        buffer <<= 1;
+    }
+    if (mute) {
+        audio_null_init(&audio);
+    }
+    else if (audio_sdl_init(&audio, buffer, tone) != 0) {
+        LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "FAILED TO OPEN THE AUDIO DEVICE, SOUND IS DISABLED: %s", SDL_GetError());
+    }
+
+    /* Rewind history and the quick save slot next to the ROM */
+    static Rewind_t rw;
+    int rewind_enabled = rewind_init(&rw) == 0;
+    if (!rewind_enabled) {
+        LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "FAILED TO ALLOCATE THE REWIND BUFFER, REWIND IS DISABLED");
+    }
+    char state_path[STATE_PATH_BUF];
+    snprintf(state_path, sizeof(state_path), "%s.state", rom);
 
-        if (elapsed_time < CLOCK_PERIOD) {
-            SDL_Delay((uint32_t)(CLOCK_PERIOD - elapsed_time));
+    /* Debug clients connect once the emulation runs */
+    static Remote_t remote;
+    Remote_t *remotep = NULL;
+    if (debug_socket) {
+        switch (remote_open(&remote, debug_socket)) {
+            case 0:
+                printf("Debug server listening on %s\n", debug_socket);
+                remotep = &remote;
+                break;
+            case -2:
+                LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "DEBUG SOCKET PATH %s IS TOO LONG, THE DEBUG SERVER IS DISABLED", debug_socket);
+                break;
+            default:
+                LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "FAILED TO OPEN THE DEBUG SOCKET %s, THE DEBUG SERVER IS DISABLED", debug_socket);
+                break;
         }
+    }
 
-        #if defined(DEBUG)
-        if (dbg.executed >= dbg.exec_max) {
-            dbg.run = false;
-            dbg.executed = 0;
+    /* Movies replace the keypad (playback) or write it down (recording), rewinding, restarting and loading states would break them */
+    Movie_Recorder recorder;
+    int recording = 0;
+    if (record) {
+        if (movie_record_start(&recorder, record, &sys, (uint32_t)seed, (uint32_t)ips) == 0) {
+            recording = 1;
+        }
+        else {
+            LOG_TO_STREAM(stderr, LOG_LEVEL_WARNING, LOG_FLAGS, "FAILED TO START RECORDING TO %s", record);
         }
-        #endif
     }
 
+    /* From here on the system belongs to the emulation thread */
+    static Session_t session;
+    session.sys = &sys;
+    session.rom = rom;
+    session.clip = clip;
+    session.seed = (uint32_t)seed;
+    session.core = core;
+    session.ips = (uint64_t)ips;
+    session.jit = jitp;
+    session.aot = aotp;
+    session.prof = profp;
+    session.trace = tracep;
+    session.idle_skip = idle_skip;
+    session.instructions = 0;
+    session.elided = 0;
+    session.audio = &audio;
+    session.rw = &rw;
+    session.rewind_enabled = rewind_enabled;
+    session.state_path = state_path;
+    session.recorder = &recorder;
+    session.record = record;
+    session.recording = recording;
+    session.movie = &movie;
+    session.play = play;
+    session.playing = playing;
+    session.frame = 0;
+    session.sampling = poll > 0 ? INPUT_POLL : (sampling == INPUT_TIMED ? INPUT_TIMED : INPUT_FRAME);
+    session.poll = poll;
+    session.presses = 0;
+    debugger_init(&session.dbg);
+    session.remote = remotep;
+    if (debug) {
+        debugger_attach(&session.dbg);
+    }
+    queue_init(&session.events);
+    triple_init(&session.frames);
+    atomic_init(&session.done, 0);
+
+    SDL_Thread *emulation = SDL_CreateThread(emulation_main, "emulation", &session);
+    if (!emulation) {
+        LOG_TO_STREAM(stderr, LOG_LEVEL_CRITICAL, LOG_FLAGS, "FAILED TO START THE EMULATION THREAD: %s", SDL_GetError());
+        atomic_store(&session.done, 1);
+    }
+
+    /* The SDL thread only polls input and presents the newest frame, a frame it missed makes every row a candidate */
+    const Frame_t *latest;
+    uint64_t shown_seq = 0, counted = 0;
+    Latency_t latency = {.count = 0, .sum = 0, .min = UINT64_MAX, .max = 0};
+    while (!atomic_load(&session.done)) {
+        await_keypress(&event, &session.events);
+
+        latest = triple_acquire(&session.frames);
+        if (latest) {
+            graphics_present(&gfx, latest->gfx, latest->width, latest->height, latest->seq == shown_seq + 1 ? latest->dirty : DISPLAY_ALL_ROWS);
+            shown_seq = latest->seq;
+            counted = count_latency(&latency, &session, counted, latest->inputs);
+        }
+        else {
+            SDL_Delay(1);
+        }
+    }
+    if (emulation) {
+        SDL_WaitThread(emulation, NULL);
+    }
+    recording = session.recording;
+    playing = session.playing;
+
+    if (save_state && state_save(&sys, save_state) != 0) {
+        fprintf(stderr, "FAILED TO SAVE STATE!\n");
+    }
+    if (recording && movie_record_finish(&recorder, &sys, session.frame) != 0) {
+        fprintf(stderr, "FAILED TO FINISH RECORDING!\n");
+    }
+    if (playing) {
+        movie_free(&movie);
+    }
+    if (rewind_enabled) {
+        rewind_cleanup(&rw);
+    }
+    if (remotep) {
+        remote_close(remotep);
+    }
+    printf("Frames presented: %" PRIu64 ", skipped: %" PRIu64 ", rows uploaded: %" PRIu64 "\n", gfx.frames_presented, gfx.frames_skipped, gfx.rows_uploaded);
+    if (latency.count) {
+        printf("Input to present (%s): mean %.3f ms, min %.3f ms, max %.3f ms over %" PRIu64 " key presses\n", sampling_name(&session), latency.sum / 1e6 / latency.count, latency.min / 1e6, latency.max / 1e6, latency.count);
+    }
+    audio_sdl_cleanup(&audio);
     graphics_cleanup(&gfx);
+    #endif
+    if (profp) {
+        write_profile(profp, profile, (int)profile_top);
+        profile_cleanup(profp);
+    }
+    if (jitp) {
+        jit_cleanup(jitp);
+    }
+    if (aotp) {
+        aot_cleanup(aotp);
+    }
     if (table) {
         config_cleanup(table);
     }
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "input.h"
+#include "movie.h"
+
+static void put_le(uint8_t *p, uint64_t v, int bytes) {
+    int i;
+    for (i = 0; i < bytes; i++) {
+        p[i] = (v >> (8 * i)) & 0xFF;
+    }
+    return;
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes) {
+    uint64_t v = 0;
+    int i;
+    for (i = 0; i < bytes; i++) {
+        v |= (uint64_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+static int write_header(FILE *fp, const Movie_t *movie) {
+    uint8_t header[MOVIE_HEADER_SIZE];
+
+    memcpy(header, MOVIE_MAGIC, 4);
+    put_le(header + 4, MOVIE_VERSION, 2);
+    put_le(header + 6, movie->clip ? 1 : 0, 2);
+    put_le(header + 8, movie->seed, 4);
+    put_le(header + 12, movie->ips, 4);
+    put_le(header + 16, movie->frames, 8);
+    put_le(header + 24, movie->start_hash, 8);
+    put_le(header + 32, movie->end_hash, 8);
+
+    return fwrite(header, 1, sizeof(header), fp) == sizeof(header) ? 0 : -3;
+}
+
+/*
+Start recording a run
+    - Call it once the ROM is loaded and the system is seeded with seed
+    - The header is written again with the frame count and end hash by movie_record_finish()
+*/
+int movie_record_start(Movie_Recorder *rec, const char *path, const Chip8_t *system, uint32_t seed, uint32_t ips) {
+    rec->fp = fopen(path, "wb");
+    if (!rec->fp) {
+        return -1;
+    }
+
+    rec->movie.seed = seed;
+    rec->movie.ips = ips;
+    rec->movie.clip = system->quirks.clip;
+    rec->movie.big_font = 1;
+    rec->movie.frames = 0;
+    rec->movie.start_hash = chip8_hash(system);
+    rec->movie.end_hash = 0;
+    memset(&rec->movie.script, 0, sizeof(rec->movie.script));
+    memset(rec->keys, 0, sizeof(rec->keys));
+    rec->last_frame = 0;
+
+    if (write_header(rec->fp, &rec->movie) != 0) {
+        fclose(rec->fp);
+        rec->fp = NULL;
+        return -3;
+    }
+    return 0;
+}
+
+/* Record the keys that changed since the last frame, call it before the frame's instructions run */
+int movie_record_frame(Movie_Recorder *rec, const Chip8_t *system, uint64_t frame) {
+    uint8_t buf[11];
+    uint64_t delta;
+    int i, len;
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        if (system->key[i] == rec->keys[i]) {
+            continue;
+        }
+        rec->keys[i] = system->key[i];
+
+        len = 0;
+        delta = frame - rec->last_frame;
+        do {
+            buf[len] = delta & 0x7F;
+            delta >>= 7;
+            if (delta) buf[len] |= 0x80;
+            len++;
+        } while (delta);
+        buf[len++] = i | (system->key[i] ? 0x10 : 0);
+        rec->last_frame = frame;
+
+        if (fwrite(buf, 1, len, rec->fp) != (size_t)len) {
+            return -3;
+        }
+    }
+    return 0;
+}
+
+int movie_record_finish(Movie_Recorder *rec, const Chip8_t *system, uint64_t frames) {
+    int ret = 0;
+
+    rec->movie.frames = frames;
+    rec->movie.end_hash = chip8_hash(system);
+    if (fseek(rec->fp, 0, SEEK_SET) != 0 || write_header(rec->fp, &rec->movie) != 0) {
+        ret = -3;
+    }
+    if (fclose(rec->fp) != 0) {
+        ret = -3;
+    }
+    rec->fp = NULL;
+    return ret;
+}
+
+/*
+Read a movie, its key changes become an input script for input_apply()
+    - -1 if the file can not be opened, -2 if it is not a movie or is truncated, -3 out of memory, -4 if it was written by another version
+    - Version 1 stored whole instructions per frame, they are turned into the same instructions per second
+*/
+int movie_load(Movie_t *movie, const char *path) {
+    FILE *fp;
+    uint8_t header[MOVIE_HEADER_SIZE];
+    uint64_t frame = 0, delta;
+    int c, shift, version;
+
+    memset(&movie->script, 0, sizeof(movie->script));
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header) || memcmp(header, MOVIE_MAGIC, 4) != 0) {
+        fclose(fp);
+        return -2;
+    }
+    version = (int)get_le(header + 4, 2);
+    if (version < 1 || version > MOVIE_VERSION) {
+        fclose(fp);
+        return -4;
+    }
+    movie->clip = get_le(header + 6, 2) & 1;
+    movie->big_font = version >= 3;
+    movie->seed = (uint32_t)get_le(header + 8, 4);
+    movie->ips = (uint32_t)get_le(header + 12, 4);
+    if (version == 1) {
+        movie->ips *= CLOCK_FREQUENCY;
+    }
+    if (movie->ips == 0) {
+        fclose(fp);
+        return -2;
+    }
+    movie->frames = get_le(header + 16, 8);
+    movie->start_hash = get_le(header + 24, 8);
+    movie->end_hash = get_le(header + 32, 8);
+
+    while ((c = fgetc(fp)) != EOF) {
+        delta = 0;
+        shift = 0;
+        while (c & 0x80) {
+            delta |= (uint64_t)(c & 0x7F) << shift;
+            shift += 7;
+            c = fgetc(fp);
+            if (c == EOF || shift > 63) {
+                fclose(fp);
+                movie_free(movie);
+                return -2;
+            }
+        }
+        delta |= (uint64_t)c << shift;
+        frame += delta;
+
+        c = fgetc(fp);
+        if (c == EOF || c > 0x1F) {
+            fclose(fp);
+            movie_free(movie);
+            return -2;
+        }
+        if (input_push(&movie->script, frame, c & 0xF, c >> 4) != 0) {
+            fclose(fp);
+            movie_free(movie);
+            return -3;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+void movie_free(Movie_t *movie) {
+    input_free(&movie->script);
+    return;
+}
\ No newline at end of file
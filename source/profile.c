@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "chip8.h"
+#include "profile.h"
+
+static const char *class_names[16] = {
+    "0NNN system", "1NNN jump", "2NNN call", "3XNN skip", "4XNN skip", "5XY0 skip", "6XNN load", "7XNN add",
+    "8XYN alu", "9XY0 skip", "ANNN index", "BNNN jump", "CXNN rand", "DXYN draw", "EXNN key", "FXNN misc"
+};
+
+int profile_init(Profile_t *prof) {
+    memset(prof, 0, sizeof(*prof));
+    prof->node_cap = 64;
+    prof->nodes = malloc(prof->node_cap * sizeof(Profile_Node));
+    if (!prof->nodes) {
+        return -3;
+    }
+
+    prof->nodes[0].addr = PROGRAM_START;
+    prof->nodes[0].parent = -1;
+    prof->nodes[0].child = -1;
+    prof->nodes[0].sibling = -1;
+    prof->nodes[0].depth = 0;
+    prof->nodes[0].self = 0;
+    prof->node_count = 1;
+    prof->current = 0;
+    return 0;
+}
+
+/* Child of the current node for a subroutine at addr, created on the first call */
+static int enter(Profile_t *prof, uint16_t addr) {
+    Profile_Node *nodes;
+    int i, parent = prof->current;
+
+    if (prof->nodes[parent].depth >= PROFILE_MAX_DEPTH) {
+        return parent;
+    }
+    for (i = prof->nodes[parent].child; i >= 0; i = prof->nodes[i].sibling) {
+        if (prof->nodes[i].addr == addr) {
+            return i;
+        }
+    }
+
+    if (prof->node_count == prof->node_cap) {
+        nodes = realloc(prof->nodes, prof->node_cap * 2 * sizeof(Profile_Node));
+        if (!nodes) {
+            return parent;
+        }
+        prof->nodes = nodes;
+        prof->node_cap *= 2;
+    }
+    i = prof->node_count++;
+    prof->nodes[i].addr = addr;
+    prof->nodes[i].parent = parent;
+    prof->nodes[i].child = -1;
+    prof->nodes[i].sibling = prof->nodes[parent].child;
+    prof->nodes[i].depth = prof->nodes[parent].depth + 1;
+    prof->nodes[i].self = 0;
+    prof->nodes[parent].child = i;
+    return i;
+}
+
+/*
+Execute budget instructions on the interpreter while counting them
+    - The ROM sees no difference, every instruction still goes through chip8_emulatecycle()
+    - Only this loop pays for profiling, the other cores are untouched
+*/
+int profile_run(Profile_t *prof, Chip8_t *system, int budget) {
+    int i;
+    uint16_t pc, opcode;
+
+    for (i = 0; i < budget; i++) {
+        pc = system->pc & (MEMORY_SIZE - 1);
+        opcode = system->decoded[pc].opcode;
+
+        prof->total++;
+        prof->pc[pc]++;
+        prof->opcode[pc] = opcode;
+        prof->classes[opcode >> 12]++;
+        prof->nodes[prof->current].self++;
+
+        chip8_emulatecycle(system);
+
+        if ((opcode & 0xF000) == 0x2000) {
+            prof->current = enter(prof, opcode & 0x0FFF);
+        }
+        else if (opcode == 0x00EE) {
+            if (prof->nodes[prof->current].parent >= 0) {
+                prof->current = prof->nodes[prof->current].parent;
+            }
+        }
+        else if (((opcode & 0xF000) == 0x1000 || (opcode & 0xF000) == 0xB000) && system->pc <= pc) {
+            prof->loop_target[pc] = system->pc & (MEMORY_SIZE - 1);
+            prof->loop_count[pc]++;
+        }
+
+        if (system->EMU_flags.exit) {
+            return i + 1;
+        }
+    }
+    return budget;
+}
+
+static void write_stack(FILE *fp, const Profile_t *prof, int node) {
+    if (prof->nodes[node].parent >= 0) {
+        write_stack(fp, prof, prof->nodes[node].parent);
+        fprintf(fp, ";sub_%03" PRIX16, prof->nodes[node].addr);
+    }
+    else {
+        fprintf(fp, "rom");
+    }
+    return;
+}
+
+/* One line per call stack: frames separated by ';', a space and the instructions executed there (flamegraph.pl, speedscope, inferno) */
+int profile_write_folded(const Profile_t *prof, const char *path) {
+    FILE *fp;
+    int i;
+
+    fp = fopen(path, "w");
+    if (!fp) {
+        return -1;
+    }
+    for (i = 0; i < prof->node_count; i++) {
+        if (prof->nodes[i].self == 0) {
+            continue;
+        }
+        write_stack(fp, prof, i);
+        fprintf(fp, " %" PRIu64 "\n", prof->nodes[i].self);
+    }
+    if (fclose(fp) != 0) {
+        return -2;
+    }
+    return 0;
+}
+
+/* Indexes of the largest non-zero counts in descending order, at most top */
+static int top_entries(const uint64_t *counts, int len, int *out, int top) {
+    int i, j, n = 0;
+
+    for (i = 0; i < len; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        if (n < top) {
+            j = n++;
+        }
+        else if (counts[i] > counts[out[top - 1]]) {
+            j = top - 1;
+        }
+        else {
+            continue;
+        }
+        while (j > 0 && counts[out[j - 1]] < counts[i]) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = i;
+    }
+    return n;
+}
+
+/*
+Human readable summary
+    - Hottest addresses and opcode families
+    - Hottest loops, weighted by the instructions executed between the jump target and the jump
+*/
+void profile_write_report(const Profile_t *prof, FILE *fp, int top) {
+    uint64_t weight[MEMORY_SIZE] = {0};
+    int *idx, n, i, a;
+    double total = prof->total ? (double)prof->total : 1;
+
+    idx = malloc((top > 16 ? top : 16) * sizeof(int));
+    if (!idx) {
+        return;
+    }
+
+    fprintf(fp, "INSTRUCTIONS: %" PRIu64 "\n", prof->total);
+
+    fprintf(fp, "\nHOT ADDRESSES\n");
+    n = top_entries(prof->pc, MEMORY_SIZE, idx, top);
+    for (i = 0; i < n; i++) {
+        fprintf(fp, "  0x%03X  %04" PRIX16 "  %12" PRIu64 "  %5.1f%%\n", idx[i], prof->opcode[idx[i]], prof->pc[idx[i]], prof->pc[idx[i]] * 100 / total);
+    }
+
+    fprintf(fp, "\nOPCODE CLASSES\n");
+    n = top_entries(prof->classes, 16, idx, 16);
+    for (i = 0; i < n; i++) {
+        fprintf(fp, "  %-12s  %12" PRIu64 "  %5.1f%%\n", class_names[idx[i]], prof->classes[idx[i]], prof->classes[idx[i]] * 100 / total);
+    }
+
+    for (i = 0; i < MEMORY_SIZE; i++) {
+        if (prof->loop_count[i] == 0) {
+            continue;
+        }
+        for (a = prof->loop_target[i]; a <= i; a++) {
+            weight[i] += prof->pc[a];
+        }
+    }
+    fprintf(fp, "\nHOT LOOPS\n");
+    n = top_entries(weight, MEMORY_SIZE, idx, top);
+    for (i = 0; i < n; i++) {
+        fprintf(fp, "  0x%03X-0x%03X  %12" PRIu64 " iterations  %12" PRIu64 " instructions  %5.1f%%\n",
+                prof->loop_target[idx[i]], idx[i], prof->loop_count[idx[i]], weight[idx[i]], weight[idx[i]] * 100 / total);
+    }
+
+    free(idx);
+    return;
+}
+
+void profile_cleanup(Profile_t *prof) {
+    free(prof->nodes);
+    prof->nodes = NULL;
+    prof->node_count = 0;
+    prof->node_cap = 0;
+    return;
+}
\ No newline at end of file
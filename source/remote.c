@@ -0,0 +1,472 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "chip8.h"
+#include "debugger.h"
+#include "remote.h"
+
+#define REMOTE_MAX_ARGS 4
+
+/* Room a request needs in out before it is handled, the largest reply is all memory in hex */
+#define REMOTE_REPLY_MAX (MEMORY_SIZE * 2 + 32)
+
+static const char *stop_names[] = {
+    "none", "step", "halt", "break", "invalid", "overflow", "underflow", "read", "write", "condition"
+};
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Queue a reply line, a reply that does not fit is cut and the client will see a broken line */
+static void reply(Remote_t *r, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf((char *)r->out + r->out_len, sizeof(r->out) - r->out_len, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        r->out_len += (size_t)n < sizeof(r->out) - r->out_len ? (size_t)n : sizeof(r->out) - r->out_len - 1;
+    }
+    return;
+}
+
+static void reply_bytes(Remote_t *r, const uint8_t *data, size_t len) {
+    if (len > sizeof(r->out) - r->out_len) {
+        len = sizeof(r->out) - r->out_len;
+    }
+    memcpy(r->out + r->out_len, data, len);
+    r->out_len += len;
+    return;
+}
+
+/* Send what the socket takes right now, 0 unless the client is gone */
+static int flush(Remote_t *r) {
+    ssize_t n;
+
+    while (r->out_len > 0) {
+        n = send(r->client_fd, r->out, r->out_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        memmove(r->out, r->out + n, r->out_len - n);
+        r->out_len -= n;
+    }
+    return 0;
+}
+
+static int parse_hex(const char *s, unsigned long max, unsigned long *out) {
+    unsigned long l;
+    char *end = NULL;
+    errno = 0;
+
+    if (!s || *s == '-') {
+        return -1;
+    }
+    l = strtoul(s, &end, 16);
+    if (errno != 0 || end == s || *end != '\0' || l > max) {
+        return -1;
+    }
+    *out = l;
+
+    return 0;
+}
+
+static int split(char *line, char **argv) {
+    char *save = NULL, *tok;
+    int argc = 0;
+
+    for (tok = strtok_r(line, " \t\r", &save); tok && argc < REMOTE_MAX_ARGS; tok = strtok_r(NULL, " \t\r", &save)) {
+        argv[argc++] = tok;
+    }
+    return argc;
+}
+
+/* Address and length of a memory request, the range wraps around memory like the instructions do */
+static int parse_range(Remote_t *r, int argc, char **argv, unsigned long *addr, unsigned long *len) {
+    if (argc != 3 || parse_hex(argv[1], MEMORY_SIZE - 1, addr) != 0 || parse_hex(argv[2], MEMORY_SIZE, len) != 0 || *len == 0) {
+        reply(r, "ERR %s <addr> <len>\n", argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+static void reply_regs(Remote_t *r, const Chip8_t *system) {
+    int i;
+
+    reply(r, "OK pc=%03" PRIX16 " i=%03" PRIX16 " sp=%" PRIX16 " dt=%02" PRIX8 " st=%02" PRIX8 " v=", system->pc, system->I, system->sp, system->delay_timer, system->sound_timer);
+    for (i = 0; i < REGISTER_COUNT; i++) {
+        reply(r, "%02" PRIX8, system->V[i]);
+    }
+    reply(r, " stack=");
+    for (i = 0; i < STACK_SIZE; i++) {
+        reply(r, "%s%03" PRIX16, i ? "," : "", system->stack[i]);
+    }
+    reply(r, "\n");
+    return;
+}
+
+/* Set V0 to VF, I, PC, SP, DT or ST, returns 1 when pc moved */
+static int set_register(Remote_t *r, Chip8_t *system, const char *name, const char *value) {
+    unsigned long reg, v;
+
+    if (parse_hex(value, UINT16_MAX, &v) != 0) {
+        reply(r, "ERR INVALID VALUE\n");
+        return 0;
+    }
+    if ((name[0] == 'V' || name[0] == 'v') && parse_hex(name + 1, REGISTER_COUNT - 1, &reg) == 0 && v <= UINT8_MAX) {
+        system->V[reg] = (uint8_t)v;
+    }
+    else if (strcasecmp(name, "I") == 0) {
+        system->I = (uint16_t)v;
+    }
+    else if (strcasecmp(name, "PC") == 0) {
+        system->pc = (uint16_t)v;
+        reply(r, "OK\n");
+        return 1;
+    }
+    else if (strcasecmp(name, "SP") == 0) {
+        system->sp = (uint16_t)v;
+    }
+    else if (strcasecmp(name, "DT") == 0 && v <= UINT8_MAX) {
+        system->delay_timer = (uint8_t)v;
+    }
+    else if (strcasecmp(name, "ST") == 0 && v <= UINT8_MAX) {
+        system->sound_timer = (uint8_t)v;
+    }
+    else {
+        reply(r, "ERR INVALID REGISTER\n");
+        return 0;
+    }
+    reply(r, "OK\n");
+    return 0;
+}
+
+/* Write the bytes given as hex digits, returns 1 when memory changed */
+static int write_memory(Remote_t *r, Chip8_t *system, int argc, char **argv) {
+    uint8_t data[MEMORY_SIZE];
+    unsigned long addr;
+    size_t len, i;
+    char digits[3] = {0};
+    char *end;
+
+    if (argc != 3 || parse_hex(argv[1], MEMORY_SIZE - 1, &addr) != 0) {
+        reply(r, "ERR write <addr> <bytes>\n");
+        return 0;
+    }
+    len = strlen(argv[2]) / 2;
+    if (strlen(argv[2]) % 2 != 0 || len == 0 || len > MEMORY_SIZE) {
+        reply(r, "ERR INVALID BYTES\n");
+        return 0;
+    }
+    for (i = 0; i < len; i++) {
+        digits[0] = argv[2][i * 2];
+        digits[1] = argv[2][i * 2 + 1];
+        data[i] = (uint8_t)strtoul(digits, &end, 16);
+        if (*end != '\0') {
+            reply(r, "ERR INVALID BYTES\n");
+            return 0;
+        }
+    }
+    chip8_write(system, (uint16_t)addr, data, (uint16_t)len);
+    reply(r, "OK\n");
+    return 1;
+}
+
+/* Handle one request line, returns 1 when the state changed behind the back of the selected core */
+static int handle(Remote_t *r, Debugger_t *dbg, Chip8_t *system, char *line) {
+    static const char hex[] = "0123456789ABCDEF";
+    char *argv[REMOTE_MAX_ARGS];
+    unsigned long addr, len, i;
+    uint8_t point, byte;
+    int argc;
+
+    /* A condition is handed to the debugger whole */
+    if (strncmp(line, "cond ", 5) == 0) {
+        switch (debugger_add_condition(dbg, system, line + 5)) {
+            case 0:
+                reply(r, "OK %d\n", dbg->condition_count - 1);
+                break;
+            case -1:
+                reply(r, "ERR TOO MANY CONDITIONS\n");
+                break;
+            default:
+                reply(r, "ERR cond <V0x0|I> <==|!=|<|>> <0x0>\n");
+                break;
+        }
+        return 0;
+    }
+
+    argc = split(line, argv);
+    if (argc == 0) {
+        return 0;
+    }
+
+    if (strcmp(argv[0], "status") == 0) {
+        reply(r, "OK %s %03" PRIX16 "\n", !dbg->active ? "detached" : (dbg->run ? "running" : "halted"), system->pc);
+    }
+    else if (strcmp(argv[0], "halt") == 0) {
+        debugger_halt(dbg);
+        reply(r, "OK %03" PRIX16 "\n", system->pc);
+    }
+    else if (strcmp(argv[0], "step") == 0) {
+        len = 1;
+        if (argc > 1 && (parse_hex(argv[1], ULONG_MAX, &len) != 0 || len == 0)) {
+            reply(r, "ERR step [count]\n");
+            return 0;
+        }
+        debugger_resume(dbg, len);
+        reply(r, "OK\n");
+    }
+    else if (strcmp(argv[0], "continue") == 0) {
+        debugger_resume(dbg, 0);
+        reply(r, "OK\n");
+    }
+    else if (strcmp(argv[0], "detach") == 0) {
+        dbg->active = false;
+        reply(r, "OK\n");
+        return 1;
+    }
+    else if (strcmp(argv[0], "break") == 0 || strcmp(argv[0], "unbreak") == 0) {
+        if (argc != 2 || parse_hex(argv[1], MEMORY_SIZE - 1, &addr) != 0) {
+            reply(r, "ERR %s <addr>\n", argv[0]);
+            return 0;
+        }
+        debugger_set_point(dbg, (uint16_t)addr, DEBUG_BREAK, argv[0][0] == 'b');
+        reply(r, "OK\n");
+    }
+    else if (strcmp(argv[0], "watch") == 0) {
+        point = 0;
+        if (argc == 3) {
+            point |= strchr(argv[1], 'r') ? DEBUG_WATCH_READ : 0;
+            point |= strchr(argv[1], 'w') ? DEBUG_WATCH_WRITE : 0;
+        }
+        if (point == 0 || parse_hex(argv[2], MEMORY_SIZE - 1, &addr) != 0) {
+            reply(r, "ERR watch <r|w|rw> <addr>\n");
+            return 0;
+        }
+        debugger_set_point(dbg, (uint16_t)addr, point, true);
+        reply(r, "OK\n");
+    }
+    else if (strcmp(argv[0], "unwatch") == 0) {
+        if (argc != 2 || parse_hex(argv[1], MEMORY_SIZE - 1, &addr) != 0) {
+            reply(r, "ERR unwatch <addr>\n");
+            return 0;
+        }
+        debugger_set_point(dbg, (uint16_t)addr, DEBUG_WATCH_READ | DEBUG_WATCH_WRITE, false);
+        reply(r, "OK\n");
+    }
+    else if (strcmp(argv[0], "uncond") == 0) {
+        dbg->condition_count = 0;
+        reply(r, "OK\n");
+    }
+    else if (strcmp(argv[0], "regs") == 0) {
+        reply_regs(r, system);
+    }
+    else if (strcmp(argv[0], "set") == 0) {
+        if (argc != 3) {
+            reply(r, "ERR set <register> <value>\n");
+            return 0;
+        }
+        return set_register(r, system, argv[1], argv[2]);
+    }
+    else if (strcmp(argv[0], "read") == 0) {
+        if (parse_range(r, argc, argv, &addr, &len) != 0) {
+            return 0;
+        }
+        reply(r, "OK ");
+        for (i = 0; i < len; i++) {
+            byte = system->memory[(addr + i) & (MEMORY_SIZE - 1)];
+            reply(r, "%c%c", hex[byte >> 4], hex[byte & 0xF]);
+        }
+        reply(r, "\n");
+    }
+    else if (strcmp(argv[0], "write") == 0) {
+        return write_memory(r, system, argc, argv);
+    }
+    else if (strcmp(argv[0], "dump") == 0) {
+        addr = 0;
+        len = MEMORY_SIZE;
+        if (argc != 1 && parse_range(r, argc, argv, &addr, &len) != 0) {
+            return 0;
+        }
+        reply(r, "DATA %lX\n", len);
+        if (addr + len <= MEMORY_SIZE) {
+            reply_bytes(r, system->memory + addr, len);
+        }
+        else {
+            reply_bytes(r, system->memory + addr, MEMORY_SIZE - addr);
+            reply_bytes(r, system->memory, addr + len - MEMORY_SIZE);
+        }
+    }
+    else {
+        reply(r, "ERR UNKNOWN REQUEST %s\n", argv[0]);
+    }
+    return 0;
+}
+
+/* A client that left can not resume the system, so the selected core takes over again */
+static int drop_client(Remote_t *r, Debugger_t *dbg) {
+    close(r->client_fd);
+    r->client_fd = -1;
+    printf("Debug client disconnected\n");
+    if (dbg->active) {
+        dbg->active = false;
+        return 1;
+    }
+    return 0;
+}
+
+int remote_open(Remote_t *r, const char *path) {
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    r->listen_fd = -1;
+    r->client_fd = -1;
+    r->in_len = 0;
+    r->out_len = 0;
+    r->overlong = false;
+    r->running = false;
+    r->stopped = false;
+    if (strlen(path) >= sizeof(r->path) || strlen(path) >= sizeof(addr.sun_path)) {
+        return -2;
+    }
+
+    /* A socket left behind by an earlier run is replaced, any other file is not */
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0 || set_nonblocking(fd) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    r->listen_fd = fd;
+    strcpy(r->path, path);
+    return 0;
+}
+
+bool remote_connected(const Remote_t *r) {
+    return r->client_fd >= 0;
+}
+
+/*
+Serve the client between two frames
+    - Accepts a waiting client, reports a stop of the instrumented core since the last poll, then reads once and handles every complete line
+    - A request is only handled while out has room for its reply, the rest stays in for the next frame, so a client that does not read only slows itself
+    - Returns 1 when memory or pc was changed or the debugger detached, code cached by the jit and aot cores has to be dropped then
+*/
+int remote_poll(Remote_t *r, Debugger_t *dbg, Chip8_t *system) {
+    ssize_t n;
+    char *nl;
+    size_t used;
+    int fd, changed = 0;
+
+    if (r->listen_fd < 0) {
+        return 0;
+    }
+    if (r->client_fd < 0) {
+        fd = accept(r->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return 0;
+        }
+        if (set_nonblocking(fd) != 0) {
+            close(fd);
+            return 0;
+        }
+        r->client_fd = fd;
+        r->in_len = 0;
+        r->out_len = 0;
+        r->overlong = false;
+        r->running = dbg->active && dbg->run;
+        r->stopped = false;
+        printf("Debug client connected\n");
+    }
+
+    if (flush(r) != 0) {
+        return drop_client(r, dbg);
+    }
+    if (r->running && !(dbg->active && dbg->run)) {
+        r->stopped = true;
+    }
+    if (r->stopped && sizeof(r->out) - r->out_len >= REMOTE_REPLY_MAX) {
+        reply(r, "STOP %s %03" PRIX16 " %03" PRIX16 "\n", stop_names[dbg->stop], system->pc & (MEMORY_SIZE - 1), dbg->stop_addr);
+        r->stopped = false;
+    }
+
+    if (r->in_len < sizeof(r->in)) {
+        n = recv(r->client_fd, r->in + r->in_len, sizeof(r->in) - r->in_len, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return drop_client(r, dbg);
+        }
+        if (n > 0) {
+            r->in_len += n;
+        }
+    }
+
+    while (sizeof(r->out) - r->out_len >= REMOTE_REPLY_MAX && (nl = memchr(r->in, '\n', r->in_len))) {
+        *nl = '\0';
+        used = nl - r->in + 1;
+        if (r->overlong) {
+            r->overlong = false;
+        }
+        else {
+            changed |= handle(r, dbg, system, r->in);
+        }
+        memmove(r->in, r->in + used, r->in_len - used);
+        r->in_len -= used;
+    }
+    if (r->in_len == sizeof(r->in) && !memchr(r->in, '\n', r->in_len)) {
+        reply(r, "ERR REQUEST TOO LONG\n");
+        r->overlong = true;
+        r->in_len = 0;
+    }
+
+    r->running = dbg->active && dbg->run;
+    if (flush(r) != 0) {
+        return drop_client(r, dbg) | changed;
+    }
+    return changed;
+}
+
+void remote_close(Remote_t *r) {
+    if (r->client_fd >= 0) {
+        close(r->client_fd);
+        r->client_fd = -1;
+    }
+    if (r->listen_fd >= 0) {
+        close(r->listen_fd);
+        r->listen_fd = -1;
+        unlink(r->path);
+    }
+    return;
+}
\ No newline at end of file
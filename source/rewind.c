@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "rewind.h"
+#include "state.h"
+
+/*
+Run length encode zeros
+    - Tokens are <zeros u16> <literals u16> <literal bytes>
+    - A literal run only ends at 4 zeros or more, so a token never costs more than the zeros it replaces
+*/
+static size_t encode(const uint8_t *src, size_t len, uint8_t *out) {
+    size_t i = 0, o = 0, zeros, start, run;
+
+    while (i < len) {
+        start = i;
+        while (i < len && src[i] == 0) i++;
+        zeros = i - start;
+
+        start = i;
+        while (i < len) {
+            for (run = 0; i + run < len && run < 4 && src[i + run] == 0; run++);
+            if (run == 4 || (run > 0 && i + run == len)) break;
+            i += run ? run : 1;
+        }
+
+        out[o++] = zeros & 0xFF;
+        out[o++] = zeros >> 8;
+        out[o++] = (i - start) & 0xFF;
+        out[o++] = (i - start) >> 8;
+        memcpy(out + o, src + start, i - start);
+        o += i - start;
+    }
+    return o;
+}
+
+/* Decode into out, XORed onto what is already there for a delta */
+static void decode(const uint8_t *in, size_t len, uint8_t *out, int delta) {
+    const uint8_t *end = in + len;
+    size_t o = 0, zeros, literals, i;
+
+    while (in < end) {
+        zeros = in[0] | in[1] << 8;
+        literals = in[2] | in[3] << 8;
+        in += 4;
+        if (!delta) {
+            memset(out + o, 0, zeros);
+        }
+        o += zeros;
+        for (i = 0; i < literals; i++) {
+            if (delta) out[o + i] ^= in[i];
+            else out[o + i] = in[i];
+        }
+        o += literals;
+        in += literals;
+    }
+    return;
+}
+
+static inline Rewind_Entry *entry(Rewind_t *rw, size_t n) {
+    return &rw->entries[(rw->first + n) % REWIND_MAX_ENTRIES];
+}
+
+static void drop_oldest(Rewind_t *rw) {
+    rw->used -= entry(rw, 0)->len;
+    rw->first = (rw->first + 1) % REWIND_MAX_ENTRIES;
+    rw->count--;
+    return;
+}
+
+/*
+Find room for len bytes in the pool
+    - Writes go forward and wrap to the start when the end of the pool is reached
+    - The oldest entries are in the way, they are dropped, then deltas left without their keyframe
+*/
+static size_t reserve(Rewind_t *rw, size_t len) {
+    size_t pos = rw->head;
+    Rewind_Entry *e;
+
+    if (pos + len > REWIND_POOL_SIZE) {
+        while (rw->count > 0 && entry(rw, 0)->offset >= rw->head) {
+            drop_oldest(rw);
+        }
+        pos = 0;
+    }
+    while (rw->count > 0) {
+        e = entry(rw, 0);
+        if (rw->count < REWIND_MAX_ENTRIES && (e->offset >= pos + len || e->offset + e->len <= pos)) {
+            break;
+        }
+        drop_oldest(rw);
+    }
+    while (rw->count > 0 && !entry(rw, 0)->keyframe) {
+        drop_oldest(rw);
+    }
+    if (rw->key_serial < rw->pushed - rw->count) {
+        rw->key_valid = 0;
+    }
+    return pos;
+}
+
+int rewind_init(Rewind_t *rw) {
+    rw->pool = malloc(REWIND_POOL_SIZE);
+    rw->entries = malloc(REWIND_MAX_ENTRIES * sizeof(Rewind_Entry));
+    if (!rw->pool || !rw->entries) {
+        rewind_cleanup(rw);
+        return -3;
+    }
+    rewind_clear(rw);
+    return 0;
+}
+
+void rewind_clear(Rewind_t *rw) {
+    rw->head = 0;
+    rw->used = 0;
+    rw->first = 0;
+    rw->count = 0;
+    rw->pushed = 0;
+    rw->key_serial = 0;
+    rw->key_valid = 0;
+    rw->since_key = 0;
+    return;
+}
+
+/* Store the state at the end of a frame */
+void rewind_push(Rewind_t *rw, const Chip8_t *system) {
+    uint8_t delta[STATE_BODY_SIZE];
+    int keyframe, i;
+    size_t len, pos;
+    Rewind_Entry *e;
+
+    state_pack(system, rw->body);
+    keyframe = !rw->key_valid || rw->since_key >= REWIND_KEYFRAME_INTERVAL - 1;
+
+    for (;;) {
+        if (keyframe) {
+            len = encode(rw->body, STATE_BODY_SIZE, rw->encoded);
+        }
+        else {
+            for (i = 0; i < STATE_BODY_SIZE; i++) {
+                delta[i] = rw->body[i] ^ rw->key[i];
+            }
+            len = encode(delta, STATE_BODY_SIZE, rw->encoded);
+        }
+        pos = reserve(rw, len);
+
+        /* Making room dropped the keyframe this delta is against */
+        if (!keyframe && !rw->key_valid) {
+            keyframe = 1;
+            continue;
+        }
+        break;
+    }
+
+    memcpy(rw->pool + pos, rw->encoded, len);
+    e = entry(rw, rw->count);
+    e->offset = (uint32_t)pos;
+    e->len = (uint32_t)len;
+    e->keyframe = keyframe;
+    rw->count++;
+    rw->used += len;
+    rw->head = pos + len;
+    rw->pushed++;
+
+    if (keyframe) {
+        memcpy(rw->key, rw->body, STATE_BODY_SIZE);
+        rw->key_serial = rw->pushed - 1;
+        rw->key_valid = 1;
+        rw->since_key = 0;
+    }
+    else {
+        rw->since_key++;
+    }
+    return;
+}
+
+/*
+Go back one frame
+    - The newest entry is dropped and the one before it restored, the oldest one is kept
+    - Restoring decodes at most one keyframe and one delta
+    - -1 if there is no history
+*/
+int rewind_step(Rewind_t *rw, Chip8_t *system) {
+    Rewind_Entry *e, *k;
+    uint8_t keys[NUM_KEYS];
+    size_t n;
+
+    if (rw->count == 0) {
+        return -1;
+    }
+    if (rw->count > 1) {
+        e = entry(rw, rw->count - 1);
+        rw->head = e->offset;
+        rw->used -= e->len;
+        rw->count--;
+        rw->pushed--;
+    }
+
+    e = entry(rw, rw->count - 1);
+    for (n = rw->count - 1; !entry(rw, n)->keyframe; n--);
+    k = entry(rw, n);
+
+    decode(rw->pool + k->offset, k->len, rw->key, 0);
+    memcpy(rw->body, rw->key, STATE_BODY_SIZE);
+    if (e != k) {
+        decode(rw->pool + e->offset, e->len, rw->body, 1);
+    }
+    /* The keypad is live input, it is not rewound */
+    memcpy(keys, system->key, NUM_KEYS);
+    state_unpack(system, rw->body);
+    memcpy(system->key, keys, NUM_KEYS);
+
+    rw->key_serial = rw->pushed - rw->count + n;
+    rw->key_valid = 1;
+    rw->since_key = (int)(rw->count - 1 - n);
+    return 0;
+}
+
+/* Bytes of the pool holding history */
+size_t rewind_usage(const Rewind_t *rw) {
+    return rw->used;
+}
+
+void rewind_cleanup(Rewind_t *rw) {
+    free(rw->pool);
+    free(rw->entries);
+    rw->pool = NULL;
+    rw->entries = NULL;
+    return;
+}
\ No newline at end of file
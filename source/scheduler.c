@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "chip8.h"
+#include "scheduler.h"
+
+#define NS_PER_SECOND 1000000000ULL
+#define FRAME_NS (NS_PER_SECOND / CLOCK_FREQUENCY)
+
+uint64_t scheduler_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+}
+
+/* End of the frame being run, exact to the nanosecond however many frames passed */
+static uint64_t deadline(const Scheduler_t *s) {
+    return s->origin + (s->frame + 1) * NS_PER_SECOND / CLOCK_FREQUENCY;
+}
+
+/* Start of the frame being run */
+static uint64_t frame_start(const Scheduler_t *s) {
+    return s->origin + s->frame * NS_PER_SECOND / CLOCK_FREQUENCY;
+}
+
+void scheduler_init(Scheduler_t *s, uint64_t ips) {
+    memset(s, 0, sizeof(*s));
+    s->ips = ips;
+    ipf_init(&s->ipf, ips);
+    s->min = UINT64_MAX;
+    scheduler_resync(s);
+    return;
+}
+
+/* Count the deadlines from now on, the next frame time is not measured. Call it after the emulation stood still. */
+void scheduler_resync(Scheduler_t *s) {
+    s->origin = scheduler_now();
+    s->frame = 0;
+    s->last = 0;
+    return;
+}
+
+/* Instructions to run this frame, with unlimited IPS a chunk to run before asking scheduler_due() again */
+int scheduler_budget(Scheduler_t *s) {
+    if (s->ips == IPS_UNLIMITED) {
+        return SCHEDULER_CHUNK;
+    }
+    return ipf_next(&s->ipf);
+}
+
+int scheduler_due(const Scheduler_t *s) {
+    return scheduler_now() >= deadline(s);
+}
+
+/* Sleep without spinning, the wake up may come late by the timer slack of the host */
+void scheduler_sleep_until(uint64_t target) {
+    struct timespec ts;
+    uint64_t now = scheduler_now();
+
+    if (target > now) {
+        ts.tv_sec = (target - now) / NS_PER_SECOND;
+        ts.tv_nsec = (target - now) % NS_PER_SECOND;
+        nanosleep(&ts, NULL);
+    }
+    return;
+}
+
+/* Wait for the end of the frame and start the next one */
+void scheduler_wait(Scheduler_t *s) {
+    uint64_t target = deadline(s), now = scheduler_now(), interval;
+    double delta;
+
+    if (now > target + SCHEDULER_SPIN_NS) {
+        s->late++;
+    }
+    else if (target - now > SCHEDULER_SPIN_NS) {
+        scheduler_sleep_until(target - SCHEDULER_SPIN_NS);
+    }
+    while ((now = scheduler_now()) < target) {
+        /* SPIN */
+    }
+    s->frame++;
+
+    if (s->last) {
+        interval = now - s->last;
+        s->intervals++;
+        delta = interval - s->mean;
+        s->mean += delta / s->intervals;
+        s->m2 += delta * (interval - s->mean);
+        if (interval < s->min) s->min = interval;
+        if (interval > s->max) s->max = interval;
+    }
+    s->last = now;
+
+    /* Running several frames back to back to catch up would only make the ROM stutter */
+    if (now - target > SCHEDULER_MAX_LAG * FRAME_NS) {
+        s->origin = now;
+        s->frame = 0;
+        s->resyncs++;
+    }
+    return;
+}
+
+/* Time at which instruction done of a frame of budget instructions is due when the frame is spread over its period */
+uint64_t scheduler_slot(const Scheduler_t *s, int done, int budget) {
+    uint64_t start = frame_start(s);
+
+    if (budget <= 0) {
+        return start;
+    }
+    return start + (uint64_t)done * (deadline(s) - start) / (uint64_t)budget;
+}
+
+/*
+Instruction of this frame that stands for the time t, the frame replays the period before it started
+    - The instructions of a frame run in a burst at its start, so what happened during the previous period is all they can see
+    - Earlier times give 0, times in the current period give budget, those belong to the next frame
+*/
+int scheduler_index(const Scheduler_t *s, uint64_t t, int budget) {
+    uint64_t start = frame_start(s), period = deadline(s) - start;
+
+    if (t >= start) {
+        return budget;
+    }
+    if (start - t >= period) {
+        return 0;
+    }
+    return (int)((t - (start - period)) * budget / period);
+}
+
+void scheduler_report(const Scheduler_t *s, FILE *fp) {
+    double jitter = s->intervals > 1 ? sqrt(s->m2 / (s->intervals - 1)) : 0;
+
+    if (!s->intervals) {
+        return;
+    }
+    fprintf(fp, "FRAME TIME: mean %.3f ms, jitter %.3f ms, min %.3f ms, max %.3f ms\n", s->mean / 1e6, jitter / 1e6, s->min / 1e6, s->max / 1e6);
+    fprintf(fp, "LATE FRAMES: %" PRIu64 ", RESYNCS: %" PRIu64 "\n", s->late, s->resyncs);
+    return;
+}
\ No newline at end of file
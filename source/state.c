@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "state.h"
+
+static inline uint8_t *put16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static inline uint8_t *put32(uint8_t *p, uint32_t v) {
+    p = put16(p, v & 0xFFFF);
+    return put16(p, v >> 16);
+}
+
+static inline uint8_t *put64(uint8_t *p, uint64_t v) {
+    p = put32(p, v & 0xFFFFFFFF);
+    return put32(p, v >> 32);
+}
+
+static inline uint16_t get16(const uint8_t **p) {
+    uint16_t v = (*p)[0] | (*p)[1] << 8;
+    *p += 2;
+    return v;
+}
+
+static inline uint32_t get32(const uint8_t **p) {
+    uint32_t lo = get16(p);
+    return lo | (uint32_t)get16(p) << 16;
+}
+
+static inline uint64_t get64(const uint8_t **p) {
+    uint64_t lo = get32(p);
+    return lo | (uint64_t)get32(p) << 32;
+}
+
+void state_pack(const Chip8_t *system, uint8_t *body) {
+    uint8_t *p = body;
+    int i;
+
+    p = put16(p, system->opcode);
+    p = put16(p, system->I);
+    p = put16(p, system->pc);
+    *p++ = system->delay_timer;
+    *p++ = system->sound_timer;
+    p = put16(p, system->sp);
+
+    memcpy(p, system->V, REGISTER_COUNT);
+    p += REGISTER_COUNT;
+    memcpy(p, system->key, NUM_KEYS);
+    p += NUM_KEYS;
+    memcpy(p, system->memory, MEMORY_SIZE);
+    p += MEMORY_SIZE;
+
+    for (i = 0; i < DISPLAY_MAX_WORDS; i++) {
+        p = put64(p, system->gfx[i]);
+    }
+    for (i = 0; i < STACK_SIZE; i++) {
+        p = put16(p, system->stack[i]);
+    }
+    p = put32(p, system->rng);
+    *p++ = system->quirks.clip;
+    *p++ = system->width == DISPLAY_HIRES_WIDTH;
+    memcpy(p, system->rpl, RPL_COUNT);
+    return;
+}
+
+/* Version 1 bodies hold the 32 rows of the low resolution screen and nothing of SUPER-CHIP */
+static void unpack(Chip8_t *system, const uint8_t *body, int version) {
+    const uint8_t *p = body;
+    int i, words = version == 1 ? DISPLAY_HEIGHT : DISPLAY_MAX_WORDS, hires = 0;
+
+    system->opcode = get16(&p);
+    system->I = get16(&p);
+    system->pc = get16(&p);
+    system->delay_timer = *p++;
+    system->sound_timer = *p++;
+    system->sp = get16(&p);
+
+    memcpy(system->V, p, REGISTER_COUNT);
+    p += REGISTER_COUNT;
+    memcpy(system->key, p, NUM_KEYS);
+    p += NUM_KEYS;
+    memcpy(system->memory, p, MEMORY_SIZE);
+    p += MEMORY_SIZE;
+
+    memset(system->gfx, 0, sizeof(system->gfx));
+    for (i = 0; i < words; i++) {
+        system->gfx[i] = get64(&p);
+    }
+    for (i = 0; i < STACK_SIZE; i++) {
+        system->stack[i] = get16(&p);
+    }
+    system->rng = get32(&p);
+    system->quirks.clip = *p++ & 1;
+
+    memset(system->rpl, 0, RPL_COUNT);
+    if (version > 1) {
+        hires = *p++ & 1;
+        memcpy(system->rpl, p, RPL_COUNT);
+    }
+    system->width = hires ? DISPLAY_HIRES_WIDTH : DISPLAY_WIDTH;
+    system->height = hires ? DISPLAY_HIRES_HEIGHT : DISPLAY_HEIGHT;
+
+    system->dirty = DISPLAY_ALL_ROWS;
+    system->EMU_flags.draw_to_screen = 1;
+    chip8_predecode(system);
+    return;
+}
+
+/* The body must be valid, chip8_predecode() is run afterwards since memory changed */
+void state_unpack(Chip8_t *system, const uint8_t *body) {
+    unpack(system, body, STATE_VERSION);
+    return;
+}
+
+/* Write the header and body to buf, which holds at least STATE_SIZE bytes */
+size_t state_serialize(const Chip8_t *system, uint8_t *buf) {
+    uint8_t *p = buf;
+
+    memcpy(p, STATE_MAGIC, 4);
+    p = put16(p + 4, STATE_VERSION);
+    put16(p, STATE_BODY_SIZE);
+    state_pack(system, buf + STATE_HEADER_SIZE);
+    return STATE_SIZE;
+}
+
+/*
+Restore a serialized state, the system is left untouched on failure
+    - -2 if it is not a state or it is truncated
+    - -4 if it was written by another version
+    - Version 1 states load into the low resolution
+*/
+int state_deserialize(Chip8_t *system, const uint8_t *buf, size_t len) {
+    const uint8_t *p = buf + 4;
+    int version;
+    size_t body;
+
+    if (len < STATE_HEADER_SIZE || memcmp(buf, STATE_MAGIC, 4) != 0) {
+        return -2;
+    }
+    version = get16(&p);
+    if (version != STATE_VERSION && version != 1) {
+        return -4;
+    }
+    body = version == 1 ? STATE_BODY_SIZE_V1 : STATE_BODY_SIZE;
+    if (get16(&p) != body || len != STATE_HEADER_SIZE + body) {
+        return -2;
+    }
+    unpack(system, buf + STATE_HEADER_SIZE, version);
+    return 0;
+}
+
+int state_save(const Chip8_t *system, const char *path) {
+    uint8_t buf[STATE_SIZE];
+    size_t len;
+    FILE *fp;
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        return -1;
+    }
+    len = state_serialize(system, buf);
+    if (fwrite(buf, 1, len, fp) != len) {
+        fclose(fp);
+        return -3;
+    }
+    if (fclose(fp) != 0) {
+        return -3;
+    }
+    return 0;
+}
+
+/* Same return values as state_deserialize(), -1 if the file can not be opened and -3 if reading fails */
+int state_load(Chip8_t *system, const char *path) {
+    uint8_t buf[STATE_SIZE + 1];
+    size_t len;
+    FILE *fp;
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+    len = fread(buf, 1, sizeof(buf), fp);
+    if (ferror(fp)) {
+        fclose(fp);
+        return -3;
+    }
+    fclose(fp);
+    return state_deserialize(system, buf, len);
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include <string.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+#include "sync.h"
+
+void triple_init(Triple_Buffer *tb) {
+    memset(tb->slots, 0, sizeof(tb->slots));
+    tb->back = 0;
+    tb->seq = 0;
+    atomic_init(&tb->shared, 1);
+    tb->front = 2;
+    return;
+}
+
+/* The slot the writer fills next, it is never seen by the reader until published */
+Frame_t *triple_back(Triple_Buffer *tb) {
+    return &tb->slots[tb->back];
+}
+
+void triple_publish(Triple_Buffer *tb) {
+    tb->slots[tb->back].seq = ++tb->seq;
+    tb->back = atomic_exchange_explicit(&tb->shared, tb->back | TRIPLE_FRESH, memory_order_acq_rel) & (TRIPLE_FRESH - 1);
+    return;
+}
+
+/* The newest published frame, or NULL if nothing was published since the last call */
+const Frame_t *triple_acquire(Triple_Buffer *tb) {
+    if (!(atomic_load_explicit(&tb->shared, memory_order_relaxed) & TRIPLE_FRESH)) {
+        return NULL;
+    }
+    tb->front = atomic_exchange_explicit(&tb->shared, tb->front, memory_order_acq_rel) & (TRIPLE_FRESH - 1);
+    return &tb->slots[tb->front];
+}
+
+void queue_init(Event_Queue *q) {
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return;
+}
+
+int queue_push(Event_Queue *q, const Host_Event *ev) {
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    if (head - atomic_load_explicit(&q->tail, memory_order_acquire) == EVENT_QUEUE_SIZE) {
+        return -1;
+    }
+    q->events[head & (EVENT_QUEUE_SIZE - 1)] = *ev;
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return 0;
+}
+
+/* 0 when an event was taken, -1 when the queue is empty */
+int queue_pop(Event_Queue *q, Host_Event *ev) {
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    if (atomic_load_explicit(&q->head, memory_order_acquire) == tail) {
+        return -1;
+    }
+    *ev = q->events[tail & (EVENT_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+/* 0 when an event is waiting, it stays in the queue, -1 when the queue is empty */
+int queue_peek(Event_Queue *q, Host_Event *ev) {
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    if (atomic_load_explicit(&q->head, memory_order_acquire) == tail) {
+        return -1;
+    }
+    *ev = q->events[tail & (EVENT_QUEUE_SIZE - 1)];
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "state.h"
+#include "trace.h"
+
+static Trace_t *caught;
+
+/* The keypad as a mask, bit k is set while key k is down */
+static uint16_t keypad(const Chip8_t *system) {
+    uint16_t keys = 0;
+    int k;
+
+    for (k = 0; k < NUM_KEYS; k++) {
+        if (system->key[k]) {
+            keys |= 1 << k;
+        }
+    }
+    return keys;
+}
+
+/* Take a checkpoint in slot, it is only marked valid once the state is whole so a signal never writes half of it */
+static void start_epoch(Trace_t *trace, const Chip8_t *system, int slot) {
+    Trace_Epoch *epoch = &trace->epochs[slot];
+
+    epoch->valid = 0;
+    atomic_signal_fence(memory_order_seq_cst);
+    state_pack(system, epoch->state);
+    epoch->at = trace->total;
+    epoch->event_count = 0;
+    atomic_signal_fence(memory_order_seq_cst);
+    epoch->valid = 1;
+    trace->newest = slot;
+
+    trace->keys = keypad(system);
+    trace->delay = system->delay_timer;
+    trace->sound = system->sound_timer;
+    return;
+}
+
+int trace_init(Trace_t *trace, const char *path, const Chip8_t *system) {
+    if (strlen(path) >= sizeof(trace->path)) {
+        return -2;
+    }
+    trace->epochs[0].valid = 0;
+    trace->epochs[1].valid = 0;
+    trace->total = 0;
+    trace->window = 0;
+    trace->rom_hash = system->rom_hash;
+    trace->dumped = 0;
+    strcpy(trace->path, path);
+    start_epoch(trace, system, 0);
+    return 0;
+}
+
+/*
+The state was replaced from outside the ROM, by a restart, a state load, rewinding or the debugger
+    - The instructions before it stay in the older checkpoint, the decoder marks where the state changed
+    - A newer checkpoint nothing ran from yet is taken again instead, so the older one is not lost
+*/
+void trace_checkpoint(Trace_t *trace, const Chip8_t *system) {
+    int slot = trace->newest;
+
+    if (trace->total != trace->epochs[slot].at) {
+        slot ^= 1;
+    }
+    start_epoch(trace, system, slot);
+    return;
+}
+
+/*
+Called before a core runs budget instructions
+    - The keypad and timers only change between runs, a change since the last one is noted at the instruction it applies to
+    - budget is published so a signal during the run knows how far it may have got
+*/
+void trace_begin(Trace_t *trace, const Chip8_t *system, int budget) {
+    Trace_Epoch *epoch = &trace->epochs[trace->newest];
+    Trace_Event *event;
+    uint16_t keys = keypad(system);
+
+    if (trace->total - epoch->at >= TRACE_SIZE || epoch->event_count == TRACE_EVENTS) {
+        start_epoch(trace, system, trace->newest ^ 1);
+    }
+    else if (keys != trace->keys || system->delay_timer != trace->delay || system->sound_timer != trace->sound) {
+        event = &epoch->events[epoch->event_count];
+        event->offset = (uint32_t)(trace->total - epoch->at);
+        event->keys = keys;
+        event->delay = system->delay_timer;
+        event->sound = system->sound_timer;
+        atomic_signal_fence(memory_order_seq_cst);
+        epoch->event_count++;
+
+        trace->keys = keys;
+        trace->delay = system->delay_timer;
+        trace->sound = system->sound_timer;
+    }
+    trace->window = budget;
+    return;
+}
+
+static int write_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+Write the checkpoints and their events to trace->path, the oldest first
+    - Only open(), write() and close() are used, so a signal handler can call it
+    - A checkpoint that is being taken is left out, the events of the other are whole since they are counted after they are written
+*/
+int trace_dump(const Trace_t *trace, int reason, int sig) {
+    Trace_Header header;
+    Trace_Epoch_Header eh;
+    const Trace_Epoch *epochs[2];
+    const Trace_Epoch *newer = &trace->epochs[trace->newest];
+    const Trace_Epoch *older = &trace->epochs[trace->newest ^ 1];
+    int count = 0, fd, ret, i;
+
+    if (older->valid && (!newer->valid || older->at < newer->at)) {
+        epochs[count++] = older;
+    }
+    if (newer->valid) {
+        epochs[count++] = newer;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.version = TRACE_VERSION;
+    header.order = TRACE_ORDER;
+    header.reason = (uint8_t)reason;
+    header.signal = (uint8_t)sig;
+    header.epochs = (uint16_t)count;
+    header.state_size = STATE_BODY_SIZE;
+    header.event_size = sizeof(Trace_Event);
+    header.rom_hash = trace->rom_hash;
+    header.total = trace->total;
+    header.window = (uint64_t)trace->window;
+
+    fd = open(trace->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    ret = write_all(fd, &header, sizeof(header));
+    for (i = 0; i < count && ret == 0; i++) {
+        eh.at = epochs[i]->at;
+        eh.events = epochs[i]->event_count;
+        eh.reserved = 0;
+        ret = write_all(fd, &eh, sizeof(eh));
+        if (ret == 0) {
+            ret = write_all(fd, epochs[i]->state, STATE_BODY_SIZE);
+        }
+        if (ret == 0) {
+            ret = write_all(fd, epochs[i]->events, eh.events * sizeof(Trace_Event));
+        }
+    }
+    close(fd);
+    return ret;
+}
+
+/*
+The ROM stopped on an invalid opcode or left the stack range during the last run, kept out of line like invalid_opcode()
+    - The decoder finds the instruction that did it by replaying, here only the kind of fault is known
+    - The trace is written once, at the first fault, the instructions leading up to it are what matters
+*/
+__attribute__((noinline, cold)) static void trace_fault(Trace_t *trace, const Chip8_t *system) {
+    uint16_t pc = (system->pc - sizeof(uint16_t)) & (MEMORY_SIZE - 1);
+    int reason;
+
+    if (system->EMU_flags.exit && chip8_invalid(&system->decoded[pc])) {
+        reason = TRACE_INVALID;
+    }
+    else if (system->sp > STACK_SIZE) {
+        reason = (system->sp & 0x8000) ? TRACE_UNDERFLOW : TRACE_OVERFLOW;
+    }
+    else {
+        return;
+    }
+
+    trace->dumped = 1;
+    if (trace_dump(trace, reason, 0) != 0) {
+        fprintf(stderr, "FAILED TO WRITE THE TRACE TO %s!\n", trace->path);
+    }
+    else if (reason == TRACE_INVALID) {
+        fprintf(stderr, "INVALID OPCODE AT %03X, TRACE WRITTEN TO %s\n", pc, trace->path);
+    }
+    else {
+        fprintf(stderr, "STACK %s, TRACE WRITTEN TO %s\n", reason == TRACE_OVERFLOW ? "OVERFLOW" : "UNDERFLOW", trace->path);
+    }
+    return;
+}
+
+/*
+Called after a core ran, with the instructions it executed
+    - What the keypad and timers are now is what the next trace_begin() compares against
+    - A stack that is out of range when the run ends is caught, one that left and came back within a run is only seen by the decoder
+*/
+void trace_end(Trace_t *trace, const Chip8_t *system, int executed) {
+    trace->total += (uint64_t)executed;
+    trace->window = 0;
+    trace->keys = keypad(system);
+    trace->delay = system->delay_timer;
+    trace->sound = system->sound_timer;
+
+    if (__builtin_expect((system->sp > STACK_SIZE || system->EMU_flags.exit) && !trace->dumped, 0)) {
+        trace_fault(trace, system);
+    }
+    return;
+}
+
+/* Write the trace and die as the signal would have, SIGUSR1 only writes it */
+static void on_signal(int sig) {
+    if (caught) {
+        trace_dump(caught, TRACE_SIGNAL, sig);
+    }
+    if (sig != SIGUSR1) {
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+    return;
+}
+
+/* Write the trace when the emulator crashes or receives SIGUSR1 */
+void trace_catch_signals(Trace_t *trace) {
+    caught = trace;
+    signal(SIGSEGV, on_signal);
+    signal(SIGBUS, on_signal);
+    signal(SIGILL, on_signal);
+    signal(SIGFPE, on_signal);
+    signal(SIGABRT, on_signal);
+    signal(SIGUSR1, on_signal);
+    return;
+}
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 
+#include "catalog.h"
 #include "chip8.h"
 #include "utils.h"
 
@@ -27,5 +31,42 @@ int load_rom(Chip8_t *system, const char *path) {
     }
 
     fclose(fp);
+    system->rom_hash = catalog_hash(system->memory + PROGRAM_START, len);
+    chip8_predecode(system);
+    return 0;
+}
+
+/* Map a core name from the command line to the core */
+int parse_core(const char *name, Chip8_Core *core) {
+    if (strcmp(name, "interpreter") == 0) {
+        *core = CORE_INTERPRETER;
+    }
+    else if (strcmp(name, "jit") == 0) {
+        *core = CORE_JIT;
+    }
+    else if (strcmp(name, "threaded") == 0) {
+        *core = CORE_THREADED;
+    }
+    else {
+        return -1;
+    }
+    return 0;
+}
+
+/* Parse a whole decimal number from the command line, -1 when anything else is in s or it does not fit, strtoull() would take a sign and negate */
+int str_to_u64(const char *s, uint64_t *out) {
+    unsigned long long l;
+    char *end = NULL;
+    errno = 0;
+
+    if (s[0] == '-' || s[0] == '+') {
+        return -1;
+    }
+    l = strtoull(s, &end, 10);
+    if (errno != 0 || end == s || *end != '\0') {
+        return -1;
+    }
+    *out = (uint64_t)l;
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,604 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "aot.h"
+#include "catalog.h"
+#include "chip8.h"
+
+/* Instructions in one block at most, a longer run is split in two */
+#define AOT_MAX_BLOCK 32
+
+/* How an instruction leaves, decides the successors the disassembly follows */
+typedef enum {
+    FLOW_NEXT,
+    FLOW_FALLBACK,
+    FLOW_JUMP,
+    FLOW_CALL,
+    FLOW_RETURN,
+    FLOW_SKIP,
+    FLOW_INDIRECT,
+    FLOW_STOP
+} Flow_t;
+
+typedef struct {
+    uint8_t memory[MEMORY_SIZE];
+    uint32_t end;
+    uint8_t reached[MEMORY_SIZE];
+    uint8_t leader[MEMORY_SIZE];
+    uint16_t block_end[MEMORY_SIZE];
+    uint16_t block_count[MEMORY_SIZE];
+    uint32_t blocks;
+    uint32_t instructions;
+    uint32_t fallbacks;
+} Aot_Rom;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "%s [-o output.c] <rom>\n", prog);
+    fprintf(stderr, "  -o <path>    Where to write the C source (default stdout)\n");
+    fprintf(stderr, "Compile the source into a library and run it with chip8-emu --aot <library>:\n");
+    fprintf(stderr, "  cc -O3 -shared -fPIC -Iinclude -o rom.so rom.c\n");
+    return;
+}
+
+static int read_rom(Aot_Rom *rom, const char *path, uint64_t *hash) {
+    FILE *fp = fopen(path, "rb");
+    size_t len;
+
+    if (!fp) {
+        return -1;
+    }
+    len = fread(rom->memory + PROGRAM_START, 1, MEMORY_SIZE - PROGRAM_START + 1, fp);
+    fclose(fp);
+    if (len == 0 || len > MEMORY_SIZE - PROGRAM_START || len % sizeof(uint16_t) != 0) {
+        return -2;
+    }
+    rom->end = PROGRAM_START + len;
+    *hash = catalog_hash(rom->memory + PROGRAM_START, len);
+    return 0;
+}
+
+static uint16_t fetch(const Aot_Rom *rom, uint32_t addr) {
+    return rom->memory[addr] << 8 | rom->memory[addr + 1];
+}
+
+/* An instruction is translated only when both of its bytes are part of the ROM */
+static int in_rom(const Aot_Rom *rom, uint32_t addr) {
+    return addr >= PROGRAM_START && addr + sizeof(uint16_t) <= rom->end;
+}
+
+/*
+The flow of an instruction, as decode_opcode() in chip8.c decodes it
+    - FLOW_FALLBACK runs on the interpreter inside a block and the block goes on after it
+    - FLOW_STOP is an instruction that ends the run, 00FD and everything the interpreter does not know
+*/
+static Flow_t classify(uint16_t opcode) {
+    switch (opcode & 0xF000) {
+        case 0x0000:
+            if ((opcode & 0x00F0) == 0x00C0) {
+                return FLOW_FALLBACK;
+            }
+            switch (opcode & 0x00FF) {
+                case 0x00E0:
+                case 0x00FB:
+                case 0x00FC:
+                case 0x00FE:
+                case 0x00FF:
+                    return FLOW_FALLBACK;
+                case 0x00EE:
+                    return FLOW_RETURN;
+            }
+            return FLOW_STOP;
+        case 0x1000:
+            return FLOW_JUMP;
+        case 0x2000:
+            return FLOW_CALL;
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+            return FLOW_SKIP;
+        case 0x6000:
+        case 0x7000:
+        case 0xA000:
+        case 0xC000:
+            return FLOW_NEXT;
+        case 0x8000:
+            switch (opcode & 0x000F) {
+                case 0x0: case 0x1: case 0x2: case 0x3: case 0x4: case 0x5: case 0x6: case 0x7: case 0xE:
+                    return FLOW_NEXT;
+            }
+            return FLOW_STOP;
+        case 0xB000:
+            return FLOW_INDIRECT;
+        case 0xD000:
+            return FLOW_FALLBACK;
+        case 0xE000:
+            switch (opcode & 0x00FF) {
+                case 0x9E:
+                case 0xA1:
+                    return FLOW_SKIP;
+            }
+            return FLOW_STOP;
+        case 0xF000:
+            switch (opcode & 0x00FF) {
+                case 0x07: case 0x15: case 0x18: case 0x1E: case 0x29: case 0x30: case 0x65: case 0x75: case 0x85:
+                    return FLOW_NEXT;
+                case 0x0A: case 0x33: case 0x55:
+                    return FLOW_FALLBACK;
+            }
+            return FLOW_STOP;
+    }
+    return FLOW_STOP;
+}
+
+static int ends_block(Flow_t flow) {
+    return flow != FLOW_NEXT && flow != FLOW_FALLBACK;
+}
+
+/*
+Follow every path from PROGRAM_START
+    - Jumps, calls and both sides of a skip are followed, a call also continues after itself where the subroutine returns to
+    - Returns and BNNN go where the stack or V0 say, only the addresses reached otherwise are translated
+    - Every address something jumps to starts a block
+*/
+static void disassemble(Aot_Rom *rom) {
+    uint16_t *work = malloc(MEMORY_SIZE * 2 * sizeof(uint16_t));
+    uint32_t addr, targets[2];
+    uint16_t opcode;
+    int top = 0, n, i;
+
+    if (!work) {
+        return;
+    }
+    rom->leader[PROGRAM_START] = 1;
+    work[top++] = PROGRAM_START;
+
+    while (top > 0) {
+        addr = work[--top];
+        if (!in_rom(rom, addr) || rom->reached[addr]) {
+            continue;
+        }
+        rom->reached[addr] = 1;
+        opcode = fetch(rom, addr);
+
+        n = 0;
+        switch (classify(opcode)) {
+            case FLOW_NEXT:
+            case FLOW_FALLBACK:
+                targets[n++] = addr + 2;
+                break;
+            case FLOW_JUMP:
+                targets[n++] = opcode & 0x0FFF;
+                rom->leader[opcode & 0x0FFF] = 1;
+                break;
+            case FLOW_CALL:
+                targets[n++] = opcode & 0x0FFF;
+                targets[n++] = addr + 2;
+                rom->leader[opcode & 0x0FFF] = 1;
+                rom->leader[(addr + 2) & (MEMORY_SIZE - 1)] = 1;
+                break;
+            case FLOW_SKIP:
+                targets[n++] = addr + 2;
+                targets[n++] = addr + 4;
+                rom->leader[(addr + 2) & (MEMORY_SIZE - 1)] = 1;
+                rom->leader[(addr + 4) & (MEMORY_SIZE - 1)] = 1;
+                break;
+            default:
+                break;
+        }
+        for (i = 0; i < n; i++) {
+            if (targets[i] < MEMORY_SIZE) {
+                work[top++] = targets[i];
+            }
+        }
+    }
+    free(work);
+    return;
+}
+
+/* Cut the reached code into blocks, at every leader, after every instruction that ends one and every AOT_MAX_BLOCK instructions */
+static void form_blocks(Aot_Rom *rom) {
+    uint32_t start, addr;
+    int count, more = 1;
+
+    while (more) {
+        more = 0;
+        for (start = PROGRAM_START; start < rom->end; start++) {
+            if (!rom->leader[start] || !rom->reached[start] || rom->block_count[start]) {
+                continue;
+            }
+            addr = start;
+            count = 0;
+            do {
+                count++;
+                addr += 2;
+            } while (!ends_block(classify(fetch(rom, addr - 2))) && count < AOT_MAX_BLOCK && in_rom(rom, addr) && rom->reached[addr] && !rom->leader[addr]);
+
+            /* The rest of a run that was too long is a block of its own */
+            if (count == AOT_MAX_BLOCK && in_rom(rom, addr) && rom->reached[addr] && !rom->leader[addr] && !ends_block(classify(fetch(rom, addr - 2)))) {
+                rom->leader[addr] = 1;
+                more = 1;
+            }
+            rom->block_end[start] = addr;
+            rom->block_count[start] = count;
+            rom->blocks++;
+            rom->instructions += count;
+        }
+    }
+    return;
+}
+
+static int has_block(const Aot_Rom *rom, uint32_t addr) {
+    return addr < MEMORY_SIZE && rom->block_count[addr] != 0;
+}
+
+/* Continue at an address known when translating, with its block if it has one */
+static void emit_goto(FILE *fp, const Aot_Rom *rom, uint32_t target, const char *indent) {
+    target &= 0xFFFF;
+    if (has_block(rom, target)) {
+        fprintf(fp, "%s    return b_%03" PRIX32 "(system, aot, left);\n", indent, target);
+    }
+    else {
+        fprintf(fp, "%s    system->pc = 0x%03" PRIX32 ";\n", indent, target);
+        fprintf(fp, "%s    return left;\n", indent);
+    }
+    return;
+}
+
+/* Give back the instructions of the block that did not run */
+static void emit_fallback(FILE *fp, uint32_t addr, int unused) {
+    fprintf(fp, "    system->pc = 0x%03" PRIX32 ";\n", addr);
+    fprintf(fp, "    if (aot->step(aot, system, 0x%03" PRIX32 ")) {\n", addr + 2);
+    fprintf(fp, "        return left + %d;\n", unused);
+    fprintf(fp, "    }\n");
+    return;
+}
+
+/* The statements of an instruction that does not leave the block, the same as its handler in chip8.c */
+static void emit_statement(FILE *fp, uint16_t opcode) {
+    unsigned int x = (opcode & 0x0F00) >> 8, y = (opcode & 0x00F0) >> 4, nn = opcode & 0x00FF, nnn = opcode & 0x0FFF;
+    unsigned int i;
+
+    switch (opcode & 0xF000) {
+        case 0x6000:
+            fprintf(fp, "    system->V[0x%X] = 0x%02X;\n", x, nn);
+            return;
+        case 0x7000:
+            fprintf(fp, "    system->V[0x%X] += 0x%02X;\n", x, nn);
+            return;
+        case 0xA000:
+            fprintf(fp, "    system->I = 0x%03X;\n", nnn);
+            return;
+        case 0xC000:
+            fprintf(fp, "    r = system->rng;\n");
+            fprintf(fp, "    r ^= r << 13;\n");
+            fprintf(fp, "    r ^= r >> 17;\n");
+            fprintf(fp, "    r ^= r << 5;\n");
+            fprintf(fp, "    system->rng = r;\n");
+            fprintf(fp, "    system->V[0x%X] = (r >> 24) & 0x%02X;\n", x, nn);
+            return;
+        case 0x8000:
+            switch (opcode & 0x000F) {
+                case 0x0:
+                    fprintf(fp, "    system->V[0x%X] = system->V[0x%X];\n", x, y);
+                    return;
+                case 0x1:
+                    fprintf(fp, "    system->V[0x%X] |= system->V[0x%X];\n", x, y);
+                    return;
+                case 0x2:
+                    fprintf(fp, "    system->V[0x%X] &= system->V[0x%X];\n", x, y);
+                    return;
+                case 0x3:
+                    fprintf(fp, "    system->V[0x%X] ^= system->V[0x%X];\n", x, y);
+                    return;
+                case 0x4:
+                    fprintf(fp, "    t = system->V[0x%X] + system->V[0x%X];\n", x, y);
+                    fprintf(fp, "    system->V[0x%X] = (uint8_t)t;\n", x);
+                    fprintf(fp, "    system->V[0xF] = t > UINT8_MAX;\n");
+                    return;
+                case 0x5:
+                    fprintf(fp, "    t = system->V[0x%X] >= system->V[0x%X];\n", x, y);
+                    fprintf(fp, "    system->V[0x%X] -= system->V[0x%X];\n", x, y);
+                    fprintf(fp, "    system->V[0xF] = t;\n");
+                    return;
+                case 0x6:
+                    fprintf(fp, "    t = system->V[0x%X] & 1;\n", x);
+                    fprintf(fp, "    system->V[0x%X] >>= 1;\n", x);
+                    fprintf(fp, "    system->V[0xF] = t;\n");
+                    return;
+                case 0x7:
+                    fprintf(fp, "    t = system->V[0x%X] >= system->V[0x%X];\n", y, x);
+                    fprintf(fp, "    system->V[0x%X] = system->V[0x%X] - system->V[0x%X];\n", x, y, x);
+                    fprintf(fp, "    system->V[0xF] = t;\n");
+                    return;
+                case 0xE:
+                    fprintf(fp, "    t = system->V[0x%X] >> 7;\n", x);
+                    fprintf(fp, "    system->V[0x%X] <<= 1;\n", x);
+                    fprintf(fp, "    system->V[0xF] = t;\n");
+                    return;
+            }
+            return;
+        case 0xF000:
+            switch (opcode & 0x00FF) {
+                case 0x07:
+                    fprintf(fp, "    system->V[0x%X] = system->delay_timer;\n", x);
+                    return;
+                case 0x15:
+                    fprintf(fp, "    system->delay_timer = system->V[0x%X];\n", x);
+                    return;
+                case 0x18:
+                    fprintf(fp, "    system->sound_timer = system->V[0x%X];\n", x);
+                    return;
+                case 0x1E:
+                    fprintf(fp, "    system->I += system->V[0x%X];\n", x);
+                    return;
+                case 0x29:
+                    fprintf(fp, "    system->I = system->V[0x%X] * 5;\n", x);
+                    return;
+                case 0x30:
+                    fprintf(fp, "    system->I = FONT_BIG_START + (system->V[0x%X] & 0xF) * FONT_BIG_SIZE;\n", x);
+                    return;
+                case 0x65:
+                    for (i = 0; i < x; i++) {
+                        fprintf(fp, "    system->V[0x%X] = system->memory[(system->I + %u) & (MEMORY_SIZE - 1)];\n", i, i);
+                    }
+                    return;
+                case 0x75:
+                    for (i = 0; i <= x && i < RPL_COUNT; i++) {
+                        fprintf(fp, "    system->rpl[%u] = system->V[0x%X];\n", i, i);
+                    }
+                    return;
+                case 0x85:
+                    for (i = 0; i <= x && i < RPL_COUNT; i++) {
+                        fprintf(fp, "    system->V[0x%X] = system->rpl[%u];\n", i, i);
+                    }
+                    return;
+            }
+            return;
+    }
+    return;
+}
+
+/* 5XY0 compares VX with the register numbered by its low byte on the interpreter, past VF only the interpreter knows what it reads */
+static int skip_by_interpreter(uint16_t opcode) {
+    return (opcode & 0xF000) == 0x5000 && (opcode & 0x00FF) >= REGISTER_COUNT;
+}
+
+/* The condition under which a skip instruction skips */
+static void emit_condition(FILE *fp, uint16_t opcode) {
+    unsigned int x = (opcode & 0x0F00) >> 8, y = (opcode & 0x00F0) >> 4, nn = opcode & 0x00FF;
+
+    switch (opcode & 0xF000) {
+        case 0x3000:
+            fprintf(fp, "system->V[0x%X] == 0x%02X", x, nn);
+            break;
+        case 0x4000:
+            fprintf(fp, "system->V[0x%X] != 0x%02X", x, nn);
+            break;
+        case 0x5000:
+            /* The interpreter compares with the register NN, see skip_by_interpreter() */
+            fprintf(fp, "system->V[0x%X] == system->V[0x%X]", x, nn);
+            break;
+        case 0x9000:
+            fprintf(fp, "system->V[0x%X] != system->V[0x%X]", x, y);
+            break;
+        default:
+            fprintf(fp, "%skey_at(system, system->V[0x%X])", (opcode & 0x00FF) == 0xA1 ? "!" : "", x);
+            break;
+    }
+    return;
+}
+
+/*
+One block as a function
+    - It only runs when the whole block fits the budget, every path through it is count instructions long
+    - pc is only stored when control goes back to aot_run(), opcode before every exit like the interpreter leaves it
+    - Blocks that follow at an address known now are tail calls, so a loop stays in the library until the budget is spent
+*/
+static void emit_block(FILE *fp, Aot_Rom *rom, uint32_t start) {
+    uint32_t addr, end = rom->block_end[start];
+    int count = rom->block_count[start], i = 0;
+    uint16_t opcode = 0;
+    Flow_t flow = FLOW_NEXT;
+
+    fprintf(fp, "static int b_%03" PRIX32 "(Chip8_t *system, Aot_t *aot, int left) {\n", start);
+    fprintf(fp, "    uint32_t r;\n");
+    fprintf(fp, "    unsigned int t;\n");
+    fprintf(fp, "    (void)r;\n");
+    fprintf(fp, "    (void)t;\n\n");
+    fprintf(fp, "    if (left < aot->need[0x%03" PRIX32 "]) {\n", start);
+    fprintf(fp, "        system->pc = 0x%03" PRIX32 ";\n", start);
+    fprintf(fp, "        return left;\n");
+    fprintf(fp, "    }\n");
+    fprintf(fp, "    left -= %d;\n", count);
+
+    for (addr = start; addr < end; addr += 2, i++) {
+        opcode = fetch(rom, addr);
+        flow = classify(opcode);
+        fprintf(fp, "\n    /* 0x%03" PRIX32 ": %04" PRIX16 " */\n", addr, opcode);
+
+        switch (flow) {
+            case FLOW_NEXT:
+                emit_statement(fp, opcode);
+                break;
+            case FLOW_FALLBACK:
+                emit_fallback(fp, addr, count - i - 1);
+                rom->fallbacks++;
+                break;
+            case FLOW_JUMP:
+                fprintf(fp, "    system->opcode = 0x%04" PRIX16 ";\n", opcode);
+                emit_goto(fp, rom, opcode & 0x0FFF, "");
+                break;
+            case FLOW_CALL:
+                fprintf(fp, "    system->stack[system->sp & (STACK_SIZE - 1)] = 0x%03" PRIX32 ";\n", addr + 2);
+                fprintf(fp, "    system->sp++;\n");
+                fprintf(fp, "    system->opcode = 0x%04" PRIX16 ";\n", opcode);
+                emit_goto(fp, rom, opcode & 0x0FFF, "");
+                break;
+            case FLOW_RETURN:
+                fprintf(fp, "    system->sp--;\n");
+                fprintf(fp, "    system->pc = system->stack[system->sp & (STACK_SIZE - 1)];\n");
+                fprintf(fp, "    system->opcode = 0x%04" PRIX16 ";\n", opcode);
+                fprintf(fp, "    return aot_dispatch(system, aot, left);\n");
+                break;
+            case FLOW_SKIP:
+                if (skip_by_interpreter(opcode)) {
+                    fprintf(fp, "    system->pc = 0x%03" PRIX32 ";\n", addr);
+                    fprintf(fp, "    aot->step(aot, system, 0);\n");
+                    fprintf(fp, "    return aot_dispatch(system, aot, left);\n");
+                    rom->fallbacks++;
+                    break;
+                }
+                fprintf(fp, "    system->opcode = 0x%04" PRIX16 ";\n", opcode);
+                fprintf(fp, "    if (");
+                emit_condition(fp, opcode);
+                fprintf(fp, ") {\n");
+                emit_goto(fp, rom, addr + 4, "    ");
+                fprintf(fp, "    }\n");
+                emit_goto(fp, rom, addr + 2, "");
+                break;
+            case FLOW_INDIRECT:
+                /* The target is only known once V0 is, the interpreter takes the jump */
+                fprintf(fp, "    system->pc = 0x%03" PRIX32 ";\n", addr);
+                fprintf(fp, "    aot->step(aot, system, 0);\n");
+                fprintf(fp, "    return aot_dispatch(system, aot, left);\n");
+                rom->fallbacks++;
+                break;
+            case FLOW_STOP:
+                fprintf(fp, "    system->pc = 0x%03" PRIX32 ";\n", addr);
+                fprintf(fp, "    aot->step(aot, system, 0);\n");
+                fprintf(fp, "    return left;\n");
+                rom->fallbacks++;
+                break;
+        }
+    }
+
+    if (!ends_block(flow)) {
+        fprintf(fp, "\n    system->opcode = 0x%04" PRIX16 ";\n", opcode);
+        emit_goto(fp, rom, end, "");
+    }
+    fprintf(fp, "}\n\n");
+    return;
+}
+
+static void emit_source(FILE *fp, Aot_Rom *rom, const char *path, uint64_t hash) {
+    uint32_t addr;
+
+    fprintf(fp, "/*\n");
+    fprintf(fp, "Translated from %s by chip8-aot\n", path);
+    fprintf(fp, "    - Build with: cc -O3 -shared -fPIC -I<chip8-emu>/include -o rom.so <this file>\n");
+    fprintf(fp, "    - Run with: chip8-emu --aot rom.so %s\n", path);
+    fprintf(fp, "*/\n");
+    fprintf(fp, "#include <stddef.h>\n");
+    fprintf(fp, "#include <stdint.h>\n");
+    fprintf(fp, "#include <string.h>\n\n");
+    fprintf(fp, "#include \"chip8.h\"\n");
+    fprintf(fp, "#include \"aot.h\"\n\n");
+    fprintf(fp, "/* Blocks chain through tail calls, without optimization every one of them would take stack */\n");
+    fprintf(fp, "#if !defined(__OPTIMIZE__)\n");
+    fprintf(fp, "#error \"compile with -O2 or higher\"\n");
+    fprintf(fp, "#endif\n\n");
+    fprintf(fp, "/* The byte the interpreter reads as key[v], a key past 0xF reads on into the system like it does there */\n");
+    fprintf(fp, "static inline uint8_t key_at(const Chip8_t *system, uint8_t v) {\n");
+    fprintf(fp, "    return *((const uint8_t *)system + offsetof(Chip8_t, key) + v);\n");
+    fprintf(fp, "}\n\n");
+
+    for (addr = PROGRAM_START; addr < rom->end; addr++) {
+        if (rom->block_count[addr]) {
+            fprintf(fp, "static int b_%03" PRIX32 "(Chip8_t *system, Aot_t *aot, int left);\n", addr);
+        }
+    }
+    fprintf(fp, "\n");
+
+    for (addr = PROGRAM_START; addr < rom->end; addr++) {
+        if (rom->block_count[addr]) {
+            emit_block(fp, rom, addr);
+        }
+    }
+
+    fprintf(fp, "static const uint8_t rom[%" PRIu32 "] = {", rom->end - PROGRAM_START);
+    for (addr = PROGRAM_START; addr < rom->end; addr++) {
+        fprintf(fp, "%s0x%02X,", (addr - PROGRAM_START) % 16 ? " " : "\n    ", rom->memory[addr]);
+    }
+    fprintf(fp, "\n};\n\n");
+
+    fprintf(fp, "static const Aot_Block blocks[] = {\n");
+    for (addr = PROGRAM_START; addr < rom->end; addr++) {
+        if (rom->block_count[addr]) {
+            fprintf(fp, "    {0x%03" PRIX32 ", 0x%03" PRIX16 ", %" PRIu16 ", b_%03" PRIX32 "},\n", addr, rom->block_end[addr], rom->block_count[addr], addr);
+        }
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp, "const Aot_Module %s = {\n", AOT_SYMBOL);
+    fprintf(fp, "    AOT_ABI_VERSION,\n");
+    fprintf(fp, "    sizeof(Chip8_t),\n");
+    fprintf(fp, "    0x%016" PRIX64 ",\n", hash);
+    fprintf(fp, "    sizeof(rom),\n");
+    fprintf(fp, "    rom,\n");
+    fprintf(fp, "    sizeof(blocks) / sizeof(blocks[0]),\n");
+    fprintf(fp, "    blocks\n");
+    fprintf(fp, "};\n");
+    return;
+}
+
+int main(int argc, char **argv) {
+    static Aot_Rom rom;
+    const char *out = NULL, *path = NULL;
+    uint64_t hash;
+    FILE *fp;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out = argv[++i];
+        }
+        else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    switch (read_rom(&rom, path, &hash)) {
+        case 0:
+            break;
+        case -1:
+            fprintf(stderr, "INVALID ROM PATH!\n");
+            return 1;
+        default:
+            fprintf(stderr, "INVALID ROM!\n");
+            return 1;
+    }
+
+    disassemble(&rom);
+    form_blocks(&rom);
+    if (rom.blocks == 0) {
+        fprintf(stderr, "NOTHING TO TRANSLATE!\n");
+        return 1;
+    }
+
+    fp = out ? fopen(out, "w") : stdout;
+    if (!fp) {
+        fprintf(stderr, "FAILED TO OPEN %s!\n", out);
+        return 1;
+    }
+    emit_source(fp, &rom, path, hash);
+    if (out && fclose(fp) != 0) {
+        fprintf(stderr, "FAILED TO WRITE %s!\n", out);
+        return 1;
+    }
+
+    fprintf(stderr, "BLOCKS: %" PRIu32 "\n", rom.blocks);
+    fprintf(stderr, "INSTRUCTIONS: %" PRIu32 " (%" PRIu32 " left to the interpreter)\n", rom.instructions, rom.fallbacks);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,472 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "headless.h"
+#include "input.h"
+#include "jit.h"
+#include "utils.h"
+
+#define BATCH_LINE_BUF 0x400
+
+typedef enum {
+    FORMAT_CSV,
+    FORMAT_JSON
+} Batch_Format;
+
+typedef struct {
+    char *rom;
+    char *input;
+    uint64_t frames;
+
+    /* Filled in by the worker that ran the job */
+    const char *status;
+    uint64_t frames_run;
+    uint64_t instructions;
+    double seconds;
+    uint64_t hash;
+} Batch_Job;
+
+/*
+Jobs owned by one worker
+    - The owner takes jobs from the tail, idle workers steal from the head
+    - Nothing is pushed once the workers run, so an empty deque stays empty
+*/
+typedef struct {
+    pthread_mutex_t lock;
+    size_t *jobs;
+    size_t head;
+    size_t tail;
+} Batch_Deque;
+
+typedef struct Batch Batch_t;
+
+typedef struct {
+    int id;
+    Batch_t *batch;
+    Batch_Deque deque;
+    pthread_t thread;
+    int failed;
+} Batch_Worker;
+
+struct Batch {
+    Batch_Job *jobs;
+    size_t job_count;
+    Batch_Worker *workers;
+    int worker_count;
+
+    Chip8_Core core;
+    uint64_t ips;
+    uint32_t seed;
+    int clip;
+};
+
+static int deque_pop(Batch_Deque *deque, size_t *job) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *job = deque->jobs[--deque->tail];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static int deque_steal(Batch_Deque *deque, size_t *job) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *job = deque->jobs[deque->head++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static int next_job(Batch_Worker *worker, size_t *job) {
+    int i;
+    Batch_t *batch = worker->batch;
+
+    if (deque_pop(&worker->deque, job)) {
+        return 1;
+    }
+    for (i = 1; i < batch->worker_count; i++) {
+        if (deque_steal(&batch->workers[(worker->id + i) % batch->worker_count].deque, job)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run_job(Batch_t *batch, Batch_Job *job, Chip8_t *system, Jit_t *jit) {
+    Input_Script script = {.events = NULL, .count = 0, .cap = 0, .next = 0};
+    Ipf_Counter ipf;
+    double start;
+
+    job->frames_run = 0;
+    job->instructions = 0;
+    job->seconds = 0;
+    job->hash = 0;
+
+    chip8_initialize(system);
+    chip8_seed(system, batch->seed);
+    system->quirks.clip = batch->clip;
+    switch (load_rom(system, job->rom)) {
+        case 0:
+            break;
+        case -1:
+            job->status = "invalid rom path";
+            return;
+        case -2:
+            job->status = "rom too big";
+            return;
+        default:
+            job->status = "failed to load rom";
+            return;
+    }
+    if (job->input && input_load(&script, job->input) != 0) {
+        job->status = "invalid input script";
+        return;
+    }
+    if (jit) {
+        jit_reset(jit);
+    }
+
+    ipf_init(&ipf, batch->ips);
+    start = headless_time();
+    while (job->frames_run < job->frames && !system->EMU_flags.exit) {
+        input_apply(&script, system, job->frames_run);
+        job->instructions += headless_frame(system, batch->core, jit, ipf_next(&ipf));
+        job->frames_run++;
+    }
+    job->seconds = headless_time() - start;
+
+    job->hash = chip8_hash(system);
+    job->status = system->EMU_flags.exit ? "exited" : "ok";
+    input_free(&script);
+    return;
+}
+
+/* Every worker reuses one system (and JIT) for all the jobs it runs, a worker that can not set them up runs nothing and its jobs are left to the others */
+static void *worker_main(void *arg) {
+    Batch_Worker *worker = arg;
+    Batch_t *batch = worker->batch;
+    Chip8_t *system;
+    Jit_t *jit = NULL;
+    size_t job;
+
+    system = malloc(sizeof(Chip8_t));
+    if (!system) {
+        fprintf(stderr, "WORKER %d IS OUT OF MEMORY!\n", worker->id);
+        worker->failed = 1;
+        return NULL;
+    }
+    if (batch->core == CORE_JIT) {
+        jit = malloc(sizeof(Jit_t));
+        if (!jit || jit_init(jit) != 0) {
+            fprintf(stderr, "WORKER %d FAILED TO INITIALIZE THE JIT!\n", worker->id);
+            worker->failed = 1;
+            free(system);
+            free(jit);
+            return NULL;
+        }
+    }
+
+    while (next_job(worker, &job)) {
+        run_job(batch, &batch->jobs[job], system, jit);
+    }
+
+    if (jit) {
+        jit_cleanup(jit);
+        free(jit);
+    }
+    free(system);
+    return NULL;
+}
+
+/*
+Read the manifest
+    - One job per line: <rom> <frames> [input script]
+    - Lines starting with '#' are comments
+*/
+static int load_manifest(Batch_t *batch, const char *path) {
+    FILE *fp;
+    char line[BATCH_LINE_BUF];
+    char *rom, *frames, *input;
+    size_t cap = 0;
+    Batch_Job *jobs;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        rom = strtok(line, " \t\r\n");
+        if (!rom || rom[0] == '#') {
+            continue;
+        }
+        frames = strtok(NULL, " \t\r\n");
+        input = strtok(NULL, " \t\r\n");
+        if (!frames) {
+            fclose(fp);
+            return -2;
+        }
+
+        if (batch->job_count == cap) {
+            cap = cap ? cap * 2 : 64;
+            jobs = realloc(batch->jobs, cap * sizeof(Batch_Job));
+            if (!jobs) {
+                fclose(fp);
+                return -3;
+            }
+            batch->jobs = jobs;
+        }
+
+        Batch_Job *job = &batch->jobs[batch->job_count];
+        memset(job, 0, sizeof(*job));
+        if (str_to_u64(frames, &job->frames) != 0) {
+            fclose(fp);
+            return -2;
+        }
+        job->rom = strdup(rom);
+        job->input = input ? strdup(input) : NULL;
+        job->status = "not run";
+        batch->job_count++;
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static void write_json_string(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', fp);
+            fputc(*s, fp);
+        }
+        else if ((unsigned char)*s < 0x20) {
+            fprintf(fp, "\\u%04x", *s);
+        }
+        else {
+            fputc(*s, fp);
+        }
+    }
+    fputc('"', fp);
+    return;
+}
+
+static void write_results(Batch_t *batch, FILE *fp, Batch_Format format) {
+    size_t i;
+    Batch_Job *job;
+    double ips;
+
+    if (format == FORMAT_JSON) {
+        fprintf(fp, "[\n");
+    }
+    else {
+        fprintf(fp, "rom,frames,instructions,seconds,ips,hash,status\n");
+    }
+
+    for (i = 0; i < batch->job_count; i++) {
+        job = &batch->jobs[i];
+        ips = (job->seconds > 0) ? job->instructions / job->seconds : 0;
+
+        if (format == FORMAT_JSON) {
+            fprintf(fp, "  {\"rom\": ");
+            write_json_string(fp, job->rom);
+            fprintf(fp, ", \"frames\": %" PRIu64 ", \"instructions\": %" PRIu64 ", \"seconds\": %.6f, \"ips\": %.0f, \"hash\": \"%016" PRIx64 "\", \"status\": \"%s\"}%s\n",
+                    job->frames_run, job->instructions, job->seconds, ips, job->hash, job->status, (i + 1 < batch->job_count) ? "," : "");
+        }
+        else {
+            fprintf(fp, "%s,%" PRIu64 ",%" PRIu64 ",%.6f,%.0f,%016" PRIx64 ",%s\n",
+                    job->rom, job->frames_run, job->instructions, job->seconds, ips, job->hash, job->status);
+        }
+    }
+
+    if (format == FORMAT_JSON) {
+        fprintf(fp, "]\n");
+    }
+    return;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "%s [options] <manifest>\n", prog);
+    fprintf(stderr, "  -j <n>                  Worker threads (default all cores)\n");
+    fprintf(stderr, "  -o <path>               Write the results to a file instead of stdout\n");
+    fprintf(stderr, "  --format <csv|json>     Result format (default csv)\n");
+    fprintf(stderr, "  --core <name>           Execution core: interpreter, threaded or jit\n");
+    fprintf(stderr, "  --ips <n>               Instructions per second (default %d)\n", DEFAULT_IPS);
+    fprintf(stderr, "  --seed <n>              Seed of every job's random number generator\n");
+    fprintf(stderr, "  --clip                  Clip sprites at the screen edges\n");
+    fprintf(stderr, "Manifest lines: <rom> <frames> [input script]\n");
+    return;
+}
+
+int main(int argc, char **argv) {
+    int i;
+    size_t j;
+    const char *manifest = NULL, *output = NULL;
+    Batch_Format format = FORMAT_CSV;
+    Batch_t batch = {.jobs = NULL, .job_count = 0, .workers = NULL, .worker_count = 0, .core = CORE_INTERPRETER, .ips = DEFAULT_IPS, .seed = 0, .clip = 0};
+    FILE *fp;
+    double start, elapsed;
+    uint64_t total = 0, value;
+    int ret = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &value) != 0 || value < 1 || value > INT_MAX) {
+                fprintf(stderr, "INVALID WORKER COUNT!\n");
+                usage(argv[0]);
+                return 1;
+            }
+            batch.worker_count = (int)value;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") == 0) {
+                format = FORMAT_CSV;
+            }
+            else if (strcmp(argv[i], "json") == 0) {
+                format = FORMAT_JSON;
+            }
+            else {
+                fprintf(stderr, "INVALID FORMAT!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--core") == 0 && i + 1 < argc) {
+            if (parse_core(argv[++i], &batch.core) != 0) {
+                fprintf(stderr, "INVALID CORE!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--ips") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &batch.ips) != 0 || batch.ips < 1) {
+                fprintf(stderr, "INVALID IPS!\n");
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &value) != 0 || value > UINT32_MAX) {
+                fprintf(stderr, "INVALID SEED!\n");
+                usage(argv[0]);
+                return 1;
+            }
+            batch.seed = (uint32_t)value;
+        }
+        else if (strcmp(argv[i], "--clip") == 0) {
+            batch.clip = 1;
+        }
+        else if (argv[i][0] == '-' || manifest) {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            manifest = argv[i];
+        }
+    }
+
+    if (!manifest) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (batch.worker_count < 1) {
+        batch.worker_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (batch.worker_count < 1) batch.worker_count = 1;
+    }
+
+    switch (load_manifest(&batch, manifest)) {
+        case -1:
+            fprintf(stderr, "INVALID MANIFEST PATH!\n");
+            return 1;
+        case -2:
+            fprintf(stderr, "INVALID MANIFEST!\n");
+            return 1;
+        case -3:
+            fprintf(stderr, "OUT OF MEMORY!\n");
+            return 1;
+        default:
+            break;
+    }
+    if ((size_t)batch.worker_count > batch.job_count && batch.job_count > 0) {
+        batch.worker_count = (int)batch.job_count;
+    }
+
+    /* Deal the jobs round robin, stealing evens out the rest */
+    batch.workers = calloc(batch.worker_count, sizeof(Batch_Worker));
+    if (!batch.workers) {
+        fprintf(stderr, "OUT OF MEMORY!\n");
+        return 1;
+    }
+    for (i = 0; i < batch.worker_count; i++) {
+        Batch_Worker *worker = &batch.workers[i];
+        worker->id = i;
+        worker->batch = &batch;
+        pthread_mutex_init(&worker->deque.lock, NULL);
+        worker->deque.jobs = malloc((batch.job_count / batch.worker_count + 1) * sizeof(size_t));
+        if (!worker->deque.jobs) {
+            fprintf(stderr, "OUT OF MEMORY!\n");
+            return 1;
+        }
+    }
+    for (j = 0; j < batch.job_count; j++) {
+        Batch_Deque *deque = &batch.workers[j % batch.worker_count].deque;
+        deque->jobs[deque->tail++] = j;
+    }
+
+    start = headless_time();
+    for (i = 0; i < batch.worker_count; i++) {
+        pthread_create(&batch.workers[i].thread, NULL, worker_main, &batch.workers[i]);
+    }
+    for (i = 0; i < batch.worker_count; i++) {
+        pthread_join(batch.workers[i].thread, NULL);
+        if (batch.workers[i].failed) {
+            ret = 1;
+        }
+    }
+    elapsed = headless_time() - start;
+
+    fp = output ? fopen(output, "w") : stdout;
+    if (!fp) {
+        fprintf(stderr, "FAILED TO OPEN %s!\n", output);
+        return 1;
+    }
+    write_results(&batch, fp, format);
+    if (output) {
+        fclose(fp);
+    }
+
+    for (j = 0; j < batch.job_count; j++) {
+        total += batch.jobs[j].instructions;
+    }
+    fprintf(stderr, "%zu jobs on %d workers in %.3f s (%.0f IPS aggregate)\n", batch.job_count, batch.worker_count, elapsed, elapsed > 0 ? total / elapsed : 0);
+    if (ret) {
+        fprintf(stderr, "NOT EVERY WORKER RAN, JOBS WITH STATUS \"not run\" WERE SKIPPED!\n");
+    }
+
+    for (i = 0; i < batch.worker_count; i++) {
+        pthread_mutex_destroy(&batch.workers[i].deque.lock);
+        free(batch.workers[i].deque.jobs);
+    }
+    free(batch.workers);
+    for (j = 0; j < batch.job_count; j++) {
+        free(batch.jobs[j].rom);
+        free(batch.jobs[j].input);
+    }
+    free(batch.jobs);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "chip8.h"
+#include "headless.h"
+#include "jit.h"
+#include "trace.h"
+#include "utils.h"
+
+#define BENCH_MAX_RUNS 64
+#define BENCH_BLOCK 128
+#define BENCH_SUBROUTINE 0xE00
+#define BENCH_DATA 0x600
+#define BENCH_ROM_IPF 1000
+
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_CSV,
+    FORMAT_JSON
+} Bench_Format;
+
+/*
+One opcode family
+    - body is repeated to fill BENCH_BLOCK instructions, followed by a jump back to the start
+    - V and I are set before timing, so the body does not need a prologue
+*/
+typedef struct {
+    const char *name;
+    uint16_t body[4];
+    int body_len;
+    uint8_t va;
+    uint8_t vb;
+    uint16_t I;
+} Bench_Op;
+
+/* A small program, run through headless_frame() on every core */
+typedef struct {
+    const char *name;
+    uint16_t code[16];
+    int code_len;
+} Bench_Rom;
+
+typedef struct {
+    const char *suite;
+    const char *name;
+    const char *core;
+    const char *unit;
+    double median;
+    double min;
+    double max;
+} Bench_Result;
+
+static const Bench_Op ops[] = {
+    {"alu/ld",           {0x6A12},                 1, 0,    0,  0},
+    {"alu/add-imm",      {0x7A01},                 1, 0,    0,  0},
+    {"alu/logic",        {0x8AB1, 0x8AB2, 0x8AB3}, 3, 0x5A, 0x3C, 0},
+    {"alu/carry",        {0x8AB4, 0x8AB5, 0x8AB7}, 3, 0x90, 0x80, 0},
+    {"alu/shift",        {0x8A06, 0x8A0E},         2, 0x81, 0,  0},
+    {"skip/not-taken",   {0x3A00, 0x4A01},         2, 1,    0,  0},
+    {"skip/taken",       {0x3A00, 0x0000},         2, 0,    0,  0},
+    {"skip/reg",         {0x9AB0},                 1, 7,    7,  0},
+    {"call/ret",         {0x2000 | BENCH_SUBROUTINE}, 1, 0, 0,  0},
+    {"index/set-add",    {0xA300, 0xFA1E},         2, 3,    0,  0},
+    {"index/sprite",     {0xFA29},                 1, 9,    0,  0},
+    {"timer",            {0xFA15, 0xFA07},         2, 40,   0,  0},
+    {"rand",             {0xCAFF},                 1, 0,    0,  0},
+    {"draw/1",           {0xDAB1},                 1, 10,   5,  0x50},
+    {"draw/5",           {0xDAB5},                 1, 13,   5,  0x50},
+    {"draw/15",          {0xDABF},                 1, 13,   5,  0x50},
+    {"draw/8-wrap",      {0xDAB8},                 1, 60,   28, 0x50},
+    {"clear",            {0x00E0},                 1, 0,    0,  0},
+    {"mem/bcd",          {0xFA33},                 1, 123,  0,  BENCH_DATA},
+    {"mem/store",        {0xFF55},                 1, 0,    0,  BENCH_DATA},
+    {"mem/load",         {0xFF65},                 1, 0,    0,  BENCH_DATA},
+};
+
+static const Bench_Rom roms[] = {
+    /* Counting loop with carries and shifts */
+    {"alu", {0x6000, 0x6101, 0x8014, 0x8105, 0x8206, 0x820E, 0x7001, 0x1202}, 8},
+    /* Calls into a subroutine that adds and returns */
+    {"call", {0x2208, 0x7001, 0x1200, 0x0000, 0x8014, 0x00EE}, 6},
+    /* Font sprites walking across the screen */
+    {"draw", {0xA050, 0x6000, 0x6100, 0xD015, 0x7008, 0x7101, 0x1206}, 7},
+    /* BCD, store and load against the same data */
+    {"mem", {0xA600, 0xF033, 0xF355, 0xF365, 0x7001, 0x1200}, 6},
+    /* Random sprites, timers and a key check like a game loop */
+    {"mixed", {0xC00F, 0xF029, 0xD125, 0x7104, 0x7201, 0xF115, 0xF307, 0xE09E, 0x1200, 0x1200}, 10},
+};
+
+static void load_program(Chip8_t *system, const uint16_t *code, int len) {
+    int i;
+    for (i = 0; i < len; i++) {
+        system->memory[PROGRAM_START + 2 * i] = code[i] >> 8;
+        system->memory[PROGRAM_START + 2 * i + 1] = code[i] & 0xFF;
+    }
+    return;
+}
+
+static void setup_op(Chip8_t *system, const Bench_Op *op) {
+    uint16_t block[BENCH_BLOCK + 1];
+    int i;
+
+    chip8_initialize(system);
+    chip8_seed(system, DEFAULT_SEED);
+    for (i = 0; i < BENCH_BLOCK; i++) {
+        block[i] = op->body[i % op->body_len];
+    }
+    block[BENCH_BLOCK] = 0x1000 | PROGRAM_START;
+    load_program(system, block, BENCH_BLOCK + 1);
+    system->memory[BENCH_SUBROUTINE] = 0x00;
+    system->memory[BENCH_SUBROUTINE + 1] = 0xEE;
+    chip8_predecode(system);
+
+    system->V[0xA] = op->va;
+    system->V[0xB] = op->vb;
+    system->I = op->I;
+    return;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void summarize(Bench_Result *result, double *runs, int count) {
+    qsort(runs, count, sizeof(double), cmp_double);
+    result->min = runs[0];
+    result->max = runs[count - 1];
+    result->median = (count % 2) ? runs[count / 2] : (runs[count / 2 - 1] + runs[count / 2]) / 2;
+    return;
+}
+
+/* ns per instruction of one family on the interpreter, every run is kept for the median and spread */
+static void bench_op(Chip8_t *system, const Bench_Op *op, int repeats, uint64_t instructions, Bench_Result *result) {
+    double runs[BENCH_MAX_RUNS], start;
+    uint64_t n;
+    int r;
+
+    for (r = 0; r < repeats; r++) {
+        setup_op(system, op);
+        start = headless_time();
+        for (n = 0; n < instructions; n++) {
+            chip8_emulatecycle(system);
+        }
+        runs[r] = (headless_time() - start) * 1e9 / instructions;
+    }
+
+    result->suite = "op";
+    result->name = op->name;
+    result->core = "interpreter";
+    result->unit = "ns/instr";
+    summarize(result, runs, repeats);
+    return;
+}
+
+/* Instructions per second of a whole program on one core, with the trace following it when trace is given */
+static void bench_rom(Chip8_t *system, const Bench_Rom *rom, Chip8_Core core, Jit_t *jit, Trace_t *trace, int repeats, uint64_t instructions, Bench_Result *result) {
+    double runs[BENCH_MAX_RUNS], start;
+    uint64_t n;
+    int r, k;
+
+    for (r = 0; r < repeats; r++) {
+        chip8_initialize(system);
+        chip8_seed(system, DEFAULT_SEED);
+        load_program(system, rom->code, rom->code_len);
+        chip8_predecode(system);
+        if (jit) {
+            jit_reset(jit);
+        }
+        if (trace) {
+            trace_init(trace, "bench.trace", system);
+        }
+
+        start = headless_time();
+        for (n = 0; n < instructions;) {
+            if (trace) {
+                trace_begin(trace, system, BENCH_ROM_IPF);
+                k = headless_execute(system, core, jit, BENCH_ROM_IPF);
+                trace_end(trace, system, k);
+                chip8_update_timers(system);
+                n += k;
+            }
+            else {
+                n += headless_frame(system, core, jit, BENCH_ROM_IPF);
+            }
+        }
+        runs[r] = n / (headless_time() - start);
+    }
+
+    result->suite = "rom";
+    result->name = rom->name;
+    if (core == CORE_JIT) {
+        result->core = trace ? "jit+trace" : "jit";
+    }
+    else if (core == CORE_THREADED) {
+        result->core = trace ? "threaded+trace" : "threaded";
+    }
+    else {
+        result->core = trace ? "interpreter+trace" : "interpreter";
+    }
+    result->unit = "IPS";
+    summarize(result, runs, repeats);
+    return;
+}
+
+static double spread(const Bench_Result *result) {
+    return result->median > 0 ? (result->max - result->min) / result->median * 100 : 0;
+}
+
+static void write_results(FILE *fp, const Bench_Result *results, int count, Bench_Format format, int repeats, uint64_t instructions) {
+    int i;
+    const Bench_Result *r;
+
+    switch (format) {
+        case FORMAT_CSV:
+            fprintf(fp, "suite,name,core,unit,median,min,max,spread\n");
+            for (i = 0; i < count; i++) {
+                r = &results[i];
+                fprintf(fp, "%s,%s,%s,%s,%.3f,%.3f,%.3f,%.2f\n", r->suite, r->name, r->core, r->unit, r->median, r->min, r->max, spread(r));
+            }
+            break;
+        case FORMAT_JSON:
+            fprintf(fp, "{\"repeats\": %d, \"instructions\": %" PRIu64 ", \"results\": [\n", repeats, instructions);
+            for (i = 0; i < count; i++) {
+                r = &results[i];
+                fprintf(fp, "  {\"suite\": \"%s\", \"name\": \"%s\", \"core\": \"%s\", \"unit\": \"%s\", \"median\": %.3f, \"min\": %.3f, \"max\": %.3f, \"spread\": %.2f}%s\n",
+                        r->suite, r->name, r->core, r->unit, r->median, r->min, r->max, spread(r), i + 1 < count ? "," : "");
+            }
+            fprintf(fp, "]}\n");
+            break;
+        default:
+            fprintf(fp, "%-5s %-16s %-17s %14s %14s %8s\n", "SUITE", "NAME", "CORE", "MEDIAN", "MIN", "SPREAD");
+            for (i = 0; i < count; i++) {
+                r = &results[i];
+                fprintf(fp, "%-5s %-16s %-17s %14.2f %14.2f %7.1f%% %s\n", r->suite, r->name, r->core, r->median, r->min, spread(r), r->unit);
+            }
+            break;
+    }
+    return;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "%s [options]\n", prog);
+    fprintf(stderr, "  -r <n>                  Runs of every benchmark (default 7, at most %d)\n", BENCH_MAX_RUNS);
+    fprintf(stderr, "  -n <n>                  Instructions per run (default 2000000)\n");
+    fprintf(stderr, "  -o <path>               Write the results to a file instead of stdout\n");
+    fprintf(stderr, "  --format <text|csv|json> Result format (default text)\n");
+    fprintf(stderr, "  --filter <text>         Only run benchmarks whose name contains text\n");
+    return;
+}
+
+int main(int argc, char **argv) {
+    int i, c, repeats = 7, count = 0;
+    uint64_t instructions = 2000000;
+    const char *output = NULL, *filter = NULL;
+    Bench_Format format = FORMAT_TEXT;
+    Bench_Result results[sizeof(ops) / sizeof(ops[0]) + 6 * sizeof(roms) / sizeof(roms[0])];
+    static const Chip8_Core cores[] = {CORE_INTERPRETER, CORE_THREADED, CORE_JIT};
+    Chip8_t *system;
+    Jit_t *jit;
+    Trace_t *trace;
+    int jit_ok;
+    FILE *fp = stdout;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            instructions = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "text") == 0) {
+                format = FORMAT_TEXT;
+            }
+            else if (strcmp(argv[i], "csv") == 0) {
+                format = FORMAT_CSV;
+            }
+            else if (strcmp(argv[i], "json") == 0) {
+                format = FORMAT_JSON;
+            }
+            else {
+                fprintf(stderr, "INVALID FORMAT!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (repeats < 1 || repeats > BENCH_MAX_RUNS || instructions < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    system = malloc(sizeof(Chip8_t));
+    jit = malloc(sizeof(Jit_t));
+    trace = malloc(sizeof(Trace_t));
+    if (!system || !jit || !trace) {
+        fprintf(stderr, "OUT OF MEMORY!\n");
+        return 1;
+    }
+    jit_ok = jit_init(jit) == 0;
+
+    for (i = 0; i < (int)(sizeof(ops) / sizeof(ops[0])); i++) {
+        if (filter && !strstr(ops[i].name, filter)) continue;
+        bench_op(system, &ops[i], repeats, instructions, &results[count++]);
+    }
+    for (i = 0; i < (int)(sizeof(roms) / sizeof(roms[0])); i++) {
+        if (filter && !strstr(roms[i].name, filter)) continue;
+        for (c = 0; c < 3; c++) {
+            if (cores[c] == CORE_JIT && !jit_ok) continue;
+            bench_rom(system, &roms[i], cores[c], cores[c] == CORE_JIT ? jit : NULL, NULL, repeats, instructions, &results[count++]);
+            /* What the trace adds to the core */
+            bench_rom(system, &roms[i], cores[c], cores[c] == CORE_JIT ? jit : NULL, trace, repeats, instructions, &results[count++]);
+        }
+    }
+
+    if (output) {
+        fp = fopen(output, "w");
+        if (!fp) {
+            fprintf(stderr, "INVALID OUTPUT PATH!\n");
+            return 1;
+        }
+    }
+    write_results(fp, results, count, format, repeats, instructions);
+    if (output) {
+        fclose(fp);
+    }
+
+    if (jit_ok) {
+        jit_cleanup(jit);
+    }
+    free(jit);
+    free(trace);
+    free(system);
+    return 0;
+}
\ No newline at end of file
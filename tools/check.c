@@ -0,0 +1,727 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "aot.h"
+#include "catalog.h"
+#include "chip8.h"
+#include "headless.h"
+#include "input.h"
+#include "jit.h"
+
+#define CHECK_MAX_EVENTS 8
+#define CHECK_NAME_BUF 0x40
+#define CHECK_LINE_BUF 0x100
+#define CHECK_PATH_BUF 0x200
+#define CHECK_BENCH_IPF 100000
+#define DEFAULT_GOLDEN "tests/check.golden"
+#define DEFAULT_BASELINE "tests/check.baseline"
+#define DEFAULT_THRESHOLD 25.0
+#define DEFAULT_RUNS 5
+#define DEFAULT_INSTRUCTIONS 5000000
+
+/*
+A test program
+    - Runs frames frames at ips with the seed, or until it exits, the key events are applied at the start of their frame
+    - Every core has to end with the screen and registers in the golden file
+*/
+typedef struct {
+    const char *name;
+    uint8_t code[96];
+    int code_len;
+    uint64_t frames;
+    uint64_t ips;
+    uint32_t seed;
+    int clip;
+    Input_Event events[CHECK_MAX_EVENTS];
+    int event_count;
+} Check_Rom;
+
+/* Idle skipping counts the instructions it elided as executed, so its throughput depends on the ROM more than on the code and is not timed */
+typedef struct {
+    const char *name;
+    Chip8_Core core;
+    int idle_skip;
+} Check_Core;
+
+typedef struct {
+    const Check_Rom *rom;
+    const Check_Core *core;
+
+    /* Filled in by the worker that ran the job */
+    const char *status;
+    int exited;
+    uint64_t gfx_hash;
+    uint64_t regs_hash;
+    double ips;
+    double baseline;
+} Check_Job;
+
+typedef struct {
+    char name[CHECK_NAME_BUF];
+    uint64_t gfx_hash;
+    uint64_t regs_hash;
+} Check_Golden;
+
+typedef struct {
+    char rom[CHECK_NAME_BUF];
+    char core[CHECK_NAME_BUF];
+    double ips;
+} Check_Baseline;
+
+/* aot_dir holds <rom>.so for every ROM, translated by chip8-aot, the aot core is unavailable without it */
+typedef struct {
+    Check_Job *jobs;
+    size_t job_count;
+    size_t next;
+    pthread_mutex_t lock;
+    uint64_t instructions;
+    int runs;
+    const char *aot_dir;
+} Check_t;
+
+static const Check_Rom roms[] = {
+    /* Arithmetic with carries, borrows and shifts, then FX1E */
+    {"alu", {0x60, 0x01, 0x61, 0x02, 0x70, 0x01, 0x80, 0x14, 0x81, 0x25, 0x82, 0x03, 0x83, 0x06, 0x83, 0x0E,
+             0x30, 0x05, 0x41, 0x06, 0x90, 0x10, 0xA3, 0x00, 0xF0, 0x1E, 0x12, 0x04}, 28, 300, 5400, 1, 0, {{0}}, 0},
+    /* Nested calls and returns */
+    {"call", {0x22, 0x06, 0x70, 0x01, 0x12, 0x00, 0x22, 0x0A, 0x00, 0xEE, 0x71, 0x01, 0x00, 0xEE}, 14, 300, 5400, 1, 0, {{0}}, 0},
+    /* BCD, FX55 and FX65 on overlapping data */
+    {"mem", {0x6A, 0x7B, 0xA4, 0x00, 0xFA, 0x33, 0xF2, 0x65, 0xA4, 0x10, 0xF5, 0x55, 0xF5, 0x65, 0x7A, 0x01,
+             0x22, 0x14, 0x12, 0x02, 0x80, 0x14, 0x00, 0xEE}, 24, 300, 5400, 1, 0, {{0}}, 0},
+    /* Font sprites walking across the screen with collisions */
+    {"draw", {0x00, 0xE0, 0x60, 0x00, 0x61, 0x00, 0x62, 0x00, 0xF2, 0x29, 0xD0, 0x15, 0x70, 0x08, 0x72, 0x01,
+              0x30, 0x40, 0x12, 0x08, 0x60, 0x00, 0x71, 0x06, 0x31, 0x18, 0x12, 0x08, 0x12, 0x02}, 30, 300, 540, 1, 0, {{0}}, 0},
+    /* 15 row sprites drawn across the edges, wrapping */
+    {"edge", {0x60, 0x00, 0x61, 0x00, 0x62, 0x00, 0xF2, 0x29, 0xD0, 0x1F, 0x70, 0x07, 0x71, 0x03, 0x72, 0x01,
+              0x12, 0x06}, 18, 100, 540, 1, 0, {{0}}, 0},
+    /* The same with sprites clipped at the edges */
+    {"edge-clip", {0x60, 0x00, 0x61, 0x00, 0x62, 0x00, 0xF2, 0x29, 0xD0, 0x1F, 0x70, 0x07, 0x71, 0x03, 0x72, 0x01,
+                   0x12, 0x06}, 18, 100, 540, 1, 1, {{0}}, 0},
+    /* BNNN, 9XY0 and the immediate skips, ends in a loop at 0x206 */
+    {"jump", {0x60, 0x04, 0x61, 0x01, 0xB2, 0x06, 0x12, 0x06, 0x12, 0x08, 0x90, 0x10, 0x12, 0x06, 0x41, 0x05,
+              0x12, 0x06, 0x71, 0x01, 0x12, 0x04}, 22, 300, 540, 1, 0, {{0}}, 0},
+    /* Random sprites from CXNN */
+    {"rand", {0x00, 0xE0, 0xC0, 0x3F, 0xC1, 0x1F, 0xC2, 0x0F, 0xF2, 0x29, 0xD0, 0x15, 0x12, 0x02}, 14, 300, 540, 1234, 0, {{0}}, 0},
+    /* Busy waits on the delay timer while the sound timer runs */
+    {"timers", {0x6A, 0x00, 0x60, 0x14, 0xF0, 0x15, 0xF0, 0x18, 0xF1, 0x07, 0x31, 0x00, 0x12, 0x08, 0x7A, 0x01,
+                0x00, 0xE0, 0xFA, 0x29, 0x6B, 0x00, 0xDB, 0xB5, 0x12, 0x02}, 26, 300, 540, 1, 0, {{0}}, 0},
+    /* FX0A and EX9E against a key schedule */
+    {"keys", {0x62, 0x00, 0x63, 0x00, 0xF0, 0x0A, 0xF0, 0x29, 0xD2, 0x35, 0x72, 0x05, 0x61, 0x05, 0xE1, 0x9E,
+              0x12, 0x04, 0x73, 0x01, 0x12, 0x04}, 22, 300, 540, 1, 0,
+             {{10, 0x3, 1}, {12, 0x3, 0}, {40, 0x5, 1}, {44, 0xA, 1}, {45, 0x5, 0}, {90, 0xA, 0}, {120, 0xC, 1}, {121, 0xC, 0}}, 8},
+    /* A hot loop rewritten by FX55 while it runs */
+    {"selfmod", {0x6A, 0x00, 0x6C, 0x00, 0x7A, 0x01, 0x7C, 0x01, 0x3C, 0x40, 0x12, 0x04, 0x60, 0x71, 0x61, 0x05,
+                 0xA2, 0x04, 0xF2, 0x55, 0x6C, 0x00, 0x12, 0x04}, 24, 300, 5400, 1, 0, {{0}}, 0},
+    /* SUPER-CHIP high resolution, 16x16 sprites, scrolling, the big font and the RPL flags */
+    {"schip", {0x00, 0xFF, 0x60, 0x0A, 0x61, 0x05, 0xA2, 0x3E, 0xD0, 0x10, 0x62, 0x07, 0xF2, 0x30, 0x60, 0x28,
+               0xD0, 0x1A, 0x60, 0x70, 0x61, 0x38, 0xA2, 0x3E, 0xD0, 0x10, 0x00, 0xC3, 0x00, 0xFB, 0x00, 0xFC,
+               0x00, 0xFC, 0x00, 0xFB, 0x60, 0x11, 0x61, 0x22, 0x62, 0x33, 0xF2, 0x75, 0x60, 0x00, 0x61, 0x00,
+               0x62, 0x00, 0xF2, 0x85, 0x63, 0x40, 0x64, 0x02, 0xA0, 0x00, 0xD3, 0x45, 0x12, 0x3C, 0xFF, 0xFF,
+               0x80, 0x01, 0xBF, 0xFD, 0xA0, 0x05, 0xAF, 0xF5, 0xA8, 0x15, 0xAB, 0xD5, 0xAA, 0x55, 0xAA, 0x55,
+               0xAB, 0xD5, 0xA8, 0x15, 0xAF, 0xF5, 0xA0, 0x05, 0xBF, 0xFD, 0x80, 0x01, 0xFF, 0xFF}, 94, 300, 540, 1, 0, {{0}}, 0},
+    /* Switching back to low resolution and 16x16 sprites there */
+    {"schip-lores", {0x00, 0xFF, 0x60, 0x05, 0x61, 0x05, 0xA2, 0x18, 0xD0, 0x10, 0x00, 0xFE, 0xA2, 0x18, 0xD0, 0x15,
+                     0xD0, 0x10, 0x00, 0xC2, 0x00, 0xFB, 0x12, 0x16, 0xFF, 0xFF, 0x80, 0x01, 0xBF, 0xFD, 0xA0, 0x05,
+                     0xAF, 0xF5, 0xA8, 0x15, 0xAB, 0xD5, 0xAA, 0x55, 0xAA, 0x55, 0xAB, 0xD5, 0xA8, 0x15, 0xAF, 0xF5,
+                     0xA0, 0x05, 0xBF, 0xFD, 0x80, 0x01, 0xFF, 0xFF}, 56, 300, 540, 1, 0, {{0}}, 0},
+    /* 00FD after 106 instructions, partway through a frame, a core that runs on draws digits and counts in V1 */
+    {"exit", {0x60, 0x00, 0x70, 0x01, 0x30, 0x23, 0x12, 0x02, 0x00, 0xFD, 0x71, 0x01, 0xF1, 0x29, 0xD0, 0x05,
+              0x12, 0x0A}, 18, 30, 540, 1, 0, {{0}}, 0},
+    /* FX33, FX65 and FX55 across 0xFFF, then with I driven by FX1E to 0xFFFE so they cross 0xFFFF, the font they wrapped onto is drawn */
+    {"wrap", {0x6A, 0x7B, 0x60, 0x11, 0x61, 0x22, 0x62, 0x33, 0xAF, 0xFE, 0xFA, 0x33, 0xF2, 0x65, 0xF2, 0x55,
+              0x6C, 0xF0, 0x6D, 0xFF, 0xAF, 0xFF, 0xFD, 0x1E, 0x7C, 0xFF, 0x3C, 0x00, 0x12, 0x16, 0x6D, 0xEF,
+              0xFD, 0x1E, 0xFA, 0x33, 0xF2, 0x65, 0x70, 0x01, 0xF2, 0x55, 0xA0, 0x00, 0x65, 0x00, 0x66, 0x00,
+              0xD5, 0x65, 0x12, 0x32}, 52, 30, 5400, 1, 0, {{0}}, 0},
+};
+
+#define ROM_COUNT (sizeof(roms) / sizeof(roms[0]))
+
+static const Check_Core cores[] = {
+    {"interpreter", CORE_INTERPRETER, 0},
+    {"threaded",    CORE_THREADED,    0},
+    {"jit",         CORE_JIT,         0},
+    {"idle-skip",   CORE_INTERPRETER, 1},
+    {"aot",         CORE_AOT,         0},
+};
+
+#define CORE_COUNT (sizeof(cores) / sizeof(cores[0]))
+
+/* FNV-1a over the words of the screen in use, most significant byte first so the hash is the same on every host */
+static uint64_t hash_gfx(const Chip8_t *system) {
+    uint8_t buf[DISPLAY_MAX_WORDS * sizeof(uint64_t)];
+    int i, b, words = chip8_row_words(system) * system->height;
+
+    for (i = 0; i < words; i++) {
+        for (b = 0; b < 8; b++) {
+            buf[i * 8 + b] = system->gfx[i] >> (56 - 8 * b);
+        }
+    }
+    return catalog_hash(buf, words * sizeof(uint64_t));
+}
+
+/* FNV-1a over V0 to VF, I, pc, sp, the stack and both timers */
+static uint64_t hash_regs(const Chip8_t *system) {
+    uint8_t buf[REGISTER_COUNT + 6 + STACK_SIZE * 2 + 2];
+    size_t len = 0;
+    int i;
+
+    memcpy(buf, system->V, REGISTER_COUNT);
+    len += REGISTER_COUNT;
+    buf[len++] = system->I >> 8;
+    buf[len++] = system->I & 0xFF;
+    buf[len++] = system->pc >> 8;
+    buf[len++] = system->pc & 0xFF;
+    buf[len++] = system->sp >> 8;
+    buf[len++] = system->sp & 0xFF;
+    for (i = 0; i < STACK_SIZE; i++) {
+        buf[len++] = system->stack[i] >> 8;
+        buf[len++] = system->stack[i] & 0xFF;
+    }
+    buf[len++] = system->delay_timer;
+    buf[len++] = system->sound_timer;
+    return catalog_hash(buf, len);
+}
+
+static void setup(Chip8_t *system, const Check_Rom *rom) {
+    chip8_initialize(system);
+    chip8_seed(system, rom->seed);
+    system->quirks.clip = rom->clip;
+    chip8_write(system, PROGRAM_START, rom->code, rom->code_len);
+    return;
+}
+
+static uint64_t run_frame(Chip8_t *system, const Check_Core *core, Jit_t *jit, Aot_t *aot, int budget) {
+    uint64_t elided = 0, executed;
+
+    if (core->idle_skip) {
+        executed = chip8_run_idle(system, budget, &elided);
+        chip8_update_timers(system);
+        return executed;
+    }
+    if (core->core == CORE_AOT) {
+        executed = aot_run(aot, system, budget);
+        chip8_update_timers(system);
+        return executed;
+    }
+    return headless_frame(system, core->core, jit, budget);
+}
+
+/* The caches of the cores start over for every run */
+static void reset_cores(Chip8_t *system, Jit_t *jit, Aot_t *aot) {
+    if (jit) {
+        jit_reset(jit);
+    }
+    if (aot) {
+        aot_reset(aot, system);
+    }
+    return;
+}
+
+/* The run the hashes are taken from, at the speed and with the keys of the ROM */
+static int run_conformance(Check_Job *job, Chip8_t *system, Jit_t *jit, Aot_t *aot) {
+    Input_Script script = {.events = NULL, .count = 0, .cap = 0, .next = 0};
+    Ipf_Counter ipf;
+    uint64_t frame;
+    int i;
+
+    for (i = 0; i < job->rom->event_count; i++) {
+        if (input_push(&script, job->rom->events[i].frame, job->rom->events[i].key, job->rom->events[i].down) != 0) {
+            input_free(&script);
+            return -3;
+        }
+    }
+
+    setup(system, job->rom);
+    reset_cores(system, jit, aot);
+    ipf_init(&ipf, job->rom->ips);
+    for (frame = 0; frame < job->rom->frames && !system->EMU_flags.exit; frame++) {
+        input_apply(&script, system, frame);
+        run_frame(system, job->core, jit, aot, ipf_next(&ipf));
+    }
+
+    job->exited = system->EMU_flags.exit;
+    job->gfx_hash = hash_gfx(system);
+    job->regs_hash = hash_regs(system);
+    input_free(&script);
+    return 0;
+}
+
+/* Instructions per second running the ROM as fast as possible, the best of runs */
+static void run_throughput(Check_t *check, Check_Job *job, Chip8_t *system, Jit_t *jit, Aot_t *aot) {
+    uint64_t instructions;
+    double start, seconds, best = 0;
+    int r;
+
+    for (r = 0; r < check->runs; r++) {
+        setup(system, job->rom);
+        reset_cores(system, jit, aot);
+        instructions = 0;
+        start = headless_time();
+        while (instructions < check->instructions && !system->EMU_flags.exit) {
+            instructions += run_frame(system, job->core, jit, aot, CHECK_BENCH_IPF);
+        }
+        seconds = headless_time() - start;
+        if (seconds > 0 && instructions / seconds > best) {
+            best = instructions / seconds;
+        }
+    }
+    job->ips = best;
+    return;
+}
+
+/* Open a JIT for the job if its core needs one, 1 when it is not available on this host */
+static int open_jit(const Check_Job *job, Jit_t *jit, Jit_t **jitp) {
+    *jitp = NULL;
+    if (job->core->core != CORE_JIT) {
+        return 0;
+    }
+    if (jit_init(jit) != 0) {
+        return 1;
+    }
+    *jitp = jit;
+    return 0;
+}
+
+/*
+Load the translation of the job's ROM if its core is the AOT core
+    - 1 when no directory of libraries was given
+    - -1 when the library is missing, not a translation or was translated from another ROM
+*/
+static int open_aot(const Check_t *check, const Check_Job *job, Aot_t *aot, Aot_t **aotp) {
+    char path[CHECK_PATH_BUF];
+
+    *aotp = NULL;
+    if (job->core->core != CORE_AOT) {
+        return 0;
+    }
+    if (!check->aot_dir) {
+        return 1;
+    }
+    if (snprintf(path, sizeof(path), "%s/%s.so", check->aot_dir, job->rom->name) >= (int)sizeof(path) || aot_load(aot, path) != 0) {
+        return -1;
+    }
+    if (aot->module->rom_hash != catalog_hash(job->rom->code, job->rom->code_len)) {
+        aot_cleanup(aot);
+        return -1;
+    }
+    *aotp = aot;
+    return 0;
+}
+
+static void run_job(Check_t *check, Check_Job *job, Chip8_t *system, Aot_t *aot) {
+    Jit_t jit;
+    Jit_t *jitp;
+    Aot_t *aotp;
+
+    if (open_jit(job, &jit, &jitp) != 0) {
+        job->status = "unavailable";
+        return;
+    }
+    switch (open_aot(check, job, aot, &aotp)) {
+        case 0:
+            break;
+        case 1:
+            job->status = "unavailable";
+            return;
+        default:
+            job->status = "no library";
+            return;
+    }
+    job->status = run_conformance(job, system, jitp, aotp) == 0 ? "ran" : "out of memory";
+    if (jitp) {
+        jit_cleanup(jitp);
+    }
+    if (aotp) {
+        aot_cleanup(aotp);
+    }
+    return;
+}
+
+/* The timed runs happen one after another once the workers are done, so they do not compete for the host, a ROM that exits is over too soon to be timed */
+static void time_jobs(Check_t *check, Chip8_t *system, Aot_t *aot) {
+    Check_Job *job;
+    Jit_t jit;
+    Jit_t *jitp;
+    Aot_t *aotp;
+    size_t j;
+
+    for (j = 0; j < check->job_count; j++) {
+        job = &check->jobs[j];
+        if (job->core->idle_skip || job->exited || strcmp(job->status, "ran") != 0 || open_jit(job, &jit, &jitp) != 0) {
+            continue;
+        }
+        if (open_aot(check, job, aot, &aotp) != 0) {
+            if (jitp) {
+                jit_cleanup(jitp);
+            }
+            continue;
+        }
+        run_throughput(check, job, system, jitp, aotp);
+        if (jitp) {
+            jit_cleanup(jitp);
+        }
+        if (aotp) {
+            aot_cleanup(aotp);
+        }
+    }
+    return;
+}
+
+/* Workers take the next job until none are left, one system and one AOT library slot each */
+static void *worker_main(void *arg) {
+    Check_t *check = arg;
+    Chip8_t *system;
+    Aot_t *aot;
+    size_t job;
+
+    system = malloc(sizeof(Chip8_t));
+    aot = malloc(sizeof(Aot_t));
+    if (!system || !aot) {
+        free(system);
+        free(aot);
+        return NULL;
+    }
+    for (;;) {
+        pthread_mutex_lock(&check->lock);
+        job = check->next++;
+        pthread_mutex_unlock(&check->lock);
+        if (job >= check->job_count) {
+            break;
+        }
+        run_job(check, &check->jobs[job], system, aot);
+    }
+    free(system);
+    free(aot);
+    return NULL;
+}
+
+/* Lines of <rom> <screen hash> <register hash>, '#' starts a comment */
+static int load_golden(const char *path, Check_Golden *golden, size_t *count) {
+    FILE *fp;
+    char line[CHECK_LINE_BUF];
+    Check_Golden entry;
+
+    *count = 0;
+    fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%63s %" SCNx64 " %" SCNx64, entry.name, &entry.gfx_hash, &entry.regs_hash) != 3 || *count == ROM_COUNT) {
+            fclose(fp);
+            return -2;
+        }
+        golden[(*count)++] = entry;
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* Lines of <rom> <core> <instructions per second>, '#' starts a comment */
+static int load_baseline(const char *path, Check_Baseline *baseline, size_t *count) {
+    FILE *fp;
+    char line[CHECK_LINE_BUF];
+    Check_Baseline entry;
+
+    *count = 0;
+    fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%63s %63s %lf", entry.rom, entry.core, &entry.ips) != 3 || *count == ROM_COUNT * CORE_COUNT) {
+            fclose(fp);
+            return -2;
+        }
+        baseline[(*count)++] = entry;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static const Check_Golden *find_golden(const Check_Golden *golden, size_t count, const char *name) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (strcmp(golden[i].name, name) == 0) {
+            return &golden[i];
+        }
+    }
+    return NULL;
+}
+
+static double find_baseline(const Check_Baseline *baseline, size_t count, const char *rom, const char *core) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (strcmp(baseline[i].rom, rom) == 0 && strcmp(baseline[i].core, core) == 0) {
+            return baseline[i].ips;
+        }
+    }
+    return 0;
+}
+
+static int save_golden(const char *path, const Check_Job *jobs) {
+    FILE *fp = fopen(path, "w");
+    size_t i;
+
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "# rom, screen hash, register hash. Written by chip8-check --update-golden\n");
+    for (i = 0; i < ROM_COUNT; i++) {
+        fprintf(fp, "%s %016" PRIx64 " %016" PRIx64 "\n", roms[i].name, jobs[i * CORE_COUNT].gfx_hash, jobs[i * CORE_COUNT].regs_hash);
+    }
+    return fclose(fp) == 0 ? 0 : -3;
+}
+
+static int save_baseline(const char *path, const Check_Job *jobs, size_t job_count) {
+    FILE *fp = fopen(path, "w");
+    size_t i;
+
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "# rom, core, instructions per second. Written by chip8-check --update-baseline, only valid on the host that wrote it\n");
+    for (i = 0; i < job_count; i++) {
+        if (jobs[i].ips > 0) {
+            fprintf(fp, "%s %s %.0f\n", jobs[i].rom->name, jobs[i].core->name, jobs[i].ips);
+        }
+    }
+    return fclose(fp) == 0 ? 0 : -3;
+}
+
+/* Every ROM as <dir>/<rom>.ch8, for chip8-aot to translate */
+static int write_roms(const char *dir) {
+    char path[CHECK_PATH_BUF];
+    FILE *fp;
+    size_t i;
+
+    for (i = 0; i < ROM_COUNT; i++) {
+        if (snprintf(path, sizeof(path), "%s/%s.ch8", dir, roms[i].name) >= (int)sizeof(path)) {
+            return -2;
+        }
+        fp = fopen(path, "wb");
+        if (!fp) {
+            return -1;
+        }
+        if (fwrite(roms[i].code, 1, roms[i].code_len, fp) != (size_t)roms[i].code_len) {
+            fclose(fp);
+            return -3;
+        }
+        if (fclose(fp) != 0) {
+            return -3;
+        }
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "%s [options]\n", prog);
+    fprintf(stderr, "  -j <n>                  Worker threads (default all cores)\n");
+    fprintf(stderr, "  --golden <path>         Screen and register hashes every core must end with (default %s)\n", DEFAULT_GOLDEN);
+    fprintf(stderr, "  --baseline <path>       Instructions per second to compare against (default %s)\n", DEFAULT_BASELINE);
+    fprintf(stderr, "  --threshold <percent>   Largest drop below the baseline that passes (default %.0f)\n", DEFAULT_THRESHOLD);
+    fprintf(stderr, "  --runs <n>              Throughput runs per ROM and core, the best counts (default %d)\n", DEFAULT_RUNS);
+    fprintf(stderr, "  --instructions <n>      Instructions of every throughput run (default %d)\n", DEFAULT_INSTRUCTIONS);
+    fprintf(stderr, "  --update-golden         Write the hashes instead of checking them, the cores still have to agree\n");
+    fprintf(stderr, "  --update-baseline       Write the instructions per second of this host as the baseline\n");
+    fprintf(stderr, "  --aot-dir <dir>         Run the aot core with <dir>/<rom>.so, translated from the ROMs --write-roms wrote (default the aot core is unavailable)\n");
+    fprintf(stderr, "  --write-roms <dir>      Write every ROM to <dir>/<rom>.ch8 and exit\n");
+    return;
+}
+
+/*
+Run every ROM on every core
+    - The hashes are taken on all workers at once, the throughput is timed afterwards on one thread
+    - Fails when a core ends with other hashes than the golden file, or runs more than threshold percent slower than the baseline
+    - Without a baseline the throughput is only reported
+*/
+int main(int argc, char **argv) {
+    const char *golden_path = DEFAULT_GOLDEN, *baseline_path = DEFAULT_BASELINE, *roms_dir = NULL;
+    double threshold = DEFAULT_THRESHOLD, change;
+    int i, workers = 0, update_golden = 0, update_baseline = 0, failures = 0, regressions = 0;
+    size_t j, golden_count = 0, baseline_count = 0;
+    Check_t check = {.jobs = NULL, .job_count = ROM_COUNT * CORE_COUNT, .next = 0, .instructions = DEFAULT_INSTRUCTIONS, .runs = DEFAULT_RUNS, .aot_dir = NULL};
+    Check_Golden golden[ROM_COUNT];
+    Check_Baseline baseline[ROM_COUNT * CORE_COUNT];
+    const Check_Golden *expect;
+    Check_Job *job, *first;
+    Chip8_t *system;
+    Aot_t *aot;
+    pthread_t *threads;
+    int ret;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            golden_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            check.runs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--instructions") == 0 && i + 1 < argc) {
+            check.instructions = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--update-golden") == 0) {
+            update_golden = 1;
+        }
+        else if (strcmp(argv[i], "--update-baseline") == 0) {
+            update_baseline = 1;
+        }
+        else if (strcmp(argv[i], "--aot-dir") == 0 && i + 1 < argc) {
+            check.aot_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--write-roms") == 0 && i + 1 < argc) {
+            roms_dir = argv[++i];
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (check.runs < 1) {
+        check.runs = 1;
+    }
+    if (roms_dir) {
+        if (write_roms(roms_dir) != 0) {
+            fprintf(stderr, "FAILED TO WRITE THE ROMS TO %s!\n", roms_dir);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!update_golden) {
+        switch (load_golden(golden_path, golden, &golden_count)) {
+            case -1:
+                fprintf(stderr, "INVALID GOLDEN PATH!\n");
+                return 1;
+            case -2:
+                fprintf(stderr, "INVALID GOLDEN FILE!\n");
+                return 1;
+            default:
+                break;
+        }
+    }
+    if (!update_baseline) {
+        ret = load_baseline(baseline_path, baseline, &baseline_count);
+        if (ret == -2) {
+            fprintf(stderr, "INVALID BASELINE FILE!\n");
+            return 1;
+        }
+        if (ret == -1) {
+            printf("No baseline at %s, throughput is not checked. Write one with --update-baseline\n", baseline_path);
+        }
+    }
+
+    if (workers < 1) {
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (workers < 1) workers = 1;
+    }
+    if ((size_t)workers > check.job_count) {
+        workers = (int)check.job_count;
+    }
+
+    check.jobs = calloc(check.job_count, sizeof(Check_Job));
+    threads = malloc(workers * sizeof(pthread_t));
+    system = malloc(sizeof(Chip8_t));
+    aot = malloc(sizeof(Aot_t));
+    if (!check.jobs || !threads || !system || !aot) {
+        fprintf(stderr, "OUT OF MEMORY!\n");
+        return 1;
+    }
+    for (j = 0; j < check.job_count; j++) {
+        check.jobs[j].rom = &roms[j / CORE_COUNT];
+        check.jobs[j].core = &cores[j % CORE_COUNT];
+        check.jobs[j].status = "not run";
+    }
+
+    pthread_mutex_init(&check.lock, NULL);
+    for (i = 0; i < workers; i++) {
+        pthread_create(&threads[i], NULL, worker_main, &check);
+    }
+    for (i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&check.lock);
+    time_jobs(&check, system, aot);
+
+    /* Every core is held to the golden hashes, or when writing them to the interpreter */
+    for (j = 0; j < check.job_count; j++) {
+        job = &check.jobs[j];
+        first = &check.jobs[j - j % CORE_COUNT];
+        if (strcmp(job->status, "ran") != 0) {
+            if (strcmp(job->status, "unavailable") != 0) {
+                failures++;
+            }
+            continue;
+        }
+        expect = update_golden ? NULL : find_golden(golden, golden_count, job->rom->name);
+        if (update_golden) {
+            job->status = (job->gfx_hash == first->gfx_hash && job->regs_hash == first->regs_hash) ? "ok" : "MISMATCH";
+        }
+        else if (!expect) {
+            job->status = "NO GOLDEN";
+        }
+        else {
+            job->status = (job->gfx_hash == expect->gfx_hash && job->regs_hash == expect->regs_hash) ? "ok" : "MISMATCH";
+        }
+        if (strcmp(job->status, "ok") != 0) {
+            failures++;
+        }
+        job->baseline = find_baseline(baseline, baseline_count, job->rom->name, job->core->name);
+    }
+
+    printf("%-12s %-12s %-10s %-16s %-16s %14s %9s\n", "rom", "core", "status", "screen", "registers", "ips", "change");
+    for (j = 0; j < check.job_count; j++) {
+        job = &check.jobs[j];
+        printf("%-12s %-12s %-10s %016" PRIx64 " %016" PRIx64 " %14.0f", job->rom->name, job->core->name, job->status, job->gfx_hash, job->regs_hash, job->ips);
+        if (job->baseline > 0 && job->ips > 0) {
+            change = (job->ips - job->baseline) / job->baseline * 100;
+            printf(" %+8.1f%%", change);
+            if (change < -threshold) {
+                printf(" SLOWER THAN THE BASELINE");
+                regressions++;
+            }
+        }
+        printf("\n");
+    }
+
+    if (update_golden && failures == 0) {
+        if (save_golden(golden_path, check.jobs) != 0) {
+            fprintf(stderr, "FAILED TO WRITE %s!\n", golden_path);
+            failures++;
+        }
+    }
+    if (update_baseline && failures == 0) {
+        if (save_baseline(baseline_path, check.jobs, check.job_count) != 0) {
+            fprintf(stderr, "FAILED TO WRITE %s!\n", baseline_path);
+            failures++;
+        }
+    }
+
+    printf("mismatches: %d\n", failures);
+    printf("regressions: %d (threshold %.0f%%)\n", regressions, threshold);
+    free(system);
+    free(aot);
+    free(threads);
+    free(check.jobs);
+    return (failures || regressions) ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "chip8.h"
+
+/* Frames every input runs for, at the default speed */
+#define FUZZ_FRAMES 120
+#define FUZZ_IPF (DEFAULT_IPS / CLOCK_FREQUENCY)
+
+#define DEFAULT_RUNS 100000
+#define DEFAULT_SIZE 256
+
+/*
+Times every address was executed at, saturating at 255
+    - libFuzzer picks the array up as extra counters, so reaching new ROM addresses counts as new coverage on top of the edges of the emulator
+*/
+#if defined(LIBFUZZER)
+__attribute__((used, section("__libfuzzer_extra_counters")))
+#endif
+static uint8_t coverage[MEMORY_SIZE];
+
+/* The system as chip8_initialize() leaves it, every input starts from it */
+static Chip8_t snapshot;
+static Chip8_t fuzzed;
+static int full_reset;
+static int ready;
+
+static void fuzz_init(void) {
+    chip8_initialize(&snapshot);
+    fuzzed = snapshot;
+    ready = 1;
+    return;
+}
+
+/*
+Run one input on a system
+    - The first byte is the number of key events, each event is two bytes: frames since the previous event, then the key in the low nibble and bit 4 set for down
+    - Everything after the events is the ROM, loaded at PROGRAM_START and cut to what fits
+    - chip8_restore() resets from the snapshot, copying only the pages the last input wrote. --full-reset uses chip8_initialize() instead to compare
+*/
+static void fuzz_run(Chip8_t *system, const uint8_t *data, size_t size, int full) {
+    size_t events = 0, next = 0, rom_size;
+    uint64_t frame, at = 0;
+    int i;
+
+    if (full) {
+        chip8_initialize(system);
+    }
+    else {
+        chip8_restore(system, &snapshot);
+    }
+
+    if (size > 0) {
+        events = data[0];
+        if (events > (size - 1) / 2) {
+            events = (size - 1) / 2;
+        }
+        data++;
+        size--;
+    }
+    rom_size = size - events * 2;
+    if (rom_size > MEMORY_SIZE - PROGRAM_START) {
+        rom_size = MEMORY_SIZE - PROGRAM_START;
+    }
+    chip8_write(system, PROGRAM_START, data + events * 2, rom_size);
+
+    if (events) {
+        at = data[0];
+    }
+    for (frame = 0; frame < FUZZ_FRAMES && !system->EMU_flags.exit; frame++) {
+        while (next < events && at == frame) {
+            system->key[data[next * 2 + 1] & 0xF] = (data[next * 2 + 1] & 0x10) != 0;
+            next++;
+            if (next < events) {
+                at += data[next * 2];
+            }
+        }
+
+        for (i = 0; i < FUZZ_IPF && !system->EMU_flags.exit; i++) {
+            if (coverage[system->pc & (MEMORY_SIZE - 1)] != 0xFF) {
+                coverage[system->pc & (MEMORY_SIZE - 1)]++;
+            }
+            chip8_emulatecycle(system);
+        }
+        chip8_update_timers(system);
+    }
+    return;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (!ready) {
+        fuzz_init();
+    }
+    fuzz_run(&fuzzed, data, size, full_reset);
+    return 0;
+}
+
+#if !defined(LIBFUZZER)
+
+static Chip8_t reference;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/* Run the input again from a fresh chip8_initialize(), the fast reset has to end in the same state */
+static int verify(const uint8_t *data, size_t size) {
+    fuzz_run(&reference, data, size, 1);
+    return chip8_hash(&reference) == chip8_hash(&fuzzed) && memcmp(reference.decoded, fuzzed.decoded, sizeof(reference.decoded)) == 0;
+}
+
+static int read_input(const char *path, uint8_t *buf, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp) {
+        return -1;
+    }
+    *size = fread(buf, 1, MEMORY_SIZE, fp);
+    fclose(fp);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "%s [options] [input]...\n", prog);
+    fprintf(stderr, "  -n <runs>               Random inputs to run when no input files are given (default %d)\n", DEFAULT_RUNS);
+    fprintf(stderr, "  --size <bytes>          Largest random input (default %d)\n", DEFAULT_SIZE);
+    fprintf(stderr, "  --seed <n>              Seed of the random inputs (default 1)\n");
+    fprintf(stderr, "  --full-reset            Reset with chip8_initialize() instead of the snapshot\n");
+    fprintf(stderr, "  --verify                Run every input from a fresh system as well and compare the states\n");
+    fprintf(stderr, "Inputs are a key event count, that many events of two bytes and the ROM, build with libFuzzer for guided fuzzing\n");
+    return;
+}
+
+/*
+Stand in for libFuzzer
+    - Input files are run once each and their final state hash printed, to reproduce a crash
+    - Without files random inputs are run and the executions per second and addresses reached are reported
+*/
+int main(int argc, char **argv) {
+    uint8_t buf[MEMORY_SIZE];
+    size_t size, max_size = DEFAULT_SIZE, j;
+    uint64_t runs = DEFAULT_RUNS, run, covered = 0;
+    uint32_t seed = 1;
+    int i, check = 0, files = 0, mismatches = 0;
+    const char **inputs;
+    double start, seconds;
+
+    inputs = malloc(argc * sizeof(*inputs));
+    if (!inputs) {
+        fprintf(stderr, "OUT OF MEMORY!\n");
+        return 1;
+    }
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            runs = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            max_size = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--full-reset") == 0) {
+            full_reset = 1;
+        }
+        else if (strcmp(argv[i], "--verify") == 0) {
+            check = 1;
+        }
+        else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            free(inputs);
+            return 1;
+        }
+        else {
+            inputs[files++] = argv[i];
+        }
+    }
+    if (max_size < 1 || max_size > MEMORY_SIZE) {
+        usage(argv[0]);
+        free(inputs);
+        return 1;
+    }
+    seed = seed ? seed : 1;
+    fuzz_init();
+
+    for (i = 0; i < files; i++) {
+        if (read_input(inputs[i], buf, &size) != 0) {
+            fprintf(stderr, "INVALID INPUT PATH %s!\n", inputs[i]);
+            free(inputs);
+            return 1;
+        }
+        LLVMFuzzerTestOneInput(buf, size);
+        printf("%s: %016" PRIx64 "\n", inputs[i], chip8_hash(&fuzzed));
+        if (check && !verify(buf, size)) {
+            fprintf(stderr, "%s: FAST RESET DIVERGED!\n", inputs[i]);
+            mismatches++;
+        }
+    }
+    free(inputs);
+    if (files) {
+        return mismatches ? 2 : 0;
+    }
+
+    start = now();
+    for (run = 0; run < runs; run++) {
+        size = next_random(&seed) % max_size + 1;
+        for (j = 0; j < size; j++) {
+            buf[j] = next_random(&seed);
+        }
+        LLVMFuzzerTestOneInput(buf, size);
+        if (check && !verify(buf, size)) {
+            fprintf(stderr, "RUN %" PRIu64 ": FAST RESET DIVERGED!\n", run);
+            mismatches++;
+        }
+    }
+    seconds = now() - start;
+
+    for (j = 0; j < MEMORY_SIZE; j++) {
+        covered += coverage[j] != 0;
+    }
+    printf("reset: %s\n", full_reset ? "full" : "snapshot");
+    printf("execs: %" PRIu64 "\n", runs);
+    printf("seconds: %.3f\n", seconds);
+    printf("execs/sec: %.0f\n", seconds > 0 ? runs / seconds : 0);
+    printf("addresses covered: %" PRIu64 "\n", covered);
+    printf("mismatches: %d\n", mismatches);
+    return mismatches ? 2 : 0;
+}
+
+#endif
\ No newline at end of file
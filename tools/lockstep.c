@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+
+#include "chip8.h"
+#include "headless.h"
+#include "input.h"
+#include "lockstep.h"
+#include "utils.h"
+
+#define LOCKSTEP_MAX_INPUTS 64
+#define DEFAULT_LANES 256
+#define DEFAULT_FRAMES 600
+
+typedef struct {
+    int lanes;
+    uint64_t ips;
+    uint64_t frames;
+    uint32_t seed;
+    int clip;
+    Input_Script inputs[LOCKSTEP_MAX_INPUTS];
+    int input_count;
+} Sweep_t;
+
+/* Lane i runs with seed + i and the input script i % input_count */
+static void setup_lane(const Sweep_t *sweep, Chip8_t *system, int lane) {
+    chip8_seed(system, sweep->seed + lane);
+    system->quirks.clip = sweep->clip;
+    return;
+}
+
+static Input_Script *lane_input(const Sweep_t *sweep, Input_Script *scripts, int lane) {
+    if (sweep->input_count == 0) {
+        return NULL;
+    }
+    scripts[lane] = sweep->inputs[lane % sweep->input_count];
+    scripts[lane].next = 0;
+    return &scripts[lane];
+}
+
+/* Every lane in one lockstep engine, the hashes are kept to compare against the scalar run */
+static int run_lockstep(const Sweep_t *sweep, const char *rom, uint64_t *hashes, double *seconds, double *vector_share) {
+    Lockstep_t ls;
+    Input_Script *scripts;
+    uint64_t frame;
+    Ipf_Counter ipf;
+    double start;
+    int i;
+
+    if (lockstep_init(&ls, sweep->lanes) != 0) {
+        return -3;
+    }
+    scripts = calloc(sweep->lanes, sizeof(Input_Script));
+    if (!scripts) {
+        lockstep_cleanup(&ls);
+        return -3;
+    }
+    i = lockstep_load(&ls, rom);
+    if (i != 0) {
+        free(scripts);
+        lockstep_cleanup(&ls);
+        return i;
+    }
+    for (i = 0; i < sweep->lanes; i++) {
+        setup_lane(sweep, &ls.systems[i], i);
+        lane_input(sweep, scripts, i);
+    }
+
+    ipf_init(&ipf, sweep->ips);
+    start = headless_time();
+    for (frame = 0; frame < sweep->frames; frame++) {
+        if (sweep->input_count) {
+            for (i = 0; i < sweep->lanes; i++) {
+                input_apply(&scripts[i], &ls.systems[i], frame);
+            }
+        }
+        lockstep_run(&ls, ipf_next(&ipf));
+        lockstep_update_timers(&ls);
+    }
+    *seconds = headless_time() - start;
+
+    lockstep_sync(&ls);
+    for (i = 0; i < sweep->lanes; i++) {
+        hashes[i] = chip8_hash(&ls.systems[i]);
+    }
+    *vector_share = (double)ls.vector_instructions / (double)(ls.vector_instructions + ls.scalar_instructions);
+
+    free(scripts);
+    lockstep_cleanup(&ls);
+    return 0;
+}
+
+/* The same lanes one after another on the interpreter, as N independent instances would run */
+static int run_scalar(const Sweep_t *sweep, const char *rom, uint64_t *hashes, double *seconds) {
+    Chip8_t *system;
+    Input_Script *scripts, *script;
+    uint64_t frame;
+    Ipf_Counter ipf;
+    double start;
+    int i, j, ret, budget;
+
+    system = malloc(sizeof(Chip8_t));
+    scripts = calloc(sweep->lanes, sizeof(Input_Script));
+    if (!system || !scripts) {
+        free(system);
+        free(scripts);
+        return -3;
+    }
+
+    *seconds = 0;
+    for (i = 0; i < sweep->lanes; i++) {
+        chip8_initialize(system);
+        ret = load_rom(system, rom);
+        if (ret != 0) {
+            free(system);
+            free(scripts);
+            return ret;
+        }
+        setup_lane(sweep, system, i);
+        script = lane_input(sweep, scripts, i);
+
+        ipf_init(&ipf, sweep->ips);
+        start = headless_time();
+        for (frame = 0; frame < sweep->frames; frame++) {
+            if (script) {
+                input_apply(script, system, frame);
+            }
+            budget = ipf_next(&ipf);
+            for (j = 0; j < budget; j++) {
+                chip8_emulatecycle(system);
+            }
+            chip8_update_timers(system);
+        }
+        *seconds += headless_time() - start;
+        hashes[i] = chip8_hash(system);
+    }
+
+    free(system);
+    free(scripts);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "%s [options] <rom>\n", prog);
+    fprintf(stderr, "  -n <lanes>              Instances run in lockstep (default %d)\n", DEFAULT_LANES);
+    fprintf(stderr, "  --frames <n>            Frames every instance runs (default %d)\n", DEFAULT_FRAMES);
+    fprintf(stderr, "  --ips <n>               Instructions per second (default %d)\n", DEFAULT_IPS);
+    fprintf(stderr, "  --seed <n>              Seed of the first instance, the next ones count up (default 0)\n");
+    fprintf(stderr, "  --input <path>          Input script, given more than once they are dealt round robin\n");
+    fprintf(stderr, "  --clip                  Clip sprites at the screen edges\n");
+    return;
+}
+
+static void print_error(int ret) {
+    switch (ret) {
+        case -1:
+            fprintf(stderr, "INVALID ROM PATH!\n");
+            break;
+        case -2:
+            fprintf(stderr, "ROM TOO BIG!\n");
+            break;
+        case -3:
+            fprintf(stderr, "OUT OF MEMORY!\n");
+            break;
+        default:
+            fprintf(stderr, "FAILED TO LOAD ROM!\n");
+            break;
+    }
+    return;
+}
+
+int main(int argc, char **argv) {
+    int i, ret, mismatches = 0;
+    const char *rom = NULL;
+    Sweep_t sweep = {.lanes = DEFAULT_LANES, .ips = DEFAULT_IPS, .frames = DEFAULT_FRAMES, .seed = 0, .clip = 0, .input_count = 0};
+    uint64_t *lockstep_hashes, *scalar_hashes, total = 0, frame, value;
+    Ipf_Counter ipf;
+    double lockstep_seconds, scalar_seconds, vector_share;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &value) != 0 || value < 1 || value > INT_MAX) {
+                fprintf(stderr, "INVALID LANE COUNT!\n");
+                usage(argv[0]);
+                return 1;
+            }
+            sweep.lanes = (int)value;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &sweep.frames) != 0) {
+                fprintf(stderr, "INVALID FRAME COUNT!\n");
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--ips") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &sweep.ips) != 0 || sweep.ips < 1) {
+                fprintf(stderr, "INVALID IPS!\n");
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            if (str_to_u64(argv[++i], &value) != 0 || value > UINT32_MAX) {
+                fprintf(stderr, "INVALID SEED!\n");
+                usage(argv[0]);
+                return 1;
+            }
+            sweep.seed = (uint32_t)value;
+        }
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            if (sweep.input_count == LOCKSTEP_MAX_INPUTS) {
+                fprintf(stderr, "TOO MANY INPUT SCRIPTS!\n");
+                return 1;
+            }
+            if (input_load(&sweep.inputs[sweep.input_count], argv[++i]) != 0) {
+                fprintf(stderr, "INVALID INPUT SCRIPT!\n");
+                return 1;
+            }
+            sweep.input_count++;
+        }
+        else if (strcmp(argv[i], "--clip") == 0) {
+            sweep.clip = 1;
+        }
+        else if (argv[i][0] == '-' || rom) {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            rom = argv[i];
+        }
+    }
+
+    if (!rom) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    lockstep_hashes = malloc(sweep.lanes * sizeof(uint64_t));
+    scalar_hashes = malloc(sweep.lanes * sizeof(uint64_t));
+    if (!lockstep_hashes || !scalar_hashes) {
+        fprintf(stderr, "OUT OF MEMORY!\n");
+        return 1;
+    }
+
+    ret = run_lockstep(&sweep, rom, lockstep_hashes, &lockstep_seconds, &vector_share);
+    if (ret == 0) {
+        ret = run_scalar(&sweep, rom, scalar_hashes, &scalar_seconds);
+    }
+    if (ret != 0) {
+        print_error(ret);
+        return 1;
+    }
+
+    for (i = 0; i < sweep.lanes; i++) {
+        if (lockstep_hashes[i] != scalar_hashes[i]) {
+            fprintf(stderr, "LANE %d DIVERGED! %016" PRIx64 " != %016" PRIx64 "\n", i, lockstep_hashes[i], scalar_hashes[i]);
+            mismatches++;
+        }
+    }
+
+    ipf_init(&ipf, sweep.ips);
+    for (frame = 0; frame < sweep.frames; frame++) {
+        total += ipf_next(&ipf);
+    }
+    total *= sweep.lanes;
+    printf("lanes: %d\n", sweep.lanes);
+    printf("instructions: %" PRIu64 "\n", total);
+    printf("lockstep: %.3f s, %.0f IPS, %.1f%% vector\n", lockstep_seconds, lockstep_seconds > 0 ? total / lockstep_seconds : 0, vector_share * 100);
+    printf("scalar: %.3f s, %.0f IPS\n", scalar_seconds, scalar_seconds > 0 ? total / scalar_seconds : 0);
+    printf("speedup: %.2fx\n", lockstep_seconds > 0 ? scalar_seconds / lockstep_seconds : 0);
+    printf("mismatches: %d\n", mismatches);
+
+    for (i = 0; i < sweep.input_count; i++) {
+        input_free(&sweep.inputs[i]);
+    }
+    free(lockstep_hashes);
+    free(scalar_hashes);
+    return mismatches ? 2 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include "chip8.h"
+#include "state.h"
+#include "trace.h"
+
+#define MNEMONIC_BUF 32
+
+/* What an instruction leaves in the registers the trace holds, decides which of them are shown */
+#define WRITES_VX 0x01
+#define WRITES_VF 0x02
+
+static const char *reason_names[] = {
+    "none", "invalid opcode", "stack overflow", "stack underflow", "signal"
+};
+
+static uint16_t swap16(uint16_t v) {
+    return (uint16_t)(v << 8 | v >> 8);
+}
+
+static uint32_t swap32(uint32_t v) {
+    return (uint32_t)swap16(v & 0xFFFF) << 16 | swap16(v >> 16);
+}
+
+static uint64_t swap64(uint64_t v) {
+    return (uint64_t)swap32(v & 0xFFFFFFFF) << 32 | swap32(v >> 32);
+}
+
+/*
+Disassemble one opcode in the usual CHIP-8 assembly, SUPER-CHIP included
+    - Returns which of Vx and VF it writes, FX65 and FX85 write V0 to Vx but the trace only has Vx
+*/
+static int disassemble(uint16_t opcode, char *buf) {
+    uint16_t nnn = opcode & 0x0FFF;
+    uint8_t x = (opcode & 0x0F00) >> 8, y = (opcode & 0x00F0) >> 4, n = opcode & 0x000F, nn = opcode & 0x00FF;
+
+    switch (opcode & 0xF000) {
+        case 0x0000:
+            if ((opcode & 0xFFF0) == 0x00C0) {
+                snprintf(buf, MNEMONIC_BUF, "SCD %X", n);
+                return 0;
+            }
+            switch (opcode) {
+                case 0x00E0: snprintf(buf, MNEMONIC_BUF, "CLS"); return 0;
+                case 0x00EE: snprintf(buf, MNEMONIC_BUF, "RET"); return 0;
+                case 0x00FB: snprintf(buf, MNEMONIC_BUF, "SCR"); return 0;
+                case 0x00FC: snprintf(buf, MNEMONIC_BUF, "SCL"); return 0;
+                case 0x00FD: snprintf(buf, MNEMONIC_BUF, "EXIT"); return 0;
+                case 0x00FE: snprintf(buf, MNEMONIC_BUF, "LOW"); return 0;
+                case 0x00FF: snprintf(buf, MNEMONIC_BUF, "HIGH"); return 0;
+            }
+            break;
+        case 0x1000: snprintf(buf, MNEMONIC_BUF, "JP %03X", nnn); return 0;
+        case 0x2000: snprintf(buf, MNEMONIC_BUF, "CALL %03X", nnn); return 0;
+        case 0x3000: snprintf(buf, MNEMONIC_BUF, "SE V%X, %02X", x, nn); return 0;
+        case 0x4000: snprintf(buf, MNEMONIC_BUF, "SNE V%X, %02X", x, nn); return 0;
+        case 0x5000: snprintf(buf, MNEMONIC_BUF, "SE V%X, V%X", x, y); return 0;
+        case 0x6000: snprintf(buf, MNEMONIC_BUF, "LD V%X, %02X", x, nn); return WRITES_VX;
+        case 0x7000: snprintf(buf, MNEMONIC_BUF, "ADD V%X, %02X", x, nn); return WRITES_VX;
+        case 0x8000:
+            switch (n) {
+                case 0x0: snprintf(buf, MNEMONIC_BUF, "LD V%X, V%X", x, y); return WRITES_VX;
+                case 0x1: snprintf(buf, MNEMONIC_BUF, "OR V%X, V%X", x, y); return WRITES_VX;
+                case 0x2: snprintf(buf, MNEMONIC_BUF, "AND V%X, V%X", x, y); return WRITES_VX;
+                case 0x3: snprintf(buf, MNEMONIC_BUF, "XOR V%X, V%X", x, y); return WRITES_VX;
+                case 0x4: snprintf(buf, MNEMONIC_BUF, "ADD V%X, V%X", x, y); return WRITES_VX | WRITES_VF;
+                case 0x5: snprintf(buf, MNEMONIC_BUF, "SUB V%X, V%X", x, y); return WRITES_VX | WRITES_VF;
+                case 0x6: snprintf(buf, MNEMONIC_BUF, "SHR V%X", x); return WRITES_VX | WRITES_VF;
+                case 0x7: snprintf(buf, MNEMONIC_BUF, "SUBN V%X, V%X", x, y); return WRITES_VX | WRITES_VF;
+                case 0xE: snprintf(buf, MNEMONIC_BUF, "SHL V%X", x); return WRITES_VX | WRITES_VF;
+            }
+            break;
+        case 0x9000: snprintf(buf, MNEMONIC_BUF, "SNE V%X, V%X", x, y); return 0;
+        case 0xA000: snprintf(buf, MNEMONIC_BUF, "LD I, %03X", nnn); return 0;
+        case 0xB000: snprintf(buf, MNEMONIC_BUF, "JP V0, %03X", nnn); return 0;
+        case 0xC000: snprintf(buf, MNEMONIC_BUF, "RND V%X, %02X", x, nn); return WRITES_VX;
+        case 0xD000: snprintf(buf, MNEMONIC_BUF, "DRW V%X, V%X, %X", x, y, n); return WRITES_VF;
+        case 0xE000:
+            if (nn == 0x9E) {
+                snprintf(buf, MNEMONIC_BUF, "SKP V%X", x);
+                return 0;
+            }
+            if (nn == 0xA1) {
+                snprintf(buf, MNEMONIC_BUF, "SKNP V%X", x);
+                return 0;
+            }
+            break;
+        case 0xF000:
+            switch (nn) {
+                case 0x07: snprintf(buf, MNEMONIC_BUF, "LD V%X, DT", x); return WRITES_VX;
+                case 0x0A: snprintf(buf, MNEMONIC_BUF, "LD V%X, K", x); return WRITES_VX;
+                case 0x15: snprintf(buf, MNEMONIC_BUF, "LD DT, V%X", x); return 0;
+                case 0x18: snprintf(buf, MNEMONIC_BUF, "LD ST, V%X", x); return 0;
+                case 0x1E: snprintf(buf, MNEMONIC_BUF, "ADD I, V%X", x); return 0;
+                case 0x29: snprintf(buf, MNEMONIC_BUF, "LD F, V%X", x); return 0;
+                case 0x30: snprintf(buf, MNEMONIC_BUF, "LD HF, V%X", x); return 0;
+                case 0x33: snprintf(buf, MNEMONIC_BUF, "LD B, V%X", x); return 0;
+                case 0x55: snprintf(buf, MNEMONIC_BUF, "LD [I], V%X", x); return 0;
+                case 0x65: snprintf(buf, MNEMONIC_BUF, "LD V%X, [I]", x); return 0;
+                case 0x75: snprintf(buf, MNEMONIC_BUF, "LD R, V%X", x); return 0;
+                case 0x85: snprintf(buf, MNEMONIC_BUF, "LD V%X, R", x); return 0;
+            }
+            break;
+    }
+    snprintf(buf, MNEMONIC_BUF, "DW %04X", opcode);
+    return 0;
+}
+
+/* One checkpoint of the dump */
+typedef struct {
+    Trace_Epoch_Header header;
+    uint8_t state[STATE_BODY_SIZE];
+    Trace_Event *events;
+} Epoch;
+
+/* What the replay found, indices count instructions from the start of the emulator */
+typedef struct {
+    Trace_Entry *ring;
+    uint64_t first;
+    uint64_t end;
+    uint64_t replaced;
+    uint64_t fault;
+    int fault_reason;
+} Replay;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "%s [-n <entries>] <trace>\n", prog);
+    fprintf(stderr, "  -n <entries>    Only list the last entries (default all)\n");
+    fprintf(stderr, "Traces are written by chip8-emu (see --trace) when the ROM hits an invalid opcode, overflows or underflows the stack, or the emulator crashes\n");
+    return;
+}
+
+static int read_epoch(FILE *fp, Epoch *epoch, int swapped) {
+    uint32_t e;
+
+    if (fread(&epoch->header, sizeof(epoch->header), 1, fp) != 1) {
+        return -1;
+    }
+    if (swapped) {
+        epoch->header.at = swap64(epoch->header.at);
+        epoch->header.events = swap32(epoch->header.events);
+    }
+    if (epoch->header.events > TRACE_EVENTS) {
+        return -2;
+    }
+    epoch->events = malloc((epoch->header.events ? epoch->header.events : 1) * sizeof(Trace_Event));
+    if (!epoch->events) {
+        return -3;
+    }
+    if (fread(epoch->state, STATE_BODY_SIZE, 1, fp) != 1 || fread(epoch->events, sizeof(Trace_Event), epoch->header.events, fp) != epoch->header.events) {
+        return -1;
+    }
+    if (swapped) {
+        for (e = 0; e < epoch->header.events; e++) {
+            epoch->events[e].offset = swap32(epoch->events[e].offset);
+            epoch->events[e].keys = swap16(epoch->events[e].keys);
+        }
+    }
+    return 0;
+}
+
+/*
+Run the checkpoints forward on the interpreter until end, keeping the last TRACE_SIZE instructions as the emulator ran them
+    - Every core executes the same instructions, and the keypad and timers are set where the events say, so the replay takes the same path
+    - A checkpoint that does not match the state the replay reached marks where the state was replaced from outside the ROM
+    - Stops once the ROM exits, the last instruction that left the stack range is remembered
+*/
+static void replay(Chip8_t *system, const Epoch *epochs, int count, uint64_t end, Replay *r) {
+    const Chip8_Instr *instr;
+    const Epoch *epoch;
+    Trace_Entry *e;
+    uint8_t body[STATE_BODY_SIZE];
+    uint64_t n, stop;
+    uint32_t next;
+    uint16_t sp;
+    int i, k;
+
+    r->first = epochs[0].header.at;
+    r->replaced = UINT64_MAX;
+    r->fault = UINT64_MAX;
+    r->fault_reason = 0;
+    n = r->first;
+
+    for (i = 0; i < count; i++) {
+        epoch = &epochs[i];
+        if (i > 0) {
+            state_pack(system, body);
+            if (n != epoch->header.at || memcmp(body, epoch->state, STATE_BODY_SIZE) != 0) {
+                r->replaced = epoch->header.at;
+            }
+        }
+        chip8_initialize(system);
+        state_unpack(system, epoch->state);
+
+        stop = i + 1 < count ? epochs[i + 1].header.at : end;
+        for (n = epoch->header.at, next = 0; n < stop; n++) {
+            while (next < epoch->header.events && epoch->header.at + epoch->events[next].offset <= n) {
+                for (k = 0; k < NUM_KEYS; k++) {
+                    system->key[k] = (epoch->events[next].keys >> k) & 1;
+                }
+                system->delay_timer = epoch->events[next].delay;
+                system->sound_timer = epoch->events[next].sound;
+                next++;
+            }
+
+            /* Opcode and x are taken before running the instruction, it may write over itself */
+            e = &r->ring[n & (TRACE_SIZE - 1)];
+            e->pc = system->pc & (MEMORY_SIZE - 1);
+            instr = &system->decoded[e->pc];
+            e->opcode = instr->opcode;
+            e->vx = instr->x;
+            sp = system->sp;
+
+            chip8_emulatecycle(system);
+            e->I = system->I;
+            e->vx = system->V[e->vx];
+            e->vf = system->V[0xF];
+
+            if (system->sp > STACK_SIZE && sp <= STACK_SIZE) {
+                r->fault = n;
+                r->fault_reason = (system->sp & 0x8000) ? TRACE_UNDERFLOW : TRACE_OVERFLOW;
+            }
+            if (system->EMU_flags.exit) {
+                if (chip8_invalid(instr)) {
+                    r->fault = n;
+                    r->fault_reason = TRACE_INVALID;
+                }
+                n++;
+                break;
+            }
+        }
+        if (system->EMU_flags.exit) {
+            break;
+        }
+    }
+    r->end = n;
+    return;
+}
+
+static int parse_count(const char *s, uint64_t *out) {
+    char *end;
+
+    errno = 0;
+    *out = strtoull(s, &end, 10);
+    if (errno != 0 || end == s || *end != '\0' || s[0] == '-') {
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Trace_Header header;
+    Epoch epochs[2];
+    Replay r;
+    Chip8_t *system;
+    const Trace_Entry *entry;
+    const char *path = NULL;
+    uint64_t last = 0, first, stop, index;
+    char mnemonic[MNEMONIC_BUF];
+    int i, swapped, writes, ret = 0;
+    FILE *fp;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            if (parse_count(argv[++i], &last) != 0) {
+                fprintf(stderr, "INVALID ENTRY COUNT!\n");
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-' || path) {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "INVALID TRACE PATH!\n");
+        return 1;
+    }
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+        fprintf(stderr, "INVALID TRACE!\n");
+        fclose(fp);
+        return 1;
+    }
+
+    /* A trace written on a host of the other byte order, the states are little endian either way */
+    swapped = header.order != TRACE_ORDER;
+    if (swapped) {
+        header.version = swap16(header.version);
+        header.epochs = swap16(header.epochs);
+        header.state_size = swap32(header.state_size);
+        header.event_size = swap32(header.event_size);
+        header.rom_hash = swap64(header.rom_hash);
+        header.total = swap64(header.total);
+        header.window = swap64(header.window);
+    }
+    if (header.version != TRACE_VERSION || header.state_size != STATE_BODY_SIZE || header.event_size != sizeof(Trace_Event)) {
+        fprintf(stderr, "UNSUPPORTED TRACE VERSION!\n");
+        fclose(fp);
+        return 1;
+    }
+    if (header.epochs < 1 || header.epochs > 2) {
+        fprintf(stderr, "INVALID TRACE!\n");
+        fclose(fp);
+        return 1;
+    }
+
+    memset(epochs, 0, sizeof(epochs));
+    for (i = 0; i < header.epochs && ret == 0; i++) {
+        switch (read_epoch(fp, &epochs[i], swapped)) {
+            case 0:
+                break;
+            case -2:
+                fprintf(stderr, "INVALID TRACE!\n");
+                ret = 1;
+                break;
+            case -3:
+                fprintf(stderr, "OUT OF MEMORY!\n");
+                ret = 1;
+                break;
+            default:
+                fprintf(stderr, "TRACE IS CUT SHORT!\n");
+                ret = 1;
+                break;
+        }
+    }
+    fclose(fp);
+    if (ret == 0 && (epochs[header.epochs - 1].header.at > header.total || (header.epochs == 2 && epochs[0].header.at > epochs[1].header.at))) {
+        fprintf(stderr, "INVALID TRACE!\n");
+        ret = 1;
+    }
+
+    system = malloc(sizeof(Chip8_t));
+    r.ring = malloc(TRACE_SIZE * sizeof(Trace_Entry));
+    if (ret == 0 && (!system || !r.ring)) {
+        fprintf(stderr, "OUT OF MEMORY!\n");
+        ret = 1;
+    }
+    if (ret != 0) {
+        free(system);
+        free(r.ring);
+        free(epochs[0].events);
+        free(epochs[1].events);
+        return ret;
+    }
+    replay(system, epochs, header.epochs, header.total + header.window, &r);
+
+    /* A fault ends the listing, the instructions after it in the same run are left out */
+    stop = r.end;
+    if (header.reason != TRACE_SIGNAL && r.fault != UINT64_MAX) {
+        stop = r.fault + 1;
+    }
+    else if (header.reason != TRACE_SIGNAL) {
+        fprintf(stderr, "THE REPLAY DID NOT REACH THE FAULT, LISTING EVERYTHING!\n");
+    }
+    first = r.first;
+    if (r.end - first > TRACE_SIZE) {
+        first = r.end - TRACE_SIZE;
+    }
+    if (first > stop) {
+        first = stop;
+    }
+    if (last && stop - first > last) {
+        first = stop - last;
+    }
+
+    printf("rom: %016" PRIx64 "\n", header.rom_hash);
+    printf("reason: %s", header.reason < sizeof(reason_names) / sizeof(reason_names[0]) ? reason_names[header.reason] : "unknown");
+    if (header.reason == TRACE_SIGNAL) {
+        printf(" %d", header.signal);
+    }
+    printf("\n");
+    printf("instructions: %" PRIu64 ", replayed from %" PRIu64 ", last %" PRIu64 " listed\n\n", header.total, r.first, stop - first);
+
+    for (index = first; index < stop; index++) {
+        if (index == r.replaced) {
+            printf("--- the state was replaced from outside the ROM here ---\n");
+        }
+        if (header.reason == TRACE_SIGNAL && header.window && index == header.total) {
+            printf("--- the signal arrived within the next %" PRIu64 " instructions ---\n", header.window);
+        }
+        entry = &r.ring[index & (TRACE_SIZE - 1)];
+        writes = disassemble(entry->opcode, mnemonic);
+        printf("%12" PRIu64 "  %03" PRIX16 "  %04" PRIX16 "  %-16s  I=%03" PRIX16, index, entry->pc, entry->opcode, mnemonic, entry->I);
+        if (writes & WRITES_VX) {
+            printf("  V%X=%02" PRIX8, (entry->opcode & 0x0F00) >> 8, entry->vx);
+        }
+        if ((writes & WRITES_VF) && !((writes & WRITES_VX) && (entry->opcode & 0x0F00) == 0x0F00)) {
+            printf("  VF=%02" PRIX8, entry->vf);
+        }
+        if (index == r.fault) {
+            printf("  <- %s", reason_names[r.fault_reason]);
+        }
+        printf("\n");
+    }
+
+    free(system);
+    free(r.ring);
+    free(epochs[0].events);
+    free(epochs[1].events);
+    return 0;
+}
\ No newline at end of file